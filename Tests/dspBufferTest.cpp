@@ -157,7 +157,7 @@ TEST_CASE("madronalib/core/dspbuffer/threads", "[dspbuffer][threads]")
 TEST_CASE("madronalib/core/dspbuffer/overlap", "[dspbuffer][overlap]")
 {
   DSPBuffer buf;
-  buf.resize(256);
+  buf.resize(kFloatsPerDSPVector * 4);
 
   DSPVector outputVec, outputVec2;
   int overlap = kFloatsPerDSPVector / 2;
@@ -189,7 +189,7 @@ TEST_CASE("madronalib/core/dspbuffer/overlap", "[dspbuffer][overlap]")
 TEST_CASE("madronalib/core/dspbuffer/vectors", "[dspbuffer][vectors]")
 {
   DSPBuffer buf;
-  buf.resize(256);
+  buf.resize(kFloatsPerDSPVector * 4);
 
   constexpr size_t kRows = 3;
   DSPVectorArray<kRows> inputVec, outputVec;
@@ -213,15 +213,16 @@ TEST_CASE("madronalib/core/dspbuffer/vectors", "[dspbuffer][vectors]")
 TEST_CASE("madronalib/core/dspbuffer/peek", "[dspbuffer][peek]")
 {
   // buffer should be next larger power-of-two size
+  constexpr int kSize = kFloatsPerDSPVector * 4;
   DSPBuffer buf;
-  buf.resize(256);
+  buf.resize(kSize);
 
   // write to near end
   std::vector<float> nines;
-  nines.resize(256);
+  nines.resize(kSize);
   std::fill(nines.begin(), nines.end(), 9.f);
-  buf.write(nines.data(), 203);
-  buf.read(nines.data(), 203);
+  buf.write(nines.data(), kSize - 53);
+  buf.read(nines.data(), kSize - 53);
 
   // write DSPVectors with wrap
   DSPVector v1(columnIndex());
@@ -230,7 +231,7 @@ TEST_CASE("madronalib/core/dspbuffer/peek", "[dspbuffer][peek]")
   buf.write(v1);
 
   // write one more sample
-  float f{128};
+  float f{kFloatsPerDSPVector * 2};
   buf.write(&f, 1);
 
   // peek data regions to buffer
@@ -238,8 +239,94 @@ TEST_CASE("madronalib/core/dspbuffer/peek", "[dspbuffer][peek]")
   floatVec.resize(200);
   buf.peekMostRecent(floatVec.data(), 20);
 
-  REQUIRE(floatVec[0] == 109);
-  REQUIRE(floatVec[19] == 128);
+  REQUIRE(floatVec[0] == kFloatsPerDSPVector * 2 - 19);
+  REQUIRE(floatVec[19] == kFloatsPerDSPVector * 2);
+}
+
+TEST_CASE("madronalib/core/dspbuffer/ring_storage", "[dspbuffer][ring]")
+{
+  // write windows of varying lengths all around the storage, with and without
+  // the double mapping, and check that windows starting anywhere read back the
+  // samples written.
+  constexpr size_t kSize = 4096;
+  constexpr size_t kWindow = 300;
+  for (bool allowMapping : {false, true})
+  {
+    RingStorage ring;
+    ring.resize(kSize - 100, kWindow, allowMapping);
+    REQUIRE(ring.size() == kSize);
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    // 4096 floats are a whole number of pages, so Linux maps them twice.
+    REQUIRE(ring.isDoubleMapped() == allowMapping);
+#endif
+    std::vector<float> expected(kSize);
+
+    size_t writeIndex = 0;
+    float count = 0;
+    while (count < kSize * 3)
+    {
+      const size_t n = 1 + size_t(count) % kWindow;
+      float* p = ring.data() + writeIndex;
+      for (size_t i = 0; i < n; ++i)
+      {
+        p[i] = count;
+        expected[(writeIndex + i) & ring.mask()] = count++;
+      }
+      ring.commitWrite(writeIndex, n);
+      writeIndex = (writeIndex + n) & ring.mask();
+    }
+
+    bool matched{true};
+    for (size_t start = 0; start < kSize; start += 7)
+    {
+      for (size_t i = 0; i < kWindow; ++i)
+      {
+        matched &= (ring.data()[start + i] == expected[(start + i) & ring.mask()]);
+      }
+    }
+    REQUIRE(matched);
+
+    // a copy has the same contents.
+    RingStorage copy(ring);
+    REQUIRE(copy.isDoubleMapped() == ring.isDoubleMapped());
+    REQUIRE(std::equal(ring.data(), ring.data() + kSize + kWindow, copy.data()));
+  }
+
+  // a DSPBuffer big enough to be double mapped, if possible, wraps correctly.
+  DSPBuffer buf;
+  buf.resize(4096);
+  DSPVector v(columnIndex());
+  std::vector<float> nines(3, 9.f);
+  bool readBack{true};
+  for (int i = 0; i < 4096 / kFloatsPerDSPVector * 3; ++i)
+  {
+    buf.write(nines.data(), 3);
+    buf.discard(3);
+    buf.write(v);
+    readBack &= (buf.read() == v);
+    v += DSPVector(kFloatsPerDSPVector);
+  }
+  REQUIRE(readBack);
+
+  // a DSPBuffer too small to be double mapped splits reads and writes longer
+  // than its mirror that cross the end of the buffer.
+  DSPBuffer small;
+  small.resize(512);
+  std::vector<float> in(500), out(500);
+  float count{0};
+  bool splitReadBack{true};
+  for (int i = 0; i < 40; ++i)
+  {
+    const size_t n = 1 + (i * 97) % 500;
+    for (size_t j = 0; j < n; ++j)
+    {
+      in[j] = count++;
+    }
+    small.write(in.data(), n);
+    splitReadBack &= (small.read(out.data(), n) == n);
+    splitReadBack &= std::equal(in.begin(), in.begin() + n, out.begin());
+  }
+  REQUIRE(splitReadBack);
 }
 
 TEST_CASE("madronalib/core/dspbuffer/vector", "[dspbuffer][peek]")
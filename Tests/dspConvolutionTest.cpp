@@ -0,0 +1,217 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+#include "madronalib.h"
+#include "mldsp.h"
+#include "tests.h"
+
+using namespace ml;
+
+namespace
+{
+// convolve the input with the impulse response, one vector at a time, and
+// return the largest difference from the direct convolution.
+float convolutionError(const std::vector<float>& ir, size_t nVectors, bool useWorkerThread)
+{
+  Convolver convolver(ir.data(), ir.size(), useWorkerThread);
+  const size_t nSamples = nVectors * kFloatsPerDSPVector;
+  std::vector<float> x(nSamples);
+  NoiseGen noise;
+  for (auto& s : x)
+  {
+    s = noise.getSample();
+  }
+
+  // the nonzero taps, for a fast direct convolution of sparse responses.
+  std::vector<size_t> taps;
+  for (size_t k = 0; k < ir.size(); ++k)
+  {
+    if (ir[k] != 0.f) taps.push_back(k);
+  }
+
+  float maxError{0};
+  for (size_t v = 0; v < nVectors; ++v)
+  {
+    DSPVector in(kUninitialized);
+    std::copy(x.data() + v * kFloatsPerDSPVector, x.data() + (v + 1) * kFloatsPerDSPVector,
+              in.getBuffer());
+    convolver.waitForWorkers();
+    DSPVector out = convolver(in);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      const size_t t = v * kFloatsPerDSPVector + n;
+      double direct{0};
+      for (size_t k : taps)
+      {
+        if (k <= t) direct += ir[k] * x[t - k];
+      }
+      maxError = std::max(maxError, fabsf(out[n] - static_cast<float>(direct)));
+    }
+  }
+  return maxError;
+}
+
+// run noise the length of the impulse response through a Convolver with
+// worker threads, and return the largest difference from the output of one
+// without. If paced, call it at the rate of a 48kHz audio device, which after a
+// dropout resumes at the normal rate instead of catching up with a burst of
+// calls that would starve the workers. If not, wait for the workers before
+// each call. The longest call is left in worstCall.
+float workerError(const std::vector<float>& ir, Convolver& realTime, bool paced,
+                  std::chrono::duration<double>& worstCall)
+{
+  const double kSampleRate = 48000;
+  Convolver offline(ir.data(), ir.size(), false);
+  NoiseGen noise;
+
+  const size_t nVectors = ir.size() / kFloatsPerDSPVector;
+  const auto period =
+      std::chrono::nanoseconds(static_cast<int64_t>(kFloatsPerDSPVector * 1e9 / kSampleRate));
+  std::vector<DSPVector> inputs(nVectors), outputs(nVectors);
+  auto nextCall = std::chrono::steady_clock::now();
+  for (size_t v = 0; v < nVectors; ++v)
+  {
+    if (paced)
+    {
+      nextCall = std::max(nextCall, std::chrono::steady_clock::now() - period);
+      std::this_thread::sleep_until(nextCall);
+      nextCall += period;
+    }
+    else
+    {
+      realTime.waitForWorkers();
+    }
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      inputs[v][n] = noise.getSample();
+    }
+    auto callStart = std::chrono::steady_clock::now();
+    outputs[v] = realTime(inputs[v]);
+    worstCall = std::max(worstCall, std::chrono::duration<double>(
+                                        std::chrono::steady_clock::now() - callStart));
+  }
+
+  float maxError{0};
+  for (size_t v = 0; v < nVectors; ++v)
+  {
+    maxError = std::max(maxError, max(abs(outputs[v] - offline(inputs[v]))));
+  }
+  return maxError;
+}
+}  // namespace
+
+TEST_CASE("madronalib/core/convolution", "[convolution]")
+{
+  // a sparse response with taps at the edges of the partitions of several segments.
+  const size_t kLength = 20000;
+  std::vector<float> sparse(kLength);
+  const size_t kB = kFloatsPerDSPVector;
+  for (size_t k : {size_t(0), kB - 1, kB, kB * 16 - 1, kB * 16, kB * 20 + 3, kB * 128 - 1,
+                   kB * 128, kLength - 1})
+  {
+    if (k < kLength) sparse[k] = 1.f / (1 + k % 7);
+  }
+  const size_t kVectors = (kLength * 2) / kB;
+  REQUIRE(convolutionError(sparse, kVectors, false) < 1e-4f);
+  REQUIRE(convolutionError(sparse, kVectors, true) < 1e-4f);
+
+  // a dense, decaying response.
+  std::vector<float> dense(3000);
+  NoiseGen noise;
+  for (size_t k = 0; k < dense.size(); ++k)
+  {
+    dense[k] = noise.getSample() * expf(-(k / 500.f));
+  }
+  REQUIRE(convolutionError(dense, 6000 / kB, true) < 1e-3f);
+
+  // a response shorter than one vector has only the first segment.
+  std::vector<float> shortIR{0.5f, 0.25f, 0.125f};
+  Convolver shortConvolver(shortIR.data(), shortIR.size());
+  REQUIRE(shortConvolver.getNumSegments() == 1);
+  REQUIRE(convolutionError(shortIR, 4, true) < 1e-5f);
+}
+
+TEST_CASE("madronalib/core/convolution/time", "[convolution]")
+{
+  // time a two second response at 48kHz, with and without the worker thread.
+  // Running faster than real time, each call waits for the workers, so these
+  // show the total work more than the audio thread's share.
+  std::vector<float> ir(96000);
+  NoiseGen noise;
+  for (size_t k = 0; k < ir.size(); ++k)
+  {
+    ir[k] = noise.getSample() * expf(-(k / 20000.f));
+  }
+  Convolver withWorker(ir.data(), ir.size(), true);
+  Convolver withoutWorker(ir.data(), ir.size(), false);
+  DSPVector x = sin(columnIndex() * 0.1f);
+
+  std::function<DSPVector(void)> worker = [&]() {
+    withWorker.waitForWorkers();
+    return withWorker(x);
+  };
+  std::function<DSPVector(void)> noWorker = [&]() { return withoutWorker(x); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto workerTime = timeIterationsInThread<DSPVector>(worker);
+  auto noWorkerTime = timeIterationsInThread<DSPVector>(noWorker);
+#else
+  auto workerTime = timeIterations<DSPVector>(worker);
+  auto noWorkerTime = timeIterations<DSPVector>(noWorker);
+#endif
+
+  /*
+  std::cout << "convolution, 96000 samples: with worker: " << workerTime.ns
+            << ", without: " << noWorkerTime.ns << " \n";
+   */
+}
+
+TEST_CASE("madronalib/core/convolution/workers", "[convolution]")
+{
+  // a response long enough for segments on the workers, run as fast as the
+  // workers allow. Waiting for them before each call, no segment is missed.
+  std::vector<float> ir(24000);
+  NoiseGen noise;
+  for (size_t k = 0; k < ir.size(); ++k)
+  {
+    ir[k] = noise.getSample() * expf(-(k / 5000.f));
+  }
+  Convolver realTime(ir.data(), ir.size(), true);
+  std::chrono::duration<double> worstCall{0};
+  REQUIRE(realTime.getNumSegments() > 1);
+  REQUIRE(workerError(ir, realTime, false, worstCall) < 1e-3f);
+  REQUIRE(realTime.getNumMisses() == 0);
+}
+
+TEST_CASE("madronalib/core/convolution/real_time", "[convolution][.]")
+{
+  // run a twelve second response at 48kHz in real time, long enough for the
+  // largest segment to produce output. While the workers run the long jobs of
+  // the larger segments, the smaller ones must never miss their deadlines.
+  // The time of each call also depends on the OS scheduler, so it is only
+  // printed. This takes twelve seconds, so it is hidden: run it by name.
+  std::vector<float> ir(576000);
+  NoiseGen noise;
+  for (size_t k = 0; k < ir.size(); ++k)
+  {
+    ir[k] = noise.getSample() * expf(-(k / 100000.f));
+  }
+  Convolver realTime(ir.data(), ir.size(), true);
+  std::chrono::duration<double> worstCall{0};
+  const float maxError = workerError(ir, realTime, true, worstCall);
+  REQUIRE(realTime.getNumMisses() == 0);
+  REQUIRE(maxError < 1e-3f);
+
+  /*
+  std::cout << "real time convolution, 576000 samples: worst call " << worstCall.count() * 1e6
+            << " us\n";
+   */
+}
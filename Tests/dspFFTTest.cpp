@@ -0,0 +1,179 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <iostream>
+#include <vector>
+
+#include "catch.hpp"
+#include "madronalib.h"
+#include "mldsp.h"
+#include "tests.h"
+
+using namespace ml;
+
+namespace
+{
+float maxDifference(const std::vector<float>& a, const std::vector<float>& b)
+{
+  float d{0};
+  for (size_t i = 0; i < a.size(); ++i)
+  {
+    d = std::max(d, fabsf(a[i] - b[i]));
+  }
+  return d;
+}
+
+std::vector<float> testSignal(size_t size)
+{
+  std::vector<float> x(size);
+  NoiseGen noise;
+  for (auto& s : x)
+  {
+    s = noise.getSample();
+  }
+  return x;
+}
+}  // namespace
+
+TEST_CASE("madronalib/core/fft/layout", "[fft]")
+{
+  constexpr size_t kSize = 64;
+  constexpr size_t kHalf = kSize / 2;
+  FFT fft(kSize);
+  std::vector<float> x(kSize), y(kSize);
+
+  // a cosine at bin 3, a sine at bin 5, and the Nyquist frequency.
+  for (size_t n = 0; n < kSize; ++n)
+  {
+    x[n] = cosf(kTwoPi * 3 * n / kSize) + sinf(kTwoPi * 5 * n / kSize) + ((n & 1) ? -1.f : 1.f);
+  }
+  fft.forward(x.data(), y.data());
+  REQUIRE(fabsf(y[3] - kHalf) < 1e-3f);
+  REQUIRE(fabsf(y[kHalf + 3]) < 1e-3f);
+  REQUIRE(fabsf(y[5]) < 1e-3f);
+  REQUIRE(fabsf(y[kHalf + 5] + kHalf) < 1e-3f);
+  REQUIRE(fabsf(y[kHalf] - kSize) < 1e-3f);
+  REQUIRE(fabsf(y[0]) < 1e-3f);
+}
+
+TEST_CASE("madronalib/core/fft/round_trip", "[fft]")
+{
+  for (size_t size = 2; size <= 16384; size *= 2)
+  {
+    FFT fft(size);
+    auto x = testSignal(size);
+    std::vector<float> y(size), z(size);
+    fft.forward(x.data(), y.data());
+    fft.inverse(y.data(), z.data());
+    REQUIRE(maxDifference(x, z) < 1e-4f);
+  }
+
+  // fixed size, on DSPVectorArrays.
+  FixedFFT<10> fixedFFT;
+  FFT fft(1024);
+  constexpr size_t kRows = 1024 / kFloatsPerDSPVector;
+  DSPVectorArray<kRows> x;
+  NoiseGen noise;
+  for (int i = 0; i < 1024; ++i)
+  {
+    x[i] = noise.getSample();
+  }
+  auto fixedSpectrum = fixedFFT.forward(x);
+  auto spectrum = fft.forward(x);
+  REQUIRE(max(abs(fixedSpectrum.constRow(1) - spectrum.constRow(1))) < 1e-4f);
+  auto y = fixedFFT.inverse(fixedSpectrum);
+  for (size_t j = 0; j < kRows; ++j)
+  {
+    REQUIRE(max(abs(y.constRow(j) - x.constRow(j))) < 1e-5f);
+  }
+}
+
+TEST_CASE("madronalib/core/fft/multiply", "[fft]")
+{
+  // circular convolution by multiplying spectra should match the direct sum.
+  constexpr size_t kSize = 256;
+  FFT fft(kSize);
+  auto a = testSignal(kSize);
+  std::vector<float> b(kSize);
+  for (size_t n = 0; n < kSize; ++n)
+  {
+    b[n] = (n < 16) ? 1.f / (n + 1) : 0.f;
+  }
+
+  std::vector<float> direct(kSize);
+  for (size_t n = 0; n < kSize; ++n)
+  {
+    for (size_t k = 0; k < kSize; ++k)
+    {
+      direct[n] += a[k] * b[(n - k) & (kSize - 1)];
+    }
+  }
+
+  std::vector<float> sa(kSize), sb(kSize), product(kSize), y(kSize);
+  fft.forward(a.data(), sa.data());
+  fft.forward(b.data(), sb.data());
+  multiplySpectra(sa.data(), sb.data(), product.data(), kSize);
+  fft.inverse(product.data(), y.data());
+  REQUIRE(maxDifference(direct, y) < 1e-4f);
+
+  // multiplyAdd twice makes twice the product.
+  std::vector<float> sum(kSize);
+  multiplyAddSpectra(sa.data(), sb.data(), sum.data(), kSize);
+  multiplyAddSpectra(sa.data(), sb.data(), sum.data(), kSize);
+  fft.inverse(sum.data(), y.data());
+  for (auto& s : direct)
+  {
+    s *= 2.f;
+  }
+  REQUIRE(maxDifference(direct, y) < 1e-4f);
+}
+
+TEST_CASE("madronalib/core/fft/time", "[fft]")
+{
+  // time forward transforms against the raw ffft objects they use.
+  constexpr size_t kSize = 1024;
+  constexpr size_t kRows = kSize / kFloatsPerDSPVector;
+  FFT fft(kSize);
+  FixedFFT<10> fixedFFT;
+  ffft::FFTReal<float> rawFFT(kSize);
+  ffft::FFTRealFixLen<10> rawFixedFFT;
+
+  DSPVectorArray<kRows> x;
+  NoiseGen noise;
+  for (size_t i = 0; i < kSize; ++i)
+  {
+    x[i] = noise.getSample();
+  }
+
+  std::function<DSPVectorArray<kRows>(void)> runtimeSize = [&]() { return fft.forward(x); };
+  std::function<DSPVectorArray<kRows>(void)> fixedSize = [&]() { return fixedFFT.forward(x); };
+  std::function<DSPVectorArray<kRows>(void)> raw = [&]() {
+    DSPVectorArray<kRows> y(kUninitialized);
+    rawFFT.do_fft(y.getBuffer(), x.getConstBuffer());
+    return y;
+  };
+  std::function<DSPVectorArray<kRows>(void)> rawFixed = [&]() {
+    DSPVectorArray<kRows> y(kUninitialized);
+    rawFixedFFT.do_fft(y.getBuffer(), x.getConstBuffer());
+    return y;
+  };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto runtimeTime = timeIterationsInThread<DSPVectorArray<kRows> >(runtimeSize);
+  auto fixedTime = timeIterationsInThread<DSPVectorArray<kRows> >(fixedSize);
+  auto rawTime = timeIterationsInThread<DSPVectorArray<kRows> >(raw);
+  auto rawFixedTime = timeIterationsInThread<DSPVectorArray<kRows> >(rawFixed);
+#else
+  auto runtimeTime = timeIterations<DSPVectorArray<kRows> >(runtimeSize);
+  auto fixedTime = timeIterations<DSPVectorArray<kRows> >(fixedSize);
+  auto rawTime = timeIterations<DSPVectorArray<kRows> >(raw);
+  auto rawFixedTime = timeIterations<DSPVectorArray<kRows> >(rawFixed);
+#endif
+
+  /*
+  std::cout << "fft " << kSize << ": " << runtimeTime.ns << ", raw: " << rawTime.ns
+            << ", fixed: " << fixedTime.ns << ", raw fixed: " << rawFixedTime.ns << " \n";
+   */
+}
@@ -68,3 +68,1009 @@ TEST_CASE("madronalib/core/dsp_filters", "[dsp_filters]")
     DSPVector sineOut = downer.read();
   }
 }
+
+TEST_CASE("madronalib/core/dsp_filters/fade_period", "[dsp_filters]")
+{
+  // the pitchbendable delay crossfade must repeat exactly in each DSPVector,
+  // whatever the vector size.
+  using namespace PitchbendableDelayConsts;
+  constexpr int kFadesPerVector = kFloatsPerDSPVector / kFadePeriod;
+  int changes1{0}, changes2{0};
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    changes1 += (kvDelay1Changes[n] != 0);
+    changes2 += (kvDelay2Changes[n] != 0);
+  }
+  REQUIRE(changes1 == kFadesPerVector);
+  REQUIRE(changes2 == kFadesPerVector);
+  REQUIRE(kvFade[0] == 0.f);
+  REQUIRE(kvFade[kFadePeriod / 2] == 1.f);
+}
+
+// run a Bank and an InterleavedBank of the same filters on the same noise and
+// return the largest difference between their outputs.
+template <typename T, int VOICES>
+float compareInterleavedBank(std::function<void(T&, int)> setCoeffs)
+{
+  Bank<T, VOICES> bank;
+  InterleavedBank<T, VOICES> interleavedBank;
+  for (int v = 0; v < VOICES; ++v)
+  {
+    setCoeffs(bank[v], v);
+    setCoeffs(interleavedBank[v], v);
+  }
+
+  NoiseGen noise;
+  float maxDiff{0.f};
+  for (int i = 0; i < 8; ++i)
+  {
+    auto x = map([&](DSPVector) { return noise(); }, DSPVectorArray<VOICES>());
+    auto diff = abs(bank(x) - interleavedBank(x));
+    for (int v = 0; v < VOICES; ++v)
+    {
+      maxDiff = std::max(maxDiff, max(diff.constRow(v)));
+    }
+  }
+  return maxDiff;
+}
+
+TEST_CASE("madronalib/core/dsp_filters/interleaved_bank", "[dsp_filters]")
+{
+  // odd voice counts leave some SIMD lanes unused.
+  constexpr int kVoices{13};
+  constexpr float kMaxDiff{1e-4f};
+
+  auto omegaOf = [](int v) { return 0.01f + 0.02f * v; };
+  std::vector<float> diffs;
+  diffs.push_back(compareInterleavedBank<Lopass, kVoices>(
+      [&](Lopass& f, int v) { f._coeffs = Lopass::makeCoeffs(omegaOf(v), 0.5f); }));
+  diffs.push_back(compareInterleavedBank<Hipass, kVoices>(
+      [&](Hipass& f, int v) { f.mCoeffs = Hipass::coeffs(omegaOf(v), 0.5f); }));
+  diffs.push_back(compareInterleavedBank<Bandpass, kVoices>(
+      [&](Bandpass& f, int v) { f.mCoeffs = Bandpass::coeffs(omegaOf(v), 0.5f); }));
+  diffs.push_back(compareInterleavedBank<OnePole, kVoices>(
+      [&](OnePole& f, int v) { f.mCoeffs = OnePole::coeffs(omegaOf(v)); }));
+  diffs.push_back(compareInterleavedBank<DCBlocker, kVoices>(
+      [&](DCBlocker& f, int v) { f.mCoeffs = DCBlocker::coeffs(omegaOf(v)); }));
+  diffs.push_back(compareInterleavedBank<Integrator, kVoices>(
+      [&](Integrator& f, int v) { f.mLeak = 0.01f * v; }));
+  diffs.push_back(compareInterleavedBank<Allpass1, kVoices>(
+      [&](Allpass1& f, int v) { f.mCoeffs = Allpass1::coeffs(0.7f + 0.05f * v); }));
+  for (float d : diffs)
+  {
+    REQUIRE(d < kMaxDiff);
+  }
+
+  // time a 16-voice lopass bank, serial and interleaved.
+  constexpr int kTimeVoices{16};
+  Bank<Lopass, kTimeVoices> bank;
+  InterleavedBank<Lopass, kTimeVoices> interleavedBank;
+  for (int v = 0; v < kTimeVoices; ++v)
+  {
+    bank[v]._coeffs = interleavedBank[v]._coeffs = Lopass::makeCoeffs(omegaOf(v), 0.5f);
+  }
+  DSPVectorArray<kTimeVoices> input{repeatRows<kTimeVoices>(columnIndex()) * 0.01f};
+
+  std::function<DSPVectorArray<kTimeVoices>(void)> serial = [&]() { return bank(input); };
+  std::function<DSPVectorArray<kTimeVoices>(void)> interleaved = [&]() {
+    return interleavedBank(input);
+  };
+
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto serialTime = timeIterationsInThread<DSPVectorArray<kTimeVoices> >(serial);
+  auto interleavedTime = timeIterationsInThread<DSPVectorArray<kTimeVoices> >(interleaved);
+#else
+  auto serialTime = timeIterations<DSPVectorArray<kTimeVoices> >(serial);
+  auto interleavedTime = timeIterations<DSPVectorArray<kTimeVoices> >(interleaved);
+#endif
+
+  /*
+  std::cout << "lopass bank, " << kTimeVoices << " voices: serial: " << serialTime.ns
+            << ", interleaved: " << interleavedTime.ns << " \n";
+   */
+}
+
+// run a filter and a BlockIIR made with the same coefficients on noise and
+// return the maximum difference between their outputs.
+template <typename T>
+float compareBlockIIR(std::function<void(T&)> setCoeffs)
+{
+  T filter;
+  BlockIIR<T> blockIIR;
+  setCoeffs(filter);
+  setCoeffs(blockIIR.processor());
+
+  NoiseGen noise;
+  float maxDiff{0.f};
+  for (int i = 0; i < 16; ++i)
+  {
+    DSPVector x = noise();
+    maxDiff = std::max(maxDiff, max(abs(filter(x) - blockIIR(x))));
+  }
+  return maxDiff;
+}
+
+TEST_CASE("madronalib/core/dsp_filters/block_iir", "[dsp_filters]")
+{
+  constexpr float kMaxDiff{1e-4f};
+
+  std::vector<float> diffs;
+  diffs.push_back(compareBlockIIR<Lopass>(
+      [&](Lopass& f) { f._coeffs = Lopass::makeCoeffs(0.05f, 0.5f); }));
+  diffs.push_back(compareBlockIIR<Hipass>(
+      [&](Hipass& f) { f.mCoeffs = Hipass::coeffs(0.05f, 0.5f); }));
+  diffs.push_back(compareBlockIIR<Bandpass>(
+      [&](Bandpass& f) { f.mCoeffs = Bandpass::coeffs(0.2f, 0.1f); }));
+  diffs.push_back(compareBlockIIR<OnePole>(
+      [&](OnePole& f) { f.mCoeffs = OnePole::coeffs(0.01f); }));
+  diffs.push_back(compareBlockIIR<DCBlocker>(
+      [&](DCBlocker& f) { f.mCoeffs = DCBlocker::coeffs(0.045f); }));
+  diffs.push_back(compareBlockIIR<Integrator>([&](Integrator& f) { f.mLeak = 0.05f; }));
+  diffs.push_back(compareBlockIIR<Allpass1>(
+      [&](Allpass1& f) { f.mCoeffs = Allpass1::coeffs(0.8f); }));
+  for (float d : diffs)
+  {
+    REQUIRE(d < kMaxDiff);
+  }
+
+  // time a single lopass, serial and in blocks.
+  Lopass lopass;
+  BlockIIR<Lopass> blockLopass;
+  lopass._coeffs = blockLopass.processor()._coeffs = Lopass::makeCoeffs(0.05f, 0.5f);
+  DSPVector input{columnIndex() * 0.01f};
+
+  std::function<DSPVector(void)> serial = [&]() { return lopass(input); };
+  std::function<DSPVector(void)> block = [&]() { return blockLopass(input); };
+
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto serialTime = timeIterationsInThread<DSPVector>(serial);
+  auto blockTime = timeIterationsInThread<DSPVector>(block);
+#else
+  auto serialTime = timeIterations<DSPVector>(serial);
+  auto blockTime = timeIterations<DSPVector>(block);
+#endif
+
+  /*
+  std::cout << "lopass serial: " << serialTime.ns << ", block: " << blockTime.ns << " \n";
+   */
+}
+
+// the scalar half band filter, one channel at a time, as a reference.
+struct ScalarHalfBand
+{
+  Allpass1 apa0{0.07986642623635751f}, apa1{0.5453536510711322f}, apb0{0.28382934487410993f},
+      apb1{0.8344118914807379f};
+  float b1{0};
+
+  DSPVector upsample(const DSPVector& vx, int start)
+  {
+    DSPVector vy;
+    for (int i = 0; i < kFloatsPerDSPVector / 2; ++i)
+    {
+      vy[2 * i] = apa1.processSample(apa0.processSample(vx[start + i]));
+      vy[2 * i + 1] = apb1.processSample(apb0.processSample(vx[start + i]));
+    }
+    return vy;
+  }
+
+  DSPVector downsample(const DSPVector& vx1, const DSPVector& vx2)
+  {
+    DSPVector vy;
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      const DSPVector& vx = (i < kFloatsPerDSPVector / 2) ? vx1 : vx2;
+      const int i2 = (i % (kFloatsPerDSPVector / 2)) * 2;
+      float a0 = apa1.processSample(apa0.processSample(vx[i2]));
+      float b0 = apb1.processSample(apb0.processSample(vx[i2 + 1]));
+      vy[i] = (a0 + b1) * 0.5f;
+      b1 = b0;
+    }
+    return vy;
+  }
+};
+
+// run noise through a HalfBandFilterArray and the scalar filters, up and down,
+// and return the maximum difference between their outputs.
+template <size_t CHANNELS>
+float compareHalfBand()
+{
+  HalfBandFilterArray<CHANNELS> up, down;
+  std::array<ScalarHalfBand, CHANNELS> scalarUp, scalarDown;
+  WhiteNoiseGen<CHANNELS> noise;
+  float maxDiff{0.f};
+  for (int v = 0; v < 8; ++v)
+  {
+    DSPVectorArray<CHANNELS> x1 = noise(), x2 = noise();
+    auto y1 = up.upsampleFirstHalf(x1);
+    auto y2 = up.upsampleSecondHalf(x1);
+    auto z = down.downsample(x1, x2);
+    for (size_t c = 0; c < CHANNELS; ++c)
+    {
+      DSPVector scalarY1 = scalarUp[c].upsample(x1.constRow(c), 0);
+      DSPVector scalarY2 = scalarUp[c].upsample(x1.constRow(c), kFloatsPerDSPVector / 2);
+      DSPVector scalarZ = scalarDown[c].downsample(x1.constRow(c), x2.constRow(c));
+      maxDiff = std::max(maxDiff, max(abs(y1.constRow(c) - scalarY1)));
+      maxDiff = std::max(maxDiff, max(abs(y2.constRow(c) - scalarY2)));
+      maxDiff = std::max(maxDiff, max(abs(z.constRow(c) - scalarZ)));
+    }
+  }
+  return maxDiff;
+}
+
+TEST_CASE("madronalib/core/dsp_filters/half_band", "[dsp_filters]")
+{
+  // channel counts that do and don't fill the SIMD lanes.
+  constexpr float kMaxDiff{1e-5f};
+  REQUIRE(compareHalfBand<1>() < kMaxDiff);
+  REQUIRE(compareHalfBand<2>() < kMaxDiff);
+  REQUIRE(compareHalfBand<3>() < kMaxDiff);
+  REQUIRE(compareHalfBand<8>() < kMaxDiff);
+
+  // a low sine upsampled and downsampled by two octaves comes back, delayed.
+  constexpr int kOctaves{2};
+  constexpr size_t kChannels{4};
+  UpsamplerArray<kChannels> upper(kOctaves);
+  DownsamplerArray<kChannels> downer(kOctaves);
+  float phase{0.f};
+  const float omega{kTwoPi / 64.f};
+  float peak{0.f};
+  for (int v = 0; v < 32; ++v)
+  {
+    DSPVector x = sin(columnIndex() * omega + phase);
+    phase = fmodf(phase + omega * kFloatsPerDSPVector, kTwoPi);
+    DSPVectorArray<kChannels> xs = repeatRows<kChannels>(x);
+    upper.write(xs);
+    for (int i = 0; i < (1 << kOctaves); ++i)
+    {
+      if (downer.write(upper.read()))
+      {
+        auto y = downer.read();
+        REQUIRE(y.constRow(0) == y.constRow(kChannels - 1));
+        if (v > 4) peak = std::max(peak, max(y.constRow(0)));
+      }
+    }
+  }
+  REQUIRE(fabsf(peak - 1.f) < 0.02f);
+
+  // time 2x upsampling and downsampling of 8 channels, scalar and in SIMD.
+  constexpr size_t kTimeChannels{8};
+  HalfBandFilterArray<kTimeChannels> simdFilter;
+  std::array<ScalarHalfBand, kTimeChannels> scalarFilters;
+  DSPVectorArray<kTimeChannels> input{repeatRows<kTimeChannels>(columnIndex()) * 0.01f};
+
+  std::function<DSPVectorArray<kTimeChannels>(void)> scalar = [&]() {
+    DSPVectorArray<kTimeChannels> y;
+    for (size_t c = 0; c < kTimeChannels; ++c)
+    {
+      DSPVector a = scalarFilters[c].upsample(input.constRow(c), 0);
+      DSPVector b = scalarFilters[c].upsample(input.constRow(c), kFloatsPerDSPVector / 2);
+      y.row(c) = scalarFilters[c].downsample(a, b);
+    }
+    return y;
+  };
+  std::function<DSPVectorArray<kTimeChannels>(void)> simd = [&]() {
+    auto a = simdFilter.upsampleFirstHalf(input);
+    auto b = simdFilter.upsampleSecondHalf(input);
+    return simdFilter.downsample(a, b);
+  };
+
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto scalarTime = timeIterationsInThread<DSPVectorArray<kTimeChannels> >(scalar);
+  auto simdTime = timeIterationsInThread<DSPVectorArray<kTimeChannels> >(simd);
+#else
+  auto scalarTime = timeIterations<DSPVectorArray<kTimeChannels> >(scalar);
+  auto simdTime = timeIterations<DSPVectorArray<kTimeChannels> >(simd);
+#endif
+
+  /*
+  std::cout << "half band, " << kTimeChannels << " channels: scalar: " << scalarTime.ns
+            << ", simd: " << simdTime.ns << " \n";
+   */
+}
+
+// run a sine through an OversampleFunction with an identity function, and
+// return the largest difference from the sine delayed by the reported latency.
+template <template <size_t> class HALF_BAND>
+float oversampleDelayError(int octaves, float freq)
+{
+  OversampleFunction<2, HALF_BAND> oversample(octaves);
+  auto identity = [](const DSPVectorArray<2>& x) { return x; };
+  const float latency = oversample.getLatency();
+  const float omega = kTwoPi * freq;
+  float maxError{0.f};
+  for (int v = 0; v < 64; ++v)
+  {
+    DSPVector t = columnIndex() + float(v * kFloatsPerDSPVector);
+    DSPVectorArray<2> x = concatRows(sin(t * omega), cos(t * omega));
+    DSPVectorArray<2> y = oversample(identity, x);
+    if (v > 16)
+    {
+      DSPVector expected = sin((t - latency) * omega);
+      maxError = std::max(maxError, max(abs(y.constRow(0) - expected)));
+    }
+  }
+  return maxError;
+}
+
+TEST_CASE("madronalib/core/dsp_filters/oversample", "[dsp_filters]")
+{
+  // the output is the input delayed by the latency, exactly for the linear phase
+  // filters and nearly for the allpass ones at a low frequency.
+  for (int octaves = 1; octaves <= 4; ++octaves)
+  {
+    REQUIRE(oversampleDelayError<HalfBandFIRArray>(octaves, 0.05f) < 1e-3f);
+    REQUIRE(oversampleDelayError<HalfBandFilterArray>(octaves, 0.005f) < 1e-3f);
+  }
+  OversampleFunction<1, HalfBandFIRArray> fir2x(1);
+  REQUIRE(fir2x.getLatency() == HalfBandFIRArray<1>::kGroupDelay);
+
+  // a lambda with large captures can be passed directly. A constant input passes
+  // through at the captured gain once the filters have settled.
+  std::array<float, 256> gains;
+  gains.fill(0.5f);
+  auto gain = [gains](const DSPVectorArray<1>& x) { return x * gains[0]; };
+  DSPVectorArray<1> y;
+  for (int v = 0; v < 8; ++v)
+  {
+    y = fir2x(gain, DSPVectorArray<1>(1.f));
+  }
+  REQUIRE(max(abs(y - DSPVectorArray<1>(0.5f))) < 1e-3f);
+
+  // time a clipper at 1x, and at 4x with each kind of filter.
+  constexpr size_t kRows{2};
+  OversampleFunction<kRows> allpass4x(2);
+  OversampleFunction<kRows, HalfBandFIRArray> fir4x(2);
+  auto clip = [](const DSPVectorArray<kRows>& x) {
+    return clamp(x * 4.f, DSPVectorArray<kRows>(-1.f), DSPVectorArray<kRows>(1.f));
+  };
+  DSPVectorArray<kRows> input{repeatRows<kRows>(sin(columnIndex() * 0.1f))};
+
+  std::function<DSPVectorArray<kRows>(void)> direct = [&]() { return clip(input); };
+  std::function<DSPVectorArray<kRows>(void)> allpass = [&]() { return allpass4x(clip, input); };
+  std::function<DSPVectorArray<kRows>(void)> fir = [&]() { return fir4x(clip, input); };
+
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto directTime = timeIterationsInThread<DSPVectorArray<kRows> >(direct);
+  auto allpassTime = timeIterationsInThread<DSPVectorArray<kRows> >(allpass);
+  auto firTime = timeIterationsInThread<DSPVectorArray<kRows> >(fir);
+#else
+  auto directTime = timeIterations<DSPVectorArray<kRows> >(direct);
+  auto allpassTime = timeIterations<DSPVectorArray<kRows> >(allpass);
+  auto firTime = timeIterations<DSPVectorArray<kRows> >(fir);
+#endif
+
+  /*
+  std::cout << "stereo clip: 1x: " << directTime.ns << ", 4x allpass: " << allpassTime.ns
+            << ", 4x fir: " << firTime.ns << " \n";
+   */
+}
+
+// run a sine through a ModulatedDelay with a delay swept between minDelay and
+// maxDelay, and return the largest difference from the exactly delayed sine.
+template <int INTERPOLATION>
+float modulatedDelayError(float freq, double minDelay, double maxDelay)
+{
+  ModulatedDelay<INTERPOLATION> delay(static_cast<float>(maxDelay));
+  const double omega = kTwoPi * double(freq);
+  const double sweep = kTwoPi * 0.0037;
+  float maxError{0.f};
+  for (int v = 0; v < 64; ++v)
+  {
+    DSPVector x(kUninitialized), d(kUninitialized), expected(kUninitialized);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      const double t = v * kFloatsPerDSPVector + n;
+      const double dt = minDelay + (maxDelay - minDelay) * (0.5 + 0.5 * std::sin(sweep * t));
+      x[n] = float(std::sin(omega * t));
+      d[n] = float(dt);
+      expected[n] = float(std::sin(omega * (t - dt)));
+    }
+    DSPVector y = delay(x, d);
+    if (v * kFloatsPerDSPVector > maxDelay + 8)
+    {
+      maxError = std::max(maxError, max(abs(y - expected)));
+    }
+  }
+  return maxError;
+}
+
+TEST_CASE("madronalib/core/dsp_filters/modulated_delay", "[dsp_filters]")
+{
+  // errors on a sine at a tenth of the sample rate, for long and short delays.
+  for (double maxDelay : {3.5, 40.5, 1000.})
+  {
+    REQUIRE(modulatedDelayError<kLinearInterpolation>(0.1f, 3., maxDelay) < 6e-2f);
+    REQUIRE(modulatedDelayError<kCubicInterpolation>(0.1f, 3., maxDelay) < 1e-2f);
+    REQUIRE(modulatedDelayError<kSincInterpolation>(0.1f, 3., maxDelay) < 2e-3f);
+  }
+
+  // delays are clamped to the range each kind of interpolation can read.
+  ModulatedDelay<kCubicInterpolation> clamped(10.f);
+  DSPVector impulse;
+  impulse[0] = 1.f;
+  DSPVector y = clamped(impulse, DSPVector(-5.f));
+  REQUIRE(y[1] == 1.f);
+  clamped.clear();
+  y = clamped(impulse, DSPVector(100.f));
+  REQUIRE(y[10] == 1.f);
+
+  // time a chorus-like sweep with each kind of interpolation, and with the
+  // allpass-interpolated FractionalDelay.
+  DSPVector input = sin(columnIndex() * 0.1f);
+  DSPVector delayTime = DSPVector(200.f) + sin(columnIndex() * 0.01f) * DSPVector(20.f);
+  FractionalDelay allpassDelay(256.f);
+  ModulatedDelay<kLinearInterpolation> linearDelay(256.f);
+  ModulatedDelay<kCubicInterpolation> cubicDelay(256.f);
+  ModulatedDelay<kSincInterpolation> sincDelay(256.f);
+
+  std::function<DSPVector(void)> allpass = [&]() { return allpassDelay(input, delayTime); };
+  std::function<DSPVector(void)> linear = [&]() { return linearDelay(input, delayTime); };
+  std::function<DSPVector(void)> cubic = [&]() { return cubicDelay(input, delayTime); };
+  std::function<DSPVector(void)> sinc = [&]() { return sincDelay(input, delayTime); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto allpassTime = timeIterationsInThread<DSPVector>(allpass);
+  auto linearTime = timeIterationsInThread<DSPVector>(linear);
+  auto cubicTime = timeIterationsInThread<DSPVector>(cubic);
+  auto sincTime = timeIterationsInThread<DSPVector>(sinc);
+#else
+  auto allpassTime = timeIterations<DSPVector>(allpass);
+  auto linearTime = timeIterations<DSPVector>(linear);
+  auto cubicTime = timeIterations<DSPVector>(cubic);
+  auto sincTime = timeIterations<DSPVector>(sinc);
+#endif
+
+  /*
+  std::cout << "modulated delay: allpass: " << allpassTime.ns << ", linear: " << linearTime.ns
+            << ", cubic: " << cubicTime.ns << ", sinc: " << sincTime.ns << " \n";
+   */
+}
+
+// compare the fixed taps of a MultiTapDelay with modulated reads of the same
+// constant delays, and return the largest difference.
+template <int INTERPOLATION>
+float multiTapError(const std::array<float, 4>& delays)
+{
+  MultiTapDelay<4, INTERPOLATION> fixedTaps(300.f);
+  MultiTapDelay<4, INTERPOLATION> modulatedTaps(300.f);
+  fixedTaps.setDelaysInSamples(delays);
+  DSPVectorArray<4> vDelays;
+  for (int j = 0; j < 4; ++j)
+  {
+    vDelays.row(j) = DSPVector(delays[j]);
+  }
+
+  NoiseGen noise;
+  float maxError{0.f};
+  for (int v = 0; v < 32; ++v)
+  {
+    DSPVector x = noise();
+    DSPVectorArray<4> y1 = fixedTaps(x);
+    DSPVectorArray<4> y2 = modulatedTaps(x, vDelays);
+    for (int j = 0; j < 4; ++j)
+    {
+      maxError = std::max(maxError, max(abs(y1.constRow(j) - y2.constRow(j))));
+    }
+  }
+  return maxError;
+}
+
+TEST_CASE("madronalib/core/dsp_filters/multi_tap_delay", "[dsp_filters]")
+{
+  // integer taps match IntegerDelays.
+  constexpr size_t kTaps{8};
+  std::array<float, kTaps> delays{{0.f, 1.f, 7.f, 63.f, 64.f, 65.f, 200.f, 511.f}};
+  MultiTapDelay<kTaps> multiTap(512.f);
+  multiTap.setDelaysInSamples(delays);
+  std::array<IntegerDelay, kTaps> integerDelays;
+  for (size_t j = 0; j < kTaps; ++j)
+  {
+    integerDelays[j].setMaxDelayInSamples(512.f);
+    integerDelays[j].setDelayInSamples(int(delays[j]));
+  }
+  NoiseGen noise;
+  float maxError{0.f};
+  for (int v = 0; v < 64; ++v)
+  {
+    DSPVector x = noise();
+    DSPVectorArray<kTaps> y = multiTap(x);
+    for (size_t j = 0; j < kTaps; ++j)
+    {
+      maxError = std::max(maxError, max(abs(y.constRow(j) - integerDelays[j](x))));
+    }
+  }
+  REQUIRE(maxError < 1e-6f);
+
+  // fractional taps read the same with constant and modulated delays.
+  std::array<float, 4> fractional{{3.25f, 10.5f, 99.9f, 250.01f}};
+  REQUIRE(multiTapError<kLinearInterpolation>(fractional) < 1e-6f);
+  REQUIRE(multiTapError<kCubicInterpolation>(fractional) < 1e-6f);
+  REQUIRE(multiTapError<kSincInterpolation>(fractional) < 1e-6f);
+
+  // time eight taps against eight IntegerDelays.
+  DSPVector input = sin(columnIndex() * 0.1f);
+  std::function<DSPVectorArray<kTaps>(void)> multi = [&]() { return multiTap(input); };
+  std::function<DSPVectorArray<kTaps>(void)> separate = [&]() {
+    DSPVectorArray<kTaps> y;
+    for (size_t j = 0; j < kTaps; ++j)
+    {
+      y.row(j) = integerDelays[j](input);
+    }
+    return y;
+  };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto multiTime = timeIterationsInThread<DSPVectorArray<kTaps> >(multi);
+  auto separateTime = timeIterationsInThread<DSPVectorArray<kTaps> >(separate);
+#else
+  auto multiTime = timeIterations<DSPVectorArray<kTaps> >(multi);
+  auto separateTime = timeIterations<DSPVectorArray<kTaps> >(separate);
+#endif
+
+  /*
+  std::cout << "8 taps: multi-tap: " << multiTime.ns << ", separate delays: " << separateTime.ns
+            << " \n";
+   */
+}
+
+// run a ModulatedFDN without modulation on a burst of noise, alongside a
+// direct computation of the network in double precision, and return the
+// largest difference.
+template <int MIXING>
+float modulatedFDNError()
+{
+  constexpr int kSize{16};
+  constexpr int kOutputs{3};
+  constexpr int kVectors{64};
+  constexpr int kSamples{kVectors * kFloatsPerDSPVector};
+
+  std::array<float, kSize> times, omegas;
+  for (int i = 0; i < kSize; ++i)
+  {
+    times[i] = float(kFloatsPerDSPVector + 17 + 37 * i);
+    omegas[i] = 0.05f + 0.01f * i;
+  }
+  ModulatedFDN<kSize, kOutputs, MIXING> fdn;
+  fdn.setDelaysInSamples(times);
+  fdn.setFilterCutoffs(omegas);
+  for (int i = 0; i < kSize; ++i)
+  {
+    fdn.mFeedbackGains[i] = 0.9f - 0.01f * i;
+  }
+
+  std::vector<float> x(kSamples);
+  NoiseGen noise;
+  for (int t = 0; t < kFloatsPerDSPVector * 4; ++t)
+  {
+    x[t] = noise.getSample();
+  }
+
+  // the inputs to each delay line, and the state of each filter.
+  std::vector<std::vector<double> > lineInputs(kSize, std::vector<double>(kSamples));
+  std::array<double, kSize> y, mixed, filterState{};
+  const double outputScale = std::sqrt(double(kOutputs) / kSize);
+
+  float maxError{0.f};
+  for (int v = 0; v < kVectors; ++v)
+  {
+    DSPVector in(kUninitialized);
+    std::copy(x.data() + v * kFloatsPerDSPVector, x.data() + (v + 1) * kFloatsPerDSPVector,
+              in.getBuffer());
+    DSPVectorArray<kOutputs> out = fdn(in);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      const int t = v * kFloatsPerDSPVector + n;
+      for (int i = 0; i < kSize; ++i)
+      {
+        const int readTime = t - int(times[i]);
+        y[i] = (readTime >= 0) ? lineInputs[i][readTime] : 0.;
+      }
+      for (int o = 0; o < kOutputs; ++o)
+      {
+        double sum{0};
+        for (int i = o; i < kSize; i += kOutputs)
+        {
+          sum += y[i];
+        }
+        maxError = std::max(maxError, fabsf(out.constRow(o)[n] - float(sum * outputScale)));
+      }
+
+      double ySum{0};
+      for (int i = 0; i < kSize; ++i)
+      {
+        ySum += y[i];
+      }
+      for (int i = 0; i < kSize; ++i)
+      {
+        if (MIXING == kHadamardMixing)
+        {
+          // the elements of the Sylvester Hadamard matrix are -1 to the power of
+          // the number of bits i and j have in common.
+          double sum{0};
+          for (int j = 0; j < kSize; ++j)
+          {
+            int parity{0};
+            for (int b = i & j; b; b >>= 1)
+            {
+              parity ^= b & 1;
+            }
+            sum += parity ? -y[j] : y[j];
+          }
+          mixed[i] = sum / std::sqrt(double(kSize));
+        }
+        else
+        {
+          mixed[i] = y[i] - ySum * 2. / kSize;
+        }
+      }
+      for (int i = 0; i < kSize; ++i)
+      {
+        const auto c = OnePole::coeffs(omegas[i]);
+        filterState[i] = c.a0 * mixed[i] + c.b1 * filterState[i];
+        lineInputs[i][t] = filterState[i] * fdn.mFeedbackGains[i] + x[t];
+      }
+    }
+  }
+  return maxError;
+}
+
+TEST_CASE("madronalib/core/dsp_filters/modulated_fdn", "[dsp_filters]")
+{
+  REQUIRE(modulatedFDNError<kHadamardMixing>() < 1e-4f);
+  REQUIRE(modulatedFDNError<kHouseholderMixing>() < 1e-4f);
+
+  // with modulation and no damping, an impulse decays by 60 dB in the decay
+  // time, give or take the modulation.
+  constexpr int kSize{32};
+  constexpr float kDecayTime{12000.f};
+  std::array<float, kSize> times;
+  for (int i = 0; i < kSize; ++i)
+  {
+    times[i] = 400.f + 61.3f * i;
+  }
+  ModulatedFDN<kSize> fdn;
+  fdn.setModulation(8.f, 1.f / 20000.f);
+  fdn.setDelaysInSamples(times);
+  fdn.setDecayTimeInSamples(kDecayTime);
+
+  auto rms = [&](int samples) {
+    double sum{0};
+    for (int v = 0; v < samples / kFloatsPerDSPVector; ++v)
+    {
+      DSPVectorArray<2> y = fdn(DSPVector(0.f));
+      sum += ml::sum(y.constRow(0) * y.constRow(0) + y.constRow(1) * y.constRow(1));
+    }
+    return std::sqrt(sum / samples);
+  };
+  DSPVector impulse;
+  impulse[0] = 1.f;
+  fdn(impulse);
+  rms(4096);
+  const double early = rms(4096);
+  rms(int(kDecayTime) - 4096);
+  const double late = rms(4096);
+  const double decayInDB = 20. * std::log10(late / early);
+  REQUIRE(decayInDB < -55.);
+  REQUIRE(decayInDB > -65.);
+
+  // time 16 and 64 modulated lines against an eight line FDN.
+  FDN<8> fdn8;
+  fdn8.setDelaysInSamples({{400.f, 461.f, 523.f, 587.f, 641.f, 701.f, 769.f, 829.f}});
+  fdn8.setFilterCutoffs({{0.1f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f}});
+  fdn8.mFeedbackGains = {{0.9f, 0.9f, 0.9f, 0.9f, 0.9f, 0.9f, 0.9f, 0.9f}};
+  ModulatedFDN<16> fdn16;
+  ModulatedFDN<64> fdn64;
+  std::array<float, 16> times16;
+  std::array<float, 64> times64;
+  for (int i = 0; i < 64; ++i)
+  {
+    if (i < 16) times16[i] = 400.f + 29.f * i;
+    times64[i] = 400.f + 29.f * i;
+  }
+  fdn16.setModulation(8.f, 1.f / 20000.f);
+  fdn16.setDelaysInSamples(times16);
+  fdn16.setDecayTimeInSamples(48000.f);
+  fdn64.setModulation(8.f, 1.f / 20000.f);
+  fdn64.setDelaysInSamples(times64);
+  fdn64.setDecayTimeInSamples(48000.f);
+
+  DSPVector input = sin(columnIndex() * 0.1f);
+  std::function<DSPVectorArray<2>(void)> run8 = [&]() { return fdn8(input); };
+  std::function<DSPVectorArray<2>(void)> run16 = [&]() { return fdn16(input); };
+  std::function<DSPVectorArray<2>(void)> run64 = [&]() { return fdn64(input); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto time8 = timeIterationsInThread<DSPVectorArray<2> >(run8);
+  auto time16 = timeIterationsInThread<DSPVectorArray<2> >(run16);
+  auto time64 = timeIterationsInThread<DSPVectorArray<2> >(run64);
+#else
+  auto time8 = timeIterations<DSPVectorArray<2> >(run8);
+  auto time16 = timeIterations<DSPVectorArray<2> >(run16);
+  auto time64 = timeIterations<DSPVectorArray<2> >(run64);
+#endif
+
+  /*
+  std::cout << "FDN<8>: " << time8.ns << ", ModulatedFDN<16>: " << time16.ns
+            << ", ModulatedFDN<64>: " << time64.ns << " \n";
+   */
+}
+
+// run a plucked string loop in a SubBlockFeedbackDelayFunction, with its delay
+// time swept by depth samples around delay, alongside a direct computation of
+// the loop one sample at a time in double precision, and return the largest
+// difference.
+template <int BLOCK>
+float subBlockFeedbackError(float delay, float depth)
+{
+  constexpr int kVectors{16};
+  constexpr int kSamples{kVectors * kFloatsPerDSPVector};
+  constexpr float kMaxDelay{100.f};
+  SubBlockFeedbackDelayFunction<BLOCK> loop(kMaxDelay);
+  loop.feedbackGain = 0.99f;
+
+  // the loop filter averages each sample with the one before.
+  float x1{0.f};
+  auto averageFn = [&](float* p) {
+    for (int n = 0; n < BLOCK; ++n)
+    {
+      const float x = p[n];
+      p[n] = 0.5f * (x + x1);
+      x1 = x;
+    }
+  };
+
+  std::vector<float> x(kSamples), delays(kSamples);
+  NoiseGen noise;
+  for (int t = 0; t < kSamples; ++t)
+  {
+    x[t] = (t < kFloatsPerDSPVector) ? noise.getSample() : 0.f;
+    delays[t] = delay + depth * sinf(t * 0.01f);
+  }
+
+  std::vector<double> outputs(kSamples);
+  double refX1{0};
+  float maxError{0.f};
+  for (int v = 0; v < kVectors; ++v)
+  {
+    DSPVector in(kUninitialized), vDelay(kUninitialized);
+    std::copy(x.data() + v * kFloatsPerDSPVector, x.data() + (v + 1) * kFloatsPerDSPVector,
+              in.getBuffer());
+    std::copy(delays.data() + v * kFloatsPerDSPVector,
+              delays.data() + (v + 1) * kFloatsPerDSPVector, vDelay.getBuffer());
+    DSPVector y = loop(in, averageFn, vDelay);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      const int t = v * kFloatsPerDSPVector + n;
+      const double d = std::min(std::max(double(delays[t]), double(BLOCK)), double(kMaxDelay));
+      const int delayInt = int(d);
+      const double frac = d - delayInt;
+      auto output = [&](int time) { return (time >= 0) ? outputs[time] : 0.; };
+      const double later = output(t - delayInt);
+      const double earlier = output(t - delayInt - 1);
+      const double loopInput = x[t] + 0.99 * (later + frac * (earlier - later));
+      outputs[t] = 0.5 * (loopInput + refX1);
+      refX1 = loopInput;
+      maxError = std::max(maxError, fabsf(y[n] - float(outputs[t])));
+    }
+  }
+  return maxError;
+}
+
+TEST_CASE("madronalib/core/dsp_filters/sub_block_feedback", "[dsp_filters]")
+{
+  // loops shorter than the blocks of larger sizes.
+  REQUIRE(subBlockFeedbackError<1>(3.25f, 0.f) < 1e-4f);
+  REQUIRE(subBlockFeedbackError<1>(5.5f, 2.f) < 1e-4f);
+  REQUIRE(subBlockFeedbackError<4>(10.5f, 3.f) < 1e-4f);
+  REQUIRE(subBlockFeedbackError<8>(10.5f, 0.f) < 1e-4f);
+
+  // all sizes, with delays clamped at both ends.
+  REQUIRE(subBlockFeedbackError<1>(40.f, 70.f) < 1e-4f);
+  REQUIRE(subBlockFeedbackError<4>(40.f, 70.f) < 1e-4f);
+  REQUIRE(subBlockFeedbackError<8>(40.f, 70.f) < 1e-4f);
+  REQUIRE(subBlockFeedbackError<16>(40.f, 70.f) < 1e-4f);
+
+  // time a plucked string loop of 100 samples in each sub-block size, and in a
+  // FeedbackDelayFunction.
+  DSPVector input = sin(columnIndex() * 0.1f) * DSPVector(0.01f);
+  DSPVector vDelay(100.f);
+  float x1{0.f};
+  auto averageFn = [&](float* p, int samples) {
+    for (int n = 0; n < samples; ++n)
+    {
+      const float x = p[n];
+      p[n] = 0.5f * (x + x1);
+      x1 = x;
+    }
+  };
+  SubBlockFeedbackDelayFunction<1> loop1(128.f);
+  SubBlockFeedbackDelayFunction<4> loop4(128.f);
+  SubBlockFeedbackDelayFunction<16> loop16(128.f);
+  FeedbackDelayFunction vectorLoop;
+  loop1.feedbackGain = loop4.feedbackGain = loop16.feedbackGain = vectorLoop.feedbackGain = 0.99f;
+  OnePole vectorFilter;
+  vectorFilter.mCoeffs = OnePole::coeffs(0.2f);
+
+  std::function<DSPVector(void)> run1 = [&]() {
+    return loop1(input, [&](float* p) { averageFn(p, 1); }, vDelay);
+  };
+  std::function<DSPVector(void)> run4 = [&]() {
+    return loop4(input, [&](float* p) { averageFn(p, 4); }, vDelay);
+  };
+  std::function<DSPVector(void)> run16 = [&]() {
+    return loop16(input, [&](float* p) { averageFn(p, 16); }, vDelay);
+  };
+  std::function<DSPVector(void)> runVector = [&]() {
+    return vectorLoop(input, [&](const DSPVector x) { return vectorFilter(x); }, vDelay);
+  };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto time1 = timeIterationsInThread<DSPVector>(run1);
+  auto time4 = timeIterationsInThread<DSPVector>(run4);
+  auto time16 = timeIterationsInThread<DSPVector>(run16);
+  auto timeVector = timeIterationsInThread<DSPVector>(runVector);
+#else
+  auto time1 = timeIterations<DSPVector>(run1);
+  auto time4 = timeIterations<DSPVector>(run4);
+  auto time16 = timeIterations<DSPVector>(run16);
+  auto timeVector = timeIterations<DSPVector>(runVector);
+#endif
+
+  /*
+  std::cout << "feedback loop, blocks of 1: " << time1.ns << ", 4: " << time4.ns
+            << ", 16: " << time16.ns << ", FeedbackDelayFunction: " << timeVector.ns << " \n";
+   */
+}
+
+TEST_CASE("madronalib/core/dsp_filters/coeffs_vec", "[dsp_filters]")
+{
+  // parameter sweeps over one DSPVector.
+  DSPVector omega{columnIndex() * (0.4f / kFloatsPerDSPVector) + 0.001f};
+  DSPVector k{0.1f + columnIndex() * (1.f / kFloatsPerDSPVector)};
+  DSPVector A{0.5f + columnIndex() * (2.f / kFloatsPerDSPVector)};
+  constexpr float kMaxDiff{1e-5f};
+
+  auto svfVec = makeSVFCoeffsVec(omega, k);
+  auto loShelfVec = LoShelf::makeCoeffsVec(omega, k, A);
+  auto hiShelfVec = HiShelf::makeCoeffsVec(omega, k, A);
+  auto bellVec = Bell::makeCoeffsVec(omega, k, A);
+
+  float maxDiff{0.f};
+  auto compare = [&](float a, float b) { maxDiff = std::max(maxDiff, fabsf(a - b)); };
+  for (int n = 0; n < kFloatsPerDSPVector; ++n)
+  {
+    auto svf = Lopass::makeCoeffs(omega[n], k[n]);
+    for (int i = 0; i < 3; ++i)
+    {
+      compare(svf[i], svfVec.constRow(i)[n]);
+    }
+    auto loShelf = LoShelf::coeffs({omega[n], k[n], A[n]});
+    for (int i = 0; i < loShelf.size(); ++i)
+    {
+      compare(loShelf[i], loShelfVec.constRow(i)[n]);
+    }
+    auto hiShelf = HiShelf::coeffs({omega[n], k[n], A[n]});
+    for (int i = 0; i < hiShelf.size(); ++i)
+    {
+      compare(hiShelf[i], hiShelfVec.constRow(i)[n]);
+    }
+    auto bell = Bell::coeffs(omega[n], k[n], A[n]);
+    compare(bell.a1, bellVec.constRow(0)[n]);
+    compare(bell.a2, bellVec.constRow(1)[n]);
+    compare(bell.a3, bellVec.constRow(2)[n]);
+    compare(bell.m1, bellVec.constRow(3)[n]);
+  }
+  REQUIRE(maxDiff < kMaxDiff);
+
+  // time filtering with a modulated cutoff, getting the coefficients for
+  // each sample with makeCoeffsVec or with the scalar makeCoeffs.
+  // The cutoff changes every vector.
+  Lopass lopass;
+  DSPVector input{columnIndex() * 0.01f};
+  int vectorCount{0};
+  std::function<DSPVector(void)> vectorCoeffs = [&]() {
+    DSPVector omegaV = omega + DSPVector(0.001f * (vectorCount++ & 15));
+    return lopass(input, omegaV, k);
+  };
+  std::function<DSPVector(void)> scalarCoeffs = [&]() {
+    DSPVectorArray<3> vc(kUninitialized);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      auto c = Lopass::makeCoeffs(omega[n], k[n]);
+      for (int i = 0; i < 3; ++i)
+      {
+        vc.row(i)[n] = c[i];
+      }
+    }
+    return input + vc.constRow(0);
+  };
+
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto vectorTime = timeIterationsInThread<DSPVector>(vectorCoeffs);
+  auto scalarTime = timeIterationsInThread<DSPVector>(scalarCoeffs);
+#else
+  auto vectorTime = timeIterations<DSPVector>(vectorCoeffs);
+  auto scalarTime = timeIterations<DSPVector>(scalarCoeffs);
+#endif
+
+  /*
+  std::cout << "modulated lopass with vector coeffs: " << vectorTime.ns
+            << ", scalar coeffs only: " << scalarTime.ns << " \n";
+   */
+}
+
+// run a Hipass or Bandpass with constant parameters that change now and then,
+// alongside one with coefficients set from the same parameters every vector,
+// and return true if their outputs are the same.
+template <typename T>
+bool cachedSVFMatches()
+{
+  DSPVector input{columnIndex() * (1.f / kFloatsPerDSPVector) - 0.5f};
+  const float omegas[] = {0.1f, 0.1f, 0.2f, 0.2f, 0.2f, 0.05f, 0.1f, 0.1f};
+  T cached, stored;
+  bool match{true};
+  for (float omega : omegas)
+  {
+    stored.mCoeffs = T::coeffs(omega, 0.5f);
+    match = match && (cached(input, DSPVector(omega), DSPVector(0.5f)) == stored(input));
+  }
+  return match;
+}
+
+TEST_CASE("madronalib/core/dsp_filters/param_cache", "[dsp_filters]")
+{
+  DSPVector input{columnIndex() * (1.f / kFloatsPerDSPVector) - 0.5f};
+  DSPVector omega{columnIndex() * (0.4f / kFloatsPerDSPVector) + 0.001f};
+  DSPVector k{0.1f + columnIndex() * (1.f / kFloatsPerDSPVector)};
+  DSPVector A{0.5f + columnIndex() * (2.f / kFloatsPerDSPVector)};
+  constexpr int kVectors{8};
+
+  // constant parameters should give the same output as stored scalar coefficients.
+  Lopass cachedLopass, scalarLopass;
+  scalarLopass._coeffs = Lopass::makeCoeffs(0.1f, 0.5f);
+  Bell cachedBell, scalarBell;
+  scalarBell.mCoeffs = Bell::coeffs(0.1f, 0.5f, 2.f);
+  for (int i = 0; i < kVectors; ++i)
+  {
+    DSPVector lopassA = cachedLopass(input, DSPVector(0.1f), DSPVector(0.5f));
+    DSPVector lopassB = scalarLopass(input);
+    REQUIRE(lopassA == lopassB);
+    DSPVector bellA = cachedBell(input, DSPVector(0.1f), DSPVector(0.5f), DSPVector(2.f));
+    DSPVector bellB = scalarBell(input);
+    REQUIRE(bellA == bellB);
+  }
+
+  // changing parameters should give the same output as coefficients made every time.
+  HiShelf cachedShelf, uncachedShelf;
+  for (int i = 0; i < kVectors; ++i)
+  {
+    DSPVector omegaI = (i & 2) ? omega : DSPVector(0.2f);
+    DSPVector shelfA = cachedShelf(input, omegaI, k, A);
+    DSPVector shelfB = uncachedShelf(input, HiShelf::makeCoeffsVec(omegaI, k, A));
+    REQUIRE(shelfA == shelfB);
+  }
+
+  // constant parameters that change are picked up by each filter.
+  REQUIRE(cachedSVFMatches<Hipass>());
+  REQUIRE(cachedSVFMatches<Bandpass>());
+
+  // the cache is only a few floats per filter.
+  REQUIRE(sizeof(Lopass) < 64);
+  REQUIRE(sizeof(Bell) < 64);
+
+  // time a Bell filter with unchanging parameters, with and without the cache.
+  DSPVector vOmega(0.1f), vK(0.5f), vA(2.f);
+  std::function<DSPVector(void)> cached = [&]() { return cachedBell(input, vOmega, vK, vA); };
+  std::function<DSPVector(void)> uncached = [&]() {
+    return scalarBell(input, Bell::makeCoeffsVec(vOmega, vK, vA));
+  };
+
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto cachedTime = timeIterationsInThread<DSPVector>(cached);
+  auto uncachedTime = timeIterationsInThread<DSPVector>(uncached);
+#else
+  auto cachedTime = timeIterations<DSPVector>(cached);
+  auto uncachedTime = timeIterations<DSPVector>(uncached);
+#endif
+
+  /*
+  std::cout << "bell cached coeffs: " << cachedTime.ns << ", uncached: " << uncachedTime.ns
+            << " \n";
+   */
+}
@@ -55,3 +55,261 @@ TEST_CASE("madronalib/core/dsp_gens", "[dsp_gens]")
 
   
 }
+
+TEST_CASE("madronalib/core/dsp_gens/phase", "[dsp_gens]")
+{
+  // the vector phasor should match a serial sum of the same integer steps.
+  PhasorGen p1;
+  DSPVector freq{0.001f + columnIndex() * 0.0003f};
+  DSPVectorInt steps = roundFloatToInt(freq * DSPVector(PhasorGen::stepsPerCycle));
+  uint32_t omega32{0};
+  bool phasorOK{true};
+  for (int i = 0; i < 4; ++i)
+  {
+    DSPVector v1 = p1(freq);
+    DSPVectorInt omega32V;
+    for (int n = 0; n < kIntsPerDSPVector; ++n)
+    {
+      omega32 += steps[n];
+      omega32V[n] = omega32;
+    }
+    phasorOK = phasorOK && (v1 == unsignedIntToFloat(omega32V) * PhasorGen::cyclesPerStep);
+  }
+  REQUIRE(phasorOK);
+
+  // ticks and impulses at a steady rate.
+  TickGen t1;
+  DSPVector tickFreq{2.f / kFloatsPerDSPVector};
+  t1(tickFreq);
+  REQUIRE(sum(t1(tickFreq)) == 2.f);
+  ImpulseGen i1;
+  DSPVector impulseFreq{1.f / kFloatsPerDSPVector};
+  i1(impulseFreq);
+  REQUIRE(fabs(sum(i1(impulseFreq)) - 1.f) < 1e-4f);
+
+  // count the ticks and the nonzero impulse samples over 1024 samples.
+  auto countTicks = [](float cyclesPerSample) {
+    TickGen t;
+    float ticks{0};
+    for (int i = 0; i < 1024 / kFloatsPerDSPVector; ++i)
+    {
+      ticks += sum(t(DSPVector(cyclesPerSample)));
+    }
+    return int(ticks);
+  };
+  auto countImpulseSamples = [](float cyclesPerSample) {
+    ImpulseGen g;
+    int samples{0};
+    for (int i = 0; i < 1024 / kFloatsPerDSPVector; ++i)
+    {
+      DSPVector y = g(DSPVector(cyclesPerSample));
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        samples += (y[n] != 0.f);
+      }
+    }
+    return samples;
+  };
+
+  // negative frequencies never wrap, so there is only the first impulse.
+  REQUIRE(countTicks(-0.01f) == 0);
+  REQUIRE(countTicks(-0.6f) == 0);
+  REQUIRE(countImpulseSamples(-0.01f) == 17);
+
+  // frequencies of 0.5 cycles per sample or more.
+  REQUIRE(std::abs(countTicks(0.6f) - 614) <= 1);
+  REQUIRE(countTicks(0.5f) == 512);
+  REQUIRE(countTicks(1.0f) == 1024);
+  REQUIRE(countTicks(2.5f) == 1024);
+  REQUIRE(countImpulseSamples(0.6f) == 1024);
+
+  // a one shot makes one ramp, then stays at 0 until triggered.
+  OneShotGen g1;
+  DSPVector rampFreq{1.f / (kFloatsPerDSPVector * 2)};
+  REQUIRE(sum(g1(rampFreq)) == 0.f);
+  g1.trigger();
+  auto vg1 = g1(rampFreq);
+  auto vg2 = g1(rampFreq);
+  auto vg3 = g1(rampFreq);
+  REQUIRE(vg1[kFloatsPerDSPVector - 1] == 0.5f);
+  REQUIRE(vg2[kFloatsPerDSPVector - 2] == 1.f - 1.f / (kFloatsPerDSPVector * 2));
+  REQUIRE(vg2[kFloatsPerDSPVector - 1] == 0.f);
+  REQUIRE(sum(vg3) == 0.f);
+
+  // time the phasor.
+  std::function<DSPVector(void)> phasor = [&]() { return p1(freq); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto phasorTime = timeIterationsInThread<DSPVector>(phasor);
+#else
+  auto phasorTime = timeIterations<DSPVector>(phasor);
+#endif
+
+  /*
+  std::cout << "phasor: " << phasorTime.ns << " \n";
+   */
+}
+
+TEST_CASE("madronalib/core/dsp_gens/noise", "[dsp_gens]")
+{
+  // the vector noise should match the one-sample version.
+  NoiseGen n1, n2;
+  n1.setSeed(0x12345678);
+  n2.setSeed(0x12345678);
+  bool noiseOK{true};
+  for (int i = 0; i < 4; ++i)
+  {
+    DSPVector v1 = n1();
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      noiseOK = noiseOK && (v1[n] == n2.getSample());
+    }
+  }
+  REQUIRE(noiseOK);
+
+  // time vector and one-sample noise.
+  std::function<DSPVector(void)> vectorNoise = [&]() { return n1(); };
+  std::function<DSPVector(void)> scalarNoise = [&]() {
+    DSPVector y(kUninitialized);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      y[n] = n2.getSample();
+    }
+    return y;
+  };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto vectorTime = timeIterationsInThread<DSPVector>(vectorNoise);
+  auto scalarTime = timeIterationsInThread<DSPVector>(scalarNoise);
+#else
+  auto vectorTime = timeIterations<DSPVector>(vectorNoise);
+  auto scalarTime = timeIterations<DSPVector>(scalarNoise);
+#endif
+
+  /*
+  std::cout << "noise vector: " << vectorTime.ns << ", scalar: " << scalarTime.ns << " \n";
+   */
+}
+
+TEST_CASE("madronalib/core/dsp_gens/multi_noise", "[dsp_gens]")
+{
+  constexpr int kVoices = 16;
+  constexpr int kVectors = 256;
+
+  // voices are repeatable from their seeds and different from each other.
+  WhiteNoiseGen<kVoices> w1(99), w2(0);
+  w2.setSeed(99);
+  WhiteNoiseGen<1> w3;
+  w3.setSeed(0, 99 + 5);
+  DSPVectorArray<kVoices> a = w1();
+  DSPVectorArray<kVoices> b = w2();
+  DSPVector c = w3();
+  REQUIRE(a == b);
+  REQUIRE(a.constRow(5) == c);
+  REQUIRE(!(a.constRow(5) == a.constRow(6)));
+
+  // white: range and mean.
+  double whiteSum{0};
+  float whiteMin{1}, whiteMax{-1};
+  for (int i = 0; i < kVectors; ++i)
+  {
+    DSPVectorArray<kVoices> x = w1();
+    for (int j = 0; j < kVoices; ++j)
+    {
+      whiteSum += sum(x.constRow(j));
+      whiteMin = std::min(whiteMin, min(x.constRow(j)));
+      whiteMax = std::max(whiteMax, max(x.constRow(j)));
+    }
+  }
+  const double kWhiteSamples = kVectors * kVoices * kFloatsPerDSPVector;
+  REQUIRE(whiteMin >= -1.f);
+  REQUIRE(whiteMax < 1.f);
+  REQUIRE(fabs(whiteSum / kWhiteSamples) < 0.01);
+
+  // Gaussian: mean 0 and variance 1.
+  GaussianNoiseGen<kVoices> g(1);
+  double gSum{0}, gSumSquares{0};
+  for (int i = 0; i < kVectors; ++i)
+  {
+    DSPVectorArray<kVoices> x = g();
+    for (int j = 0; j < kVoices; ++j)
+    {
+      gSum += sum(x.constRow(j));
+      gSumSquares += sum(x.constRow(j) * x.constRow(j));
+    }
+  }
+  REQUIRE(fabs(gSum / kWhiteSamples) < 0.02);
+  REQUIRE(fabs(gSumSquares / kWhiteSamples - 1.0) < 0.02);
+
+  // a Gaussian voice is the same whether seeded with the others or alone.
+  GaussianNoiseGen<kVoices> g2(5);
+  GaussianNoiseGen<1> g3(5 + 3), g4;
+  g4.setSeed(0, 5 + 3);
+  DSPVector g3Voice = g3();
+  REQUIRE(g2().constRow(3) == g3Voice);
+  REQUIRE(g4() == g3Voice);
+
+  // pink: about the same level as white, with much more correlation between
+  // neighboring samples.
+  auto levelAndCorrelation = [&](std::function<DSPVector(void)> gen) {
+    double sumSquares{0}, sumProducts{0};
+    float prev{0};
+    for (int i = 0; i < kVectors; ++i)
+    {
+      DSPVector x = gen();
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        sumSquares += x[n] * x[n];
+        sumProducts += x[n] * prev;
+        prev = x[n];
+      }
+    }
+    const double kSamples = kVectors * kFloatsPerDSPVector;
+    return std::make_pair(sqrt(sumSquares / kSamples), sumProducts / sumSquares);
+  };
+  WhiteNoiseGen<1> w4(7);
+  PinkNoiseGen<1> p1(7);
+  PinkNoiseGen<kVoices> pv(7);
+  auto white = levelAndCorrelation([&]() { return w4(); });
+  auto pink = levelAndCorrelation([&]() { return p1(); });
+  auto pinkVoice = levelAndCorrelation([&]() { return pv().constRow(3); });
+  REQUIRE(fabs(white.second) < 0.05);
+  REQUIRE(pink.second > 0.5);
+  REQUIRE(pinkVoice.second > 0.5);
+  REQUIRE(fabs(pink.first / white.first - 1.0) < 0.2);
+
+  // a pink voice reseeded after running matches a fresh one with the same seed.
+  PinkNoiseGen<kVoices> pv2;
+  PinkNoiseGen<1> p2;
+  pv.setSeed(3, 11);
+  pv2.setSeed(3, 11);
+  p1.setSeed(0, 11);
+  p2.setSeed(0, 11);
+  REQUIRE(pv().constRow(3) == pv2().constRow(3));
+  REQUIRE(p1() == p2());
+
+  // time many voices of white noise against one NoiseGen per voice.
+  std::array<NoiseGen, kVoices> gens;
+  std::function<DSPVectorArray<kVoices>(void)> multiNoise = [&]() { return w1(); };
+  std::function<DSPVectorArray<kVoices>(void)> separateNoise = [&]() {
+    DSPVectorArray<kVoices> y;
+    for (int j = 0; j < kVoices; ++j)
+    {
+      y.row(j) = gens[j]();
+    }
+    return y;
+  };
+  std::function<DSPVectorArray<kVoices>(void)> pinkNoise = [&]() { return pv(); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto multiTime = timeIterationsInThread<DSPVectorArray<kVoices>>(multiNoise);
+  auto separateTime = timeIterationsInThread<DSPVectorArray<kVoices>>(separateNoise);
+  auto pinkTime = timeIterationsInThread<DSPVectorArray<kVoices>>(pinkNoise);
+#else
+  auto multiTime = timeIterations<DSPVectorArray<kVoices>>(multiNoise);
+  auto separateTime = timeIterations<DSPVectorArray<kVoices>>(separateNoise);
+  auto pinkTime = timeIterations<DSPVectorArray<kVoices>>(pinkNoise);
+#endif
+
+  /*
+  std::cout << "16 voices noise: " << multiTime.ns << ", separate: " << separateTime.ns
+            << ", pink: " << pinkTime.ns << " \n";
+   */
+}
@@ -18,6 +18,238 @@
 
 using namespace ml;
 
+// compare computing a*b + c*d with and without lazy expressions.
+template <size_t ROWS>
+void timeFusedArithmetic()
+{
+  DSPVectorArray<ROWS> a{repeatRows<ROWS>(columnIndex())};
+  DSPVectorArray<ROWS> b{rowIndex<ROWS>()};
+  DSPVectorArray<ROWS> c{a * 0.5f};
+  DSPVectorArray<ROWS> d{b + 1.f};
+
+  std::function<DSPVectorArray<ROWS>(void)> unfused = [&]() {
+    return DSPVectorArray<ROWS>(a * b + c * d);
+  };
+  std::function<DSPVectorArray<ROWS>(void)> fused = [&]() {
+    return DSPVectorArray<ROWS>(lazy(a) * b + lazy(c) * d);
+  };
+  REQUIRE(unfused() == fused());
+
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto unfusedTime = timeIterationsInThread<DSPVectorArray<ROWS> >(unfused);
+  auto fusedTime = timeIterationsInThread<DSPVectorArray<ROWS> >(fused);
+#else
+  auto unfusedTime = timeIterations<DSPVectorArray<ROWS> >(unfused);
+  auto fusedTime = timeIterations<DSPVectorArray<ROWS> >(fused);
+#endif
+
+  /*
+  std::cout << "a*b + c*d, " << ROWS << " rows: unfused: " << unfusedTime.ns
+            << ", fused: " << fusedTime.ns << " \n";
+   */
+}
+
+// compare writing a result into a zero-filled DSPVectorArray with writing it
+// into one constructed with kUninitialized.
+template <size_t ROWS>
+void timeUninitializedConstruction()
+{
+  DSPVectorArray<ROWS> a{repeatRows<ROWS>(columnIndex())};
+
+  std::function<DSPVectorArray<ROWS>(void)> zeroed = [&]() {
+    DSPVectorArray<ROWS> vy;
+    vy.evaluate(lazy(a) * a);
+    return vy;
+  };
+  std::function<DSPVectorArray<ROWS>(void)> uninitialized = [&]() {
+    DSPVectorArray<ROWS> vy(kUninitialized);
+    vy.evaluate(lazy(a) * a);
+    return vy;
+  };
+  REQUIRE(zeroed() == uninitialized());
+
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto zeroedTime = timeIterationsInThread<DSPVectorArray<ROWS> >(zeroed);
+  auto uninitializedTime = timeIterationsInThread<DSPVectorArray<ROWS> >(uninitialized);
+#else
+  auto zeroedTime = timeIterations<DSPVectorArray<ROWS> >(zeroed);
+  auto uninitializedTime = timeIterations<DSPVectorArray<ROWS> >(uninitialized);
+#endif
+
+  /*
+  std::cout << "a*a, " << ROWS << " rows: zeroed: " << zeroedTime.ns
+            << ", uninitialized: " << uninitializedTime.ns << " \n";
+   */
+}
+
+// reference routers selecting one sample at a time, as the routers used to.
+template <size_t ROWS, size_t N>
+DSPVectorArray<ROWS> multiplexReference(const DSPVector& selector,
+                                        const std::array<DSPVectorArray<ROWS>, N>& inputs,
+                                        bool linear)
+{
+  DSPVectorArray<ROWS> y;
+  for (int i = 0; i < kFloatsPerDSPVector * static_cast<int>(ROWS); ++i)
+  {
+    float s = selector[i % kFloatsPerDSPVector];
+    float inputReal = (s - truncf(s)) * N;
+    size_t input1 = static_cast<size_t>(inputReal);
+    size_t input2 = (input1 + 1) % N;
+    float frac = inputReal - truncf(inputReal);
+    y[i] = linear ? lerp(inputs[input1][i], inputs[input2][i], frac) : inputs[input1][i];
+  }
+  return y;
+}
+
+template <size_t ROWS, size_t N>
+std::array<DSPVectorArray<ROWS>, N> demultiplexReference(const DSPVector& selector,
+                                                         const DSPVectorArray<ROWS>& input,
+                                                         bool linear)
+{
+  std::array<DSPVectorArray<ROWS>, N> outputs;
+  for (int i = 0; i < kFloatsPerDSPVector * static_cast<int>(ROWS); ++i)
+  {
+    float s = selector[i % kFloatsPerDSPVector];
+    float outputReal = (s - truncf(s)) * N;
+    size_t output1 = static_cast<size_t>(outputReal);
+    size_t output2 = (output1 + 1) % N;
+    float m = outputReal - truncf(outputReal);
+    if (linear)
+    {
+      outputs[output2][i] = input[i] * m;
+      outputs[output1][i] = input[i] * (1.f - m);
+    }
+    else
+    {
+      outputs[output1][i] = input[i];
+    }
+  }
+  return outputs;
+}
+
+// check the routers with N inputs or outputs against the references, and time
+// them. The inputs and outputs are passed to the variadic routers from arrays.
+template <size_t N, size_t... I>
+void testRouting(std::index_sequence<I...>)
+{
+  constexpr size_t kRows = 2;
+  std::array<DSPVectorArray<kRows>, N> inputs;
+  for (size_t k = 0; k < N; ++k)
+  {
+    inputs[k] = repeatRows<kRows>(columnIndex()) + rowIndex<kRows>() * 100.f + k * 1000.f;
+  }
+  DSPVector selector = sin(columnIndex() * 0.1f) * 1.5f + 1.6f;
+  DSPVectorArray<kRows> input = inputs[0];
+  std::array<DSPVectorArray<kRows>, N> outputs;
+
+  REQUIRE(multiplex(selector, inputs[I]...) == multiplexReference(selector, inputs, false));
+  // the interpolation is fused in backends with FMA, so it can differ from the
+  // reference in the last bit.
+  DSPVectorArray<kRows> linearRef = multiplexReference(selector, inputs, true);
+  DSPVectorArray<kRows> linear = multiplexLinear(selector, inputs[I]...);
+  for (size_t j = 0; j < kRows; ++j)
+  {
+    const DSPVector& ref = linearRef.constRow(j);
+    REQUIRE(max(abs(linear.constRow(j) - ref)) <= max(abs(ref)) * 1e-6f);
+  }
+  demultiplex(selector, input, &outputs[I]...);
+  REQUIRE(outputs == (demultiplexReference<kRows, N>(selector, input, false)));
+  demultiplexLinear(selector, input, &outputs[I]...);
+  REQUIRE(outputs == (demultiplexReference<kRows, N>(selector, input, true)));
+
+  // a slow selector that switches inputs about once per vector, where multiplex
+  // can copy most SIMD vectors, and the fast one above.
+  DSPVector slowSelector = columnIndex() / (kFloatsPerDSPVector * N) + 0.0001f;
+  REQUIRE(multiplex(slowSelector, inputs[I]...) == multiplexReference(slowSelector, inputs, false));
+
+  std::function<DSPVectorArray<kRows>(void)> slowMux = [&]() {
+    return multiplex(slowSelector, inputs[I]...);
+  };
+  std::function<DSPVectorArray<kRows>(void)> mux = [&]() {
+    return multiplex(selector, inputs[I]...);
+  };
+  std::function<DSPVectorArray<kRows>(void)> muxReference = [&]() {
+    return multiplexReference(selector, inputs, false);
+  };
+  std::function<DSPVectorArray<kRows>(void)> demux = [&]() {
+    demultiplex(selector, input, &outputs[I]...);
+    return outputs[N - 1];
+  };
+  std::function<DSPVectorArray<kRows>(void)> demuxReference = [&]() {
+    return demultiplexReference<kRows, N>(selector, input, false)[N - 1];
+  };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto slowMuxTime = timeIterationsInThread<DSPVectorArray<kRows> >(slowMux);
+  auto muxTime = timeIterationsInThread<DSPVectorArray<kRows> >(mux);
+  auto muxReferenceTime = timeIterationsInThread<DSPVectorArray<kRows> >(muxReference);
+  auto demuxTime = timeIterationsInThread<DSPVectorArray<kRows> >(demux);
+  auto demuxReferenceTime = timeIterationsInThread<DSPVectorArray<kRows> >(demuxReference);
+#else
+  auto slowMuxTime = timeIterations<DSPVectorArray<kRows> >(slowMux);
+  auto muxTime = timeIterations<DSPVectorArray<kRows> >(mux);
+  auto muxReferenceTime = timeIterations<DSPVectorArray<kRows> >(muxReference);
+  auto demuxTime = timeIterations<DSPVectorArray<kRows> >(demux);
+  auto demuxReferenceTime = timeIterations<DSPVectorArray<kRows> >(demuxReference);
+#endif
+
+  /*
+  std::cout << N << " inputs: slow mux: " << slowMuxTime.ns << ", mux: " << muxTime.ns
+            << ", reference: " << muxReferenceTime.ns << ", demux: " << demuxTime.ns << ", reference: " << demuxReferenceTime.ns << " \n";
+   */
+}
+
+// check a MixMatrix without glides against a sum of DSPVector products for each
+// output, and time them.
+template <size_t INPUTS, size_t OUTPUTS>
+void testMixMatrix()
+{
+  MixMatrix<INPUTS, OUTPUTS> mixer;
+  std::array<std::array<float, INPUTS>, OUTPUTS> gains;
+  for (size_t j = 0; j < OUTPUTS; ++j)
+  {
+    for (size_t k = 0; k < INPUTS; ++k)
+    {
+      gains[j][k] = ((j + k) % 3) ? 0.01f * (j + 1) + 0.001f * k : 0.f;
+      mixer.setGainImmediate(k, j, gains[j][k]);
+    }
+  }
+  DSPVectorArray<INPUTS> x{repeatRows<INPUTS>(columnIndex()) + rowIndex<INPUTS>()};
+
+  std::function<DSPVectorArray<OUTPUTS>(void)> matrix = [&]() { return mixer(x); };
+  std::function<DSPVectorArray<OUTPUTS>(void)> separate = [&]() {
+    DSPVectorArray<OUTPUTS> y;
+    for (size_t j = 0; j < OUTPUTS; ++j)
+    {
+      for (size_t k = 0; k < INPUTS; ++k)
+      {
+        y.row(j) = y.row(j) + x.constRow(k) * DSPVector(gains[j][k]);
+      }
+    }
+    return y;
+  };
+  // the sums are in different orders, so allow some rounding error.
+  DSPVectorArray<OUTPUTS> error = abs(matrix() - separate());
+  float maxError{0};
+  for (size_t j = 0; j < OUTPUTS; ++j)
+  {
+    maxError = std::max(maxError, max(error.constRow(j)));
+  }
+  REQUIRE(maxError < 0.01f);
+
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto matrixTime = timeIterationsInThread<DSPVectorArray<OUTPUTS> >(matrix);
+  auto separateTime = timeIterationsInThread<DSPVectorArray<OUTPUTS> >(separate);
+#else
+  auto matrixTime = timeIterations<DSPVectorArray<OUTPUTS> >(matrix);
+  auto separateTime = timeIterations<DSPVectorArray<OUTPUTS> >(separate);
+#endif
+
+  /*
+  std::cout << INPUTS << "x" << OUTPUTS << " mix: matrix: " << matrixTime.ns
+            << ", separate: " << separateTime.ns << " \n";
+   */
+}
+
 TEST_CASE("madronalib/core/dsp_ops", "[dsp_ops]")
 {
   DSPVector a(rangeClosed(-kPi, kPi));
@@ -148,6 +380,88 @@ TEST_CASE("madronalib/core/dsp_ops", "[dsp_ops]")
     }
   }
 
+  SECTION("fused time")
+  {
+    // test speed of arithmetic chains evaluated as lazy expressions, in a single
+    // pass, relative to the same chains with a temporary for each operator.
+    timeFusedArithmetic<1>();
+    timeFusedArithmetic<8>();
+    timeFusedArithmetic<32>();
+  }
+
+  SECTION("uninitialized time")
+  {
+    // test speed of results constructed without the zero fill, which matters
+    // most for large arrays.
+    timeUninitializedConstruction<1>();
+    timeUninitializedConstruction<32>();
+    timeUninitializedConstruction<128>();
+  }
+
+  SECTION("lazy")
+  {
+    DSPVector a{columnIndex()};
+    DSPVector b{2.f};
+    DSPVector y = lazy(a) * b + 1.f;
+    REQUIRE(y == a * b + 1.f);
+
+    // expressions can be passed to the other operations.
+    REQUIRE(sin(lazy(a) * 0.01f) == sin(a * 0.01f));
+    REQUIRE(max(lazy(a) - b) == max(a - b));
+
+    // compound assignment from an expression.
+    DSPVector z{a};
+    z += lazy(a) * b;
+    REQUIRE(z == a * 3.f);
+  }
+
+  SECTION("backend")
+  {
+    // the SIMD backend we were compiled for must run here, and whole-vector
+    // shuffles must move data across SIMD vector boundaries.
+    REQUIRE(cpuSupportsSIMDBackend());
+    DSPVector v{columnIndex()};
+    DSPVector l = rotateLeft(v);
+    DSPVector r = rotateRight(v);
+    REQUIRE(l[0] == 1.f);
+    REQUIRE(l[kFloatsPerSIMDVector - 1] == kFloatsPerSIMDVector);
+    REQUIRE(l[kFloatsPerDSPVector - 1] == 0.f);
+    REQUIRE(r[0] == kFloatsPerDSPVector - 1);
+    REQUIRE(r[kFloatsPerSIMDVector] == kFloatsPerSIMDVector - 1);
+
+#if ML_SIMD_DISPATCH
+    // the kernels dispatched at runtime must match the compile-time backend.
+    REQUIRE(dispatch::getDispatchedBackendName() != nullptr);
+    DSPVector x{(columnIndex() - kFloatsPerDSPVector / 2) * 0.37f};
+    DSPVector px{columnIndex() * 0.11f + 0.01f};
+    DSPVector vSin(sin(x)), vCos(cos(x)), vExp(exp(x * 0.1f)), vLog(log(px)), vPow(pow(px, x * 0.1f));
+    DSPVector e(x * 0.1f);
+    float maxDiff{0.f};
+    for (int n = 0; n < kFloatsPerDSPVector; n += kFloatsPerSIMDVector)
+    {
+      float ref[kFloatsPerSIMDVector];
+      auto check = [&](const DSPVector& y) {
+        for (int i = 0; i < kFloatsPerSIMDVector; ++i)
+        {
+          maxDiff = std::max(maxDiff, std::abs(y[n + i] - ref[i]) / std::max(1.f, std::abs(ref[i])));
+        }
+      };
+      vecStoreUnaligned(ref, vecSin(vecLoadUnaligned(x.getConstBuffer() + n)));
+      check(vSin);
+      vecStoreUnaligned(ref, vecCos(vecLoadUnaligned(x.getConstBuffer() + n)));
+      check(vCos);
+      vecStoreUnaligned(ref, vecExp(vecLoadUnaligned(e.getConstBuffer() + n)));
+      check(vExp);
+      vecStoreUnaligned(ref, vecLog(vecLoadUnaligned(px.getConstBuffer() + n)));
+      check(vLog);
+      vecStoreUnaligned(ref, vecExp(vecMul(vecLog(vecLoadUnaligned(px.getConstBuffer() + n)),
+                                           vecLoadUnaligned(e.getConstBuffer() + n))));
+      check(vPow);
+    }
+    REQUIRE(maxDiff < 1e-6f);
+#endif
+  }
+
   SECTION("lerp")
   {
     // lerp with constant mix value
@@ -156,6 +470,89 @@ TEST_CASE("madronalib/core/dsp_ops", "[dsp_ops]")
     auto c = lerp(a, b, 0.5f);
     REQUIRE(c[kFloatsPerDSPVector - 1] == (kFloatsPerDSPVector - 1) * 0.5f);
   }
+
+  SECTION("fma")
+  {
+    // small integers are exact with or without fused operations.
+    DSPVectorArray<2> a{repeatRows<2>(columnIndex())};
+    DSPVectorArray<2> b{rowIndex<2>() + 2.f};
+    DSPVectorArray<2> c{3.f};
+    REQUIRE(fma(a, b, c) == a * b + c);
+    REQUIRE(fms(a, b, c) == a * b - c);
+    REQUIRE(fma(lazy(a) + 1.f, b, c) == (a + 1.f) * b + c);
+    REQUIRE(ml::fma(2.f, 3.f, 4.f) == 10.f);
+    REQUIRE(ml::fms(2.f, 3.f, 4.f) == 2.f);
+  }
+
+  SECTION("scan")
+  {
+    // sums of small integers are exact in any order.
+    DSPVector a{columnIndex()};
+    DSPVector sa = inclusiveScan(a, 1.f);
+    DSPVectorInt b{columnIndexInt()};
+    DSPVectorInt sb = inclusiveScan(b, -3);
+    bool scanOK{true};
+    float fSum{1.f};
+    int32_t iSum{-3};
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      fSum += a[n];
+      iSum += b[n];
+      scanOK = scanOK && (sa[n] == fSum) && (sb[n] == iSum);
+    }
+    REQUIRE(scanOK);
+
+    // int sums wrap.
+    DSPVectorInt c{0x40000000};
+    REQUIRE(inclusiveScan(c)[3] == 0);
+  }
+
+  SECTION("int ops")
+  {
+    // compare each op with scalar math on values of both signs.
+    DSPVectorInt a{columnIndexInt() * DSPVectorInt(0x12345) - DSPVectorInt(0x1234567)};
+    DSPVectorInt b{DSPVectorInt(0x0019660D) - columnIndexInt() * DSPVectorInt(0x9E3779)};
+    DSPVectorInt mul = a * b;
+    DSPVectorInt bitAnd = a & b;
+    DSPVectorInt bitOr = a | b;
+    DSPVectorInt bitXor = a ^ b;
+    DSPVectorInt bitAndNot = andNotInt32(a, b);
+    DSPVectorInt left = a << 3;
+    DSPVectorInt right = a >> 5;
+    DSPVectorInt rightArith = shiftRightArithmeticInt32(a, 5);
+    DSPVectorInt mn = minInt32(a, b);
+    DSPVectorInt mx = maxInt32(a, b);
+    DSPVectorInt mnu = minUInt32(a, b);
+    DSPVectorInt mxu = maxUInt32(a, b);
+    DSPVectorInt gt = greaterThanInt32(a, b);
+    DSPVectorInt lt = lessThanInt32(a, b);
+    DSPVectorInt gtu = greaterThanUInt32(a, b);
+    DSPVectorInt ltu = lessThanUInt32(a, b);
+    DSPVectorInt eq = equalInt32(a, a);
+
+    bool intOK{true};
+    for (int n = 0; n < kIntsPerDSPVector; ++n)
+    {
+      int32_t x = a[n], y = b[n];
+      uint32_t ux = x, uy = y;
+      intOK = intOK && (uint32_t(mul[n]) == ux * uy);
+      intOK = intOK && (bitAnd[n] == (x & y)) && (bitOr[n] == (x | y));
+      intOK = intOK && (bitXor[n] == (x ^ y)) && (bitAndNot[n] == (~x & y));
+      intOK = intOK && (uint32_t(left[n]) == ux << 3) && (uint32_t(right[n]) == ux >> 5);
+      intOK = intOK && (rightArith[n] == (x >> 5));
+      intOK = intOK && (mn[n] == std::min(x, y)) && (mx[n] == std::max(x, y));
+      intOK = intOK && (uint32_t(mnu[n]) == std::min(ux, uy));
+      intOK = intOK && (uint32_t(mxu[n]) == std::max(ux, uy));
+      intOK = intOK && (gt[n] == -int32_t(x > y)) && (lt[n] == -int32_t(x < y));
+      intOK = intOK && (gtu[n] == -int32_t(ux > uy)) && (ltu[n] == -int32_t(ux < uy));
+      intOK = intOK && (eq[n] == -1);
+    }
+    REQUIRE(intOK);
+
+    // bits to float and back
+    DSPVector f{columnIndex() - 10.f};
+    REQUIRE(intBitsToFloat(floatBitsToInt(f)) == f);
+  }
   
   SECTION("convert")
   {
@@ -232,6 +629,7 @@ TEST_CASE("madronalib/core/dsp_ops", "[dsp_ops]")
     DSPVectorArray<3> gains = concatRows(DSPVector{0.300f}, DSPVector{0.030f}, DSPVector{0.003f});
 
     auto mixResult = mix(gains, c, c, c);
+    REQUIRE(mixResult == c * 0.300f + c * 0.030f + c * 0.003f);
     
     DSPVectorArray<6> gg = repeatRows<2>(gains);
 
@@ -272,6 +670,42 @@ TEST_CASE("madronalib/core/dsp_ops", "[dsp_ops]")
     auto demuxThenMux = multiplex(selectorSignal, a, b, c, d);
     REQUIRE(demuxInput3 == demuxThenMux);
   }
+
+  SECTION("mix matrix")
+  {
+    // glide a gain over two vectors from 0 to 1 and back.
+    MixMatrix<2, 1> mixer;
+    mixer.setGlideTimeInSamples(kFloatsPerDSPVector * 2);
+    mixer.setGainImmediate(1, 0, 0.5f);
+    DSPVectorArray<2> x = concatRows(DSPVector(1.f), DSPVector(2.f));
+    REQUIRE(mixer(x) == DSPVector(1.f));
+    mixer.setGain(0, 0, 1.f);
+    DSPVector v1 = mixer(x);
+    DSPVector v2 = mixer(x);
+    DSPVector v3 = mixer(x);
+    REQUIRE(v1[0] > 1.f);
+    REQUIRE(v1[kFloatsPerDSPVector - 1] == 1.5f);
+    REQUIRE(v2[kFloatsPerDSPVector - 1] == 2.f);
+    REQUIRE(v3 == DSPVector(2.f));
+    REQUIRE(v2[0] - v1[kFloatsPerDSPVector - 1] < 1.f / kFloatsPerDSPVector);
+    mixer.setGain(0, 0, 0.f);
+    mixer(x);
+    REQUIRE(mixer(x)[kFloatsPerDSPVector - 1] == 1.f);
+    REQUIRE(mixer(x) == DSPVector(1.f));
+    REQUIRE(mixer.getGain(0, 0) == 0.f);
+
+    testMixMatrix<4, 2>();
+    testMixMatrix<32, 32>();
+  }
+
+  SECTION("routing time")
+  {
+    // check and time the SIMD routers against selecting one sample at a time.
+    testRouting<2>(std::make_index_sequence<2>());
+    testRouting<4>(std::make_index_sequence<4>());
+    testRouting<8>(std::make_index_sequence<8>());
+    testRouting<16>(std::make_index_sequence<16>());
+  }
   
   SECTION("bank")
   {
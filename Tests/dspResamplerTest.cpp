@@ -0,0 +1,165 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+#include "madronalib.h"
+#include "mldsp.h"
+#include "tests.h"
+
+using namespace ml;
+
+namespace
+{
+// resample a sine of the given frequency in cycles per input sample, and return
+// all of the output read.
+std::vector<float> resampleSine(Resampler& resampler, double freq, size_t nVectors)
+{
+  std::vector<float> y;
+  double phase{0};
+  for (size_t v = 0; v < nVectors; ++v)
+  {
+    DSPVector x(kUninitialized);
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      x[i] = float(sin(kTwoPi * phase));
+      phase += freq;
+    }
+    resampler.write(x);
+    while (resampler.getReadAvailable() >= kFloatsPerDSPVector)
+    {
+      DSPVector out = resampler.read();
+      y.insert(y.end(), out.getConstBuffer(), out.getConstBuffer() + kFloatsPerDSPVector);
+    }
+  }
+  return y;
+}
+
+// the largest difference of the output from the sine at the output times, once
+// the filter is full.
+float sineError(double ratio, Resampler::Quality quality, double freq)
+{
+  Resampler resampler(ratio, quality);
+  auto y = resampleSine(resampler, freq, 64);
+  const double latency = resampler.getLatency();
+  float maxError{0};
+  for (size_t m = 0; m < y.size(); ++m)
+  {
+    const double t = m / ratio - latency;
+    if (t < latency) continue;
+    const float expected = float(sin(kTwoPi * freq * t));
+    maxError = std::max(maxError, fabsf(y[m] - expected));
+  }
+  return maxError;
+}
+
+float rms(const std::vector<float>& y, size_t start)
+{
+  double sumOfSquares{0};
+  for (size_t m = start; m < y.size(); ++m)
+  {
+    sumOfSquares += y[m] * y[m];
+  }
+  return sqrtf(float(sumOfSquares / (y.size() - start)));
+}
+}  // namespace
+
+TEST_CASE("madronalib/core/resampler/accuracy", "[resampler]")
+{
+  // a sine in the passband comes out at the output times, up, down and at common
+  // audio rate conversions.
+  REQUIRE(sineError(48000. / 44100., Resampler::kMediumQuality, 0.05) < 1e-3f);
+  REQUIRE(sineError(44100. / 48000., Resampler::kMediumQuality, 0.05) < 1e-3f);
+  REQUIRE(sineError(2.0, Resampler::kHighQuality, 0.13) < 1e-4f);
+  REQUIRE(sineError(0.37, Resampler::kHighQuality, 0.02) < 1e-4f);
+  REQUIRE(sineError(3.1, Resampler::kLowQuality, 0.1) < 1e-2f);
+}
+
+TEST_CASE("madronalib/core/resampler/aliasing", "[resampler]")
+{
+  // downsampling by half, a sine above the new Nyquist frequency is removed.
+  Resampler resampler(0.5, Resampler::kMediumQuality);
+  auto y = resampleSine(resampler, 0.35, 64);
+  REQUIRE(rms(y, y.size() / 2) < 1e-3f);
+
+  // the filter is longer for lower ratios.
+  Resampler down(0.25, Resampler::kMediumQuality);
+  REQUIRE(down.getFilterLength() >= 4 * Resampler(1.0).getFilterLength());
+}
+
+TEST_CASE("madronalib/core/resampler/varying", "[resampler]")
+{
+  // with a changing ratio, the amount of output follows the ratio.
+  Resampler resampler(0.5, 2.0);
+  double expectedOutput{0};
+  size_t output{0};
+  for (int v = 0; v < 256; ++v)
+  {
+    const double ratio = 1.25 + 0.75 * sin(v * 0.05);
+    resampler.setRatio(ratio);
+    expectedOutput += ratio * kFloatsPerDSPVector;
+    resampler.write(DSPVector(0.5f));
+    while (resampler.getReadAvailable() >= kFloatsPerDSPVector)
+    {
+      DSPVector y = resampler.read();
+      output += kFloatsPerDSPVector;
+
+      // a constant stays constant, once the filter is full.
+      if (v > 4) REQUIRE(max(abs(y - DSPVector(0.5f))) < 1e-3f);
+    }
+  }
+  REQUIRE(fabs(output - expectedOutput) < kFloatsPerDSPVector * 2);
+
+  // ratios are clamped to the range given.
+  resampler.setRatio(4.0);
+  REQUIRE(resampler.getRatio() == 2.0);
+}
+
+TEST_CASE("madronalib/core/resampler/time", "[resampler]")
+{
+  // time upsampling by 2x against the half band Upsampler.
+  Resampler low(2.0, Resampler::kLowQuality);
+  Resampler medium(2.0, Resampler::kMediumQuality);
+  Resampler high(2.0, Resampler::kHighQuality);
+  Upsampler halfBand(1);
+  DSPVector x = sin(columnIndex() * 0.1f);
+
+  auto resample = [&](Resampler& r) {
+    r.write(x);
+    DSPVector y = r.read();
+    y += r.read();
+    return y;
+  };
+  std::function<DSPVector(void)> lowFn = [&]() { return resample(low); };
+  std::function<DSPVector(void)> mediumFn = [&]() { return resample(medium); };
+  std::function<DSPVector(void)> highFn = [&]() { return resample(high); };
+  std::function<DSPVector(void)> halfBandFn = [&]() {
+    halfBand.write(x);
+    DSPVector y = halfBand.read();
+    y += halfBand.read();
+    return y;
+  };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto lowTime = timeIterationsInThread<DSPVector>(lowFn);
+  auto mediumTime = timeIterationsInThread<DSPVector>(mediumFn);
+  auto highTime = timeIterationsInThread<DSPVector>(highFn);
+  auto halfBandTime = timeIterationsInThread<DSPVector>(halfBandFn);
+#else
+  auto lowTime = timeIterations<DSPVector>(lowFn);
+  auto mediumTime = timeIterations<DSPVector>(mediumFn);
+  auto highTime = timeIterations<DSPVector>(highFn);
+  auto halfBandTime = timeIterations<DSPVector>(halfBandFn);
+#endif
+
+  /*
+  std::cout << "2x upsampling: resampler low: " << lowTime.ns << ", medium: " << mediumTime.ns
+            << ", high: " << highTime.ns << ", half band: " << halfBandTime.ns << " \n";
+   */
+}
@@ -0,0 +1,170 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <array>
+#include <iostream>
+#include <vector>
+
+#include "catch.hpp"
+#include "madronalib.h"
+#include "mldsp.h"
+#include "tests.h"
+
+using namespace ml;
+
+namespace
+{
+// run noise through an STFT with the given spectrum function, and return the
+// largest difference of the output from the input delayed by the latency.
+template <typename FN>
+float identityError(size_t frameSize, size_t hop, FN fn,
+                    Projection window = windows::raisedCosine)
+{
+  STFT stft(frameSize, hop, window);
+  const size_t latency = stft.getLatency();
+  const size_t nVectors = (latency + frameSize * 4) / kFloatsPerDSPVector;
+  std::vector<float> x, y;
+  NoiseGen noise;
+  for (size_t v = 0; v < nVectors; ++v)
+  {
+    DSPVector in = noise();
+    DSPVector out = stft(in, fn);
+    x.insert(x.end(), in.getConstBuffer(), in.getConstBuffer() + kFloatsPerDSPVector);
+    y.insert(y.end(), out.getConstBuffer(), out.getConstBuffer() + kFloatsPerDSPVector);
+  }
+
+  float maxError{0};
+  for (size_t t = 0; t < y.size(); ++t)
+  {
+    const float expected = (t >= latency) ? x[t - latency] : 0.f;
+    maxError = std::max(maxError, fabsf(y[t] - expected));
+  }
+  return maxError;
+}
+
+// the RMS of the output of an STFT for a sine input, after the latency.
+template <typename FN>
+float sineRMS(STFT& stft, float omega, FN fn)
+{
+  const size_t skipVectors = (stft.getLatency() + stft.getFrameSize()) / kFloatsPerDSPVector + 1;
+  float phase{0};
+  double sumOfSquares{0};
+  size_t n{0};
+  for (size_t v = 0; v < skipVectors * 4; ++v)
+  {
+    DSPVector in = sin(columnIndex() * omega + phase);
+    phase = fmodf(phase + omega * kFloatsPerDSPVector, kTwoPi);
+    DSPVector out = stft(in, fn);
+    if (v >= skipVectors)
+    {
+      for (int i = 0; i < kFloatsPerDSPVector; ++i)
+      {
+        sumOfSquares += out[i] * out[i];
+      }
+      n += kFloatsPerDSPVector;
+    }
+  }
+  return sqrtf(static_cast<float>(sumOfSquares / n));
+}
+}  // namespace
+
+TEST_CASE("madronalib/core/stft/identity", "[stft]")
+{
+  // with an unchanged spectrum, the output is the delayed input, for hops that
+  // are smaller and larger than the vector size.
+  auto unity = [](float*, size_t) {};
+  REQUIRE(identityError(128, 32, unity) < 1e-4f);
+  REQUIRE(identityError(1024, 256, unity) < 1e-4f);
+  REQUIRE(identityError(2048, 512, unity) < 1e-4f);
+
+  STFT stft(1024, 256);
+  REQUIRE(stft.getLatency() >= 1024 - 256);
+
+  // with no function, the spectrum is unchanged.
+  STFT noFunction(256, 64);
+  STFT withUnity(256, 64);
+  NoiseGen noise;
+  float maxDifference{0};
+  for (int v = 0; v < 32; ++v)
+  {
+    DSPVector in = noise();
+    maxDifference = std::max(maxDifference, max(abs(noFunction(in) - withUnity(in, unity))));
+  }
+  REQUIRE(maxDifference < 1e-6f);
+}
+
+TEST_CASE("madronalib/core/stft/hops", "[stft]")
+{
+  // the smallest and largest hops. With a hop of one sample, the squares of any
+  // periodic window overlap-add to a constant. With a hop of the whole frame,
+  // only a constant window does.
+  auto unity = [](float*, size_t) {};
+  REQUIRE(identityError(64, 1, unity) < 1e-4f);
+  REQUIRE(identityError(256, 256, unity, Projection([](float) { return 1.f; })) < 1e-4f);
+
+  STFT whole(256, 256);
+  REQUIRE(whole.getLatency() < 256);
+}
+
+TEST_CASE("madronalib/core/stft/capture", "[stft]")
+{
+  // a lambda whose captures are too large for the small buffer of a
+  // std::function is called directly.
+  std::array<float, 256> gains;
+  gains.fill(0.5f);
+  auto gain = [gains](float* spectrum, size_t size) {
+    for (size_t i = 0; i < size; ++i)
+    {
+      spectrum[i] *= gains[i % gains.size()];
+    }
+  };
+  STFT stft(512, 128);
+  REQUIRE(fabsf(sineRMS(stft, kTwoPi * 0.02f, gain) - 0.5f * sqrtf(0.5f)) < 0.01f);
+}
+
+TEST_CASE("madronalib/core/stft/lowpass", "[stft]")
+{
+  // zero the bins above a quarter of the Nyquist frequency.
+  constexpr size_t kFrameSize = 512;
+  auto lowpass = [](float* spectrum, size_t size) {
+    const size_t half = size / 2;
+    for (size_t i = half / 4; i < half; ++i)
+    {
+      spectrum[i] = spectrum[half + i] = 0.f;
+    }
+    spectrum[half] = 0.f;
+  };
+
+  STFT lowStft(kFrameSize, kFrameSize / 4);
+  STFT highStft(kFrameSize, kFrameSize / 4);
+  const float low = sineRMS(lowStft, kTwoPi * 0.02f, lowpass);
+  const float high = sineRMS(highStft, kTwoPi * 0.3f, lowpass);
+  REQUIRE(fabsf(low - sqrtf(0.5f)) < 0.01f);
+  REQUIRE(high < 0.001f);
+}
+
+TEST_CASE("madronalib/core/stft/time", "[stft]")
+{
+  // time an STFT of 1024 samples at a hop of 256 with a spectral gain.
+  STFT stft(1024, 256);
+  auto gain = [](float* spectrum, size_t size) {
+    for (size_t i = 0; i < size; ++i)
+    {
+      spectrum[i] *= 0.5f;
+    }
+  };
+  DSPVector x = sin(columnIndex() * 0.1f);
+  std::function<DSPVector(void)> process = [&]() { return stft(x, gain); };
+#if (defined __ARM_NEON) || (defined __ARM_NEON__)
+  auto stftTime = timeIterationsInThread<DSPVector>(process);
+#else
+  auto stftTime = timeIterations<DSPVector>(process);
+#endif
+
+  /*
+  std::cout << "stft 1024 / 256: " << stftTime.ns << " \n";
+   */
+}
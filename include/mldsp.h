@@ -13,5 +13,9 @@
 #include "MLDSPProjections.h"
 #include "MLDSPRatio.h"
 #include "MLDSPRouting.h"
+#include "MLDSPResampler.h"
+#include "MLDSPFFT.h"
+#include "MLDSPConvolution.h"
+#include "MLDSPSTFT.h"
 #include "MLDSPScale.h"
 
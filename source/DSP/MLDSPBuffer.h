@@ -6,35 +6,32 @@
 // audio. Some nice implementation details are borrowed from Portaudio's
 // pa_ringbuffer by Phil Burk and others. C++11 atomics are used to implement
 // the lockfree algorithm.
+//
+// The data is kept in a RingStorage. Where the storage is double mapped, every
+// read and write is contiguous. Otherwise, reads and writes of up to the mirror
+// size given to resize() are contiguous, and longer ones that cross the end of
+// the buffer are split in two.
 
 #pragma once
 
 #include <algorithm>
 #include <atomic>
-#include <vector>
 
 #include "MLDSPOps.h"
+#include "MLDSPRingStorage.h"
 
 namespace ml
 {
 class DSPBuffer
 {
  private:
-  std::vector<float> mData;
-  float *mDataBuffer{nullptr};
+  RingStorage mData;
   size_t mSize{0};
   size_t mDataMask{0};
   size_t mDistanceMask{0};
 
   std::atomic<size_t> mWriteIndex{0};
   std::atomic<size_t> mReadIndex{0};
-  struct DataRegions
-  {
-    float *p1;
-    size_t size1;
-    float *p2;
-    size_t size2;
-  };
 
   inline void addSamples(const float *pSrcStart, const float *pSrcEnd, float *pDest)
   {
@@ -54,29 +51,64 @@ class DSPBuffer
     return (start - samples) & mDistanceMask;
   }
 
-  inline DataRegions getDataRegions(size_t currentIdx, size_t elems) const
+  // return a pointer to the data at the given index, if the samples from there
+  // are contiguous, otherwise nullptr.
+  inline float *getContiguousPointer(size_t currentIdx, size_t samples) const
+  {
+    const size_t start = currentIdx & mDataMask;
+    return mData.isContiguous(start, samples) ? const_cast<float *>(mData.data()) + start
+                                              : nullptr;
+  }
+
+  // call fn(pData, offset, n) for each of the one or two contiguous regions of
+  // the data holding the samples from the given index, where offset is the
+  // position of the region in the samples.
+  template <typename FN>
+  inline void forEachRegion(size_t currentIdx, size_t samples, FN fn) const
   {
-    size_t startIdx = currentIdx & mDataMask;
-    if (startIdx + elems > mSize)
+    float *pData = const_cast<float *>(mData.data());
+    const size_t start = currentIdx & mDataMask;
+    if (mData.isContiguous(start, samples))
     {
-      size_t firstHalf = mSize - startIdx;
-      size_t secondHalf = elems - firstHalf;
-      return DataRegions{mDataBuffer + startIdx, firstHalf, mDataBuffer, secondHalf};
+      fn(pData + start, size_t(0), samples);
     }
     else
     {
-      return DataRegions{mDataBuffer + startIdx, elems, nullptr, 0};
+      const size_t first = mSize - start;
+      fn(pData + start, size_t(0), first);
+      fn(pData, first, samples - first);
     }
   }
 
+  // after writing samples at the given index, update the storage's mirror.
+  inline void commitWrite(size_t currentIdx, size_t samples)
+  {
+    forEachRegion(currentIdx, samples,
+                  [&](float *p, size_t, size_t n)
+                  { mData.commitWrite(size_t(p - mData.data()), n); });
+  }
+
+  inline void copyIn(size_t currentIdx, const float *pSrc, size_t samples)
+  {
+    forEachRegion(currentIdx, samples,
+                  [&](float *p, size_t offset, size_t n)
+                  { std::copy(pSrc + offset, pSrc + offset + n, p); });
+    commitWrite(currentIdx, samples);
+  }
+
+  inline void copyOut(size_t currentIdx, float *pDest, size_t samples) const
+  {
+    forEachRegion(currentIdx, samples,
+                  [&](float *p, size_t offset, size_t n)
+                  { std::copy(p, p + n, pDest + offset); });
+  }
+
  public:
   DSPBuffer() {}
   ~DSPBuffer() {}
 
   DSPBuffer(const DSPBuffer &b)
   {
-    mSize = b.mSize;
-
     try
     {
       mData = b.mData;
@@ -87,7 +119,7 @@ class DSPBuffer
       return;
     }
 
-    mDataBuffer = mData.data();
+    mSize = mData.size();
     mDataMask = mSize - 1;
     mDistanceMask = mSize * 2 - 1;
   }
@@ -100,8 +132,10 @@ class DSPBuffer
   }
 
   // resize the buffer, allocating 2^n samples sufficient to contain the
-  // requested length.
-  size_t resize(int sizeInSamples)
+  // requested length. Where the storage is not double mapped, reads and writes
+  // of up to maxContiguous samples are contiguous, at the cost of a mirror of
+  // that many samples which is kept up to date on each write.
+  size_t resize(int sizeInSamples, int maxContiguous = kFloatsPerDSPVector)
   {
     mReadIndex = mWriteIndex = 0;
 
@@ -110,7 +144,7 @@ class DSPBuffer
 
     try
     {
-      mData.resize(mSize);
+      mData.resize(mSize, std::min(mSize, size_t(std::max(maxContiguous, 1))));
     }
     catch (const std::bad_alloc &)
     {
@@ -118,15 +152,16 @@ class DSPBuffer
       return 0;
     }
 
-    mDataBuffer = mData.data();
+    mSize = mData.size();
     mDataMask = mSize - 1;
 
     // The distance mask idea is based on code from PortAudio's ringbuffer by
     // Phil Burk. By keeping the read and write indices constrained to size*2
     // instead of size, the full state (write - read = size) can be
-    // distinguished from the empty state (write - read = 0).
-    // getDataRegions() is always used to generate the raw data pointers for
-    // reading / writing.
+    // distinguished from the empty state (write - read = 0). The indices are
+    // masked with mDataMask only where they are turned into data pointers, by
+    // getContiguousPointer() for accesses that fit in the mirror, or by
+    // forEachRegion() for those that are split at the end of the buffer.
     mDistanceMask = mSize * 2 - 1;
 
     return mSize;
@@ -149,13 +184,7 @@ class DSPBuffer
     bool full = (getWriteAvailable() < samples);
 
     const auto currentWriteIndex = mWriteIndex.load(std::memory_order_acquire);
-    DataRegions dr = getDataRegions(currentWriteIndex, samples);
-
-    std::copy(pSrc, pSrc + dr.size1, dr.p1);
-    if (dr.p2)
-    {
-      std::copy(pSrc + dr.size1, pSrc + dr.size1 + dr.size2, dr.p2);
-    }
+    copyIn(currentWriteIndex, pSrc, samples);
 
     mWriteIndex.store(advanceDistanceIndex(currentWriteIndex, samples), std::memory_order_release);
 
@@ -175,26 +204,20 @@ class DSPBuffer
 
     bool full = (getWriteAvailable() < samples);
 
+    // copy a number of samples known at compile time, if contiguous.
     const auto currentWriteIndex = mWriteIndex.load(std::memory_order_acquire);
-    DataRegions dr = getDataRegions(currentWriteIndex, samples);
-
-    if (!dr.p2)
+    if (float *pDest = getContiguousPointer(currentWriteIndex, samples))
     {
-      // we have only one region, so we can copy a number of samples known at
-      // compile time.
-      mWriteIndex.store(advanceDistanceIndex(currentWriteIndex, samples),
-                        std::memory_order_release);
-      store(srcVec, dr.p1);
+      store(srcVec, pDest);
+      commitWrite(currentWriteIndex, samples);
     }
     else
     {
-      const float *pSrc = srcVec.getConstBuffer();
-      std::copy(pSrc, pSrc + dr.size1, dr.p1);
-      std::copy(pSrc + dr.size1, pSrc + dr.size1 + dr.size2, dr.p2);
-      mWriteIndex.store(advanceDistanceIndex(currentWriteIndex, samples),
-                        std::memory_order_release);
+      copyIn(currentWriteIndex, srcVec.getConstBuffer(), samples);
     }
 
+    mWriteIndex.store(advanceDistanceIndex(currentWriteIndex, samples), std::memory_order_release);
+
     if (full)
     {
       // oldest data was clobbered by write. set read index to indicate we
@@ -210,13 +233,7 @@ class DSPBuffer
     samples = std::min(samples, available);
 
     const auto currentReadIndex = mReadIndex.load(std::memory_order_acquire);
-    DataRegions dr = getDataRegions(currentReadIndex, samples);
-
-    std::copy(dr.p1, dr.p1 + dr.size1, pDest);
-    if (dr.p2)
-    {
-      std::copy(dr.p2, dr.p2 + dr.size2, pDest + dr.size1);
-    }
+    copyOut(currentReadIndex, pDest, samples);
 
     mReadIndex.store(advanceDistanceIndex(currentReadIndex, samples), std::memory_order_release);
     return samples;
@@ -229,49 +246,36 @@ class DSPBuffer
     constexpr int samples = kFloatsPerDSPVector * VECTORS;
     if (getReadAvailable() < samples) return;
 
+    // copy a number of samples known at compile time, if contiguous.
     const auto currentReadIndex = mReadIndex.load(std::memory_order_acquire);
-    DataRegions dr = getDataRegions(currentReadIndex, samples);
-
-    if (!dr.p2)
+    if (const float *pSrc = getContiguousPointer(currentReadIndex, samples))
     {
-      // we have only one region, so we can copy a number of samples known at
-      // compile time.
-      mReadIndex.store(advanceDistanceIndex(currentReadIndex, samples), std::memory_order_release);
-      load(destVec, dr.p1);
+      load(destVec, pSrc);
     }
     else
     {
-      float *pDest = destVec.getBuffer();
-      std::copy(dr.p1, dr.p1 + dr.size1, pDest);
-      std::copy(dr.p2, dr.p2 + dr.size2, pDest + dr.size1);
-      mReadIndex.store(advanceDistanceIndex(currentReadIndex, samples), std::memory_order_release);
+      copyOut(currentReadIndex, destVec.getBuffer(), samples);
     }
+    mReadIndex.store(advanceDistanceIndex(currentReadIndex, samples), std::memory_order_release);
   }
 
   // read a single DSPVector from the buffer, advancing the read index.
   DSPVector read()
   {
-    DSPVector destVec;
+    DSPVector destVec(kUninitialized);
     constexpr int samples = kFloatsPerDSPVector;
     if (getReadAvailable() < samples) return DSPVector{};
 
     const auto currentReadIndex = mReadIndex.load(std::memory_order_acquire);
-    DataRegions dr = getDataRegions(currentReadIndex, samples);
-
-    if (!dr.p2)
+    if (const float *pSrc = getContiguousPointer(currentReadIndex, samples))
     {
-      // we have only one region, so we can copy a number of samples known at
-      // compile time.
-      mReadIndex.store(advanceDistanceIndex(currentReadIndex, samples), std::memory_order_release);
-      load(destVec, dr.p1);
+      load(destVec, pSrc);
     }
     else
     {
-      float *pDest = destVec.getBuffer();
-      std::copy(dr.p1, dr.p1 + dr.size1, pDest);
-      std::copy(dr.p2, dr.p2 + dr.size2, pDest + dr.size1);
-      mReadIndex.store(advanceDistanceIndex(currentReadIndex, samples), std::memory_order_release);
+      copyOut(currentReadIndex, destVec.getBuffer(), samples);
     }
+    mReadIndex.store(advanceDistanceIndex(currentReadIndex, samples), std::memory_order_release);
     return destVec;
   }
 
@@ -297,23 +301,17 @@ class DSPBuffer
     size_t currentWriteIndex = mWriteIndex.load(std::memory_order_acquire);
 
     // add samples to data in buffer
-    DataRegions dr = getDataRegions(currentWriteIndex, samples);
-    addSamples(pSrc, pSrc + dr.size1, dr.p1);
-    if (dr.p2)
-    {
-      addSamples(pSrc + dr.size1, pSrc + dr.size1 + dr.size2, dr.p2);
-    }
+    forEachRegion(currentWriteIndex, samples,
+                  [&](float *p, size_t offset, size_t n)
+                  { addSamples(pSrc + offset, pSrc + offset + n, p); });
+    commitWrite(currentWriteIndex, samples);
 
     // clear samples for next overlapped add
     currentWriteIndex = advanceDistanceIndex(currentWriteIndex, samples);
     size_t samplesToClear = samples - overlap;
-    dr = getDataRegions(currentWriteIndex, samplesToClear);
-
-    std::fill(dr.p1, dr.p1 + dr.size1, 0.f);
-    if (dr.p2)
-    {
-      std::fill(dr.p2, dr.p2 + dr.size2, 0.f);
-    }
+    forEachRegion(currentWriteIndex, samplesToClear,
+                  [&](float *p, size_t, size_t n) { std::fill(p, p + n, 0.f); });
+    commitWrite(currentWriteIndex, samplesToClear);
 
     currentWriteIndex = rewindDistanceIndex(currentWriteIndex, overlap);
 
@@ -327,13 +325,7 @@ class DSPBuffer
     samples = std::min(samples, available);
 
     const auto currentReadIndex = mReadIndex.load(std::memory_order_acquire);
-    DataRegions dr = getDataRegions(currentReadIndex, samples);
-
-    std::copy(dr.p1, dr.p1 + dr.size1, pDest);
-    if (dr.p2)
-    {
-      std::copy(dr.p2, dr.p2 + dr.size2, pDest + dr.size1);
-    }
+    copyOut(currentReadIndex, pDest, samples);
 
     mReadIndex.store(advanceDistanceIndex(currentReadIndex, samples - overlap),
                      std::memory_order_release);
@@ -347,39 +339,7 @@ class DSPBuffer
     if (avail < samples) return;
 
     const auto currentReadIndex = mReadIndex.load(std::memory_order_acquire);
-    DataRegions dr = getDataRegions(currentReadIndex, avail);
-
-    if (!dr.p2)
-    {
-      // we have only one region. copy most recent samples from it.
-      // mReadIndex.store(advanceDistanceIndex(currentReadIndex, samples),
-      // std::memory_order_release);
-      float *pSrc = dr.p1 + dr.size1 - samples;
-      std::copy(pSrc, pSrc + samples, pDest);
-    }
-    else
-    {
-      if (dr.size2 >= samples)
-      {
-        // enough samples are in region 2
-        float *pSrc = dr.p2 + dr.size2 - samples;
-        std::copy(pSrc, pSrc + samples, pDest);
-      }
-      else
-      {
-        // we need samples from both regions.
-
-        // write r1 samples from end
-        auto r1Samples = samples - dr.size2;
-        float *pSrc1 = dr.p1 + dr.size1 - r1Samples;
-        std::copy(pSrc1, pSrc1 + r1Samples, pDest);
-
-        // write all r2 samples after r1 samples
-        auto r2Samples = dr.size2;
-        float *pSrc2 = dr.p2;
-        std::copy(pSrc2, pSrc2 + r2Samples, pDest + r1Samples);
-      }
-    }
+    copyOut(currentReadIndex + avail - samples, pDest, samples);
   }
 };
 }  // namespace ml
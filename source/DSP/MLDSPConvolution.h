@@ -0,0 +1,492 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// Convolver: convolution with long impulse responses, with no latency.
+//
+// The impulse response is split into segments, each partitioned uniformly and
+// convolved by the overlap-save method with a frequency domain delay line. The
+// first segment has partitions of kFloatsPerDSPVector samples. It is computed in
+// the audio thread for every DSPVector, including the current input, so the
+// Convolver adds no latency. Each later segment has partitions kSizeRatio
+// times larger than the one before, and starts at an offset of twice its
+// partition size into the impulse response. Once a partition of input for a
+// segment is complete, its output is not needed until one partition later, so
+// the larger segments are computed by worker threads in the meantime.
+//
+// The workers are shared by all Convolvers. Each size of segment has its own
+// worker, so the short jobs of small segments are never stuck behind one long
+// job. The workers run at normal priority. The audio thread hands work to the
+// workers and takes back results through atomic counters and semaphores, with
+// no locks. The audio thread never waits for a worker or runs its jobs: if a
+// worker is late, the output of its segment is left out until it catches up,
+// and the miss is counted. A worker that falls more than a partition behind
+// skips the jobs whose output is past due.
+// Without worker threads, for offline processing, all of the segments are
+// computed in the audio thread. To run with worker threads faster than real
+// time, call waitForWorkers() before each vector.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#elif defined(__linux__)
+#include <semaphore.h>
+
+#include <cerrno>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <chrono>
+#endif
+
+#include "MLDSPFFT.h"
+#include "MLDSPOps.h"
+#include "MLSharedResource.h"
+
+namespace ml
+{
+class Convolver;
+
+// ConvolverWorkers: the worker threads shared by all Convolvers. The worker
+// for each level runs the jobs of that segment of every Convolver.
+class ConvolverWorkers
+{
+ public:
+  // levels past the last share its worker.
+  static constexpr size_t kMaxLevels = 8;
+
+  // a semaphore the audio thread can signal without locking.
+  class Semaphore
+  {
+   public:
+#if defined(__APPLE__)
+    Semaphore() : _sem(dispatch_semaphore_create(0)) {}
+    ~Semaphore() { dispatch_release(_sem); }
+    void post() { dispatch_semaphore_signal(_sem); }
+    void wait() { dispatch_semaphore_wait(_sem, DISPATCH_TIME_FOREVER); }
+
+   private:
+    dispatch_semaphore_t _sem;
+#elif defined(__linux__)
+    Semaphore() { sem_init(&_sem, 0, 0); }
+    ~Semaphore() { sem_destroy(&_sem); }
+    void post() { sem_post(&_sem); }
+    void wait()
+    {
+      while ((sem_wait(&_sem) != 0) && (errno == EINTR))
+      {
+      }
+    }
+
+   private:
+    sem_t _sem;
+#elif defined(_WIN32)
+    Semaphore() : _sem(CreateSemaphore(nullptr, 0, MAXLONG, nullptr)) {}
+    ~Semaphore() { CloseHandle(_sem); }
+    void post() { ReleaseSemaphore(_sem, 1, nullptr); }
+    void wait() { WaitForSingleObject(_sem, INFINITE); }
+
+   private:
+    HANDLE _sem;
+#else
+    // with no native semaphore, the worker polls a count. The shortest
+    // partition on a worker is many milliseconds long, so a short sleep
+    // between polls costs little.
+    void post() { _count.fetch_add(1, std::memory_order_release); }
+    void wait()
+    {
+      size_t n = _count.load(std::memory_order_acquire);
+      while (!((n > 0) && _count.compare_exchange_weak(n, n - 1, std::memory_order_acq_rel)))
+      {
+        if (n == 0)
+        {
+          std::this_thread::sleep_for(std::chrono::microseconds(200));
+          n = _count.load(std::memory_order_acquire);
+        }
+      }
+    }
+
+   private:
+    std::atomic<size_t> _count{0};
+#endif
+  };
+
+  struct Level
+  {
+    std::thread thread;
+    Semaphore workReady;
+
+    // locked by the worker while it runs jobs, and when adding or removing a
+    // Convolver, never by the audio thread.
+    std::mutex convolversMutex;
+    std::vector<Convolver*> convolvers;
+  };
+
+  ~ConvolverWorkers()
+  {
+    _running = false;
+    for (auto& level : _levels)
+    {
+      if (level)
+      {
+        level->workReady.post();
+        level->thread.join();
+      }
+    }
+  }
+
+  // get the worker for the given level, starting it if needed, and add the
+  // Convolver to its list. Not for use in the audio thread.
+  Level* addConvolver(Convolver* c, size_t levelIdx)
+  {
+    levelIdx = std::min(levelIdx, kMaxLevels - 1);
+    std::lock_guard<std::mutex> lock(_levelsMutex);
+    auto& level = _levels[levelIdx];
+    if (!level)
+    {
+      level = std::unique_ptr<Level>(new Level);
+      Level* pLevel = level.get();
+      level->thread = std::thread([this, pLevel, levelIdx]() { runWorker(*pLevel, levelIdx); });
+    }
+    std::lock_guard<std::mutex> convolversLock(level->convolversMutex);
+    auto& v = level->convolvers;
+    if (std::find(v.begin(), v.end(), c) == v.end())
+    {
+      v.push_back(c);
+    }
+    return level.get();
+  }
+
+  // remove the Convolver, waiting for any job of it that is running.
+  void removeConvolver(Convolver* c, Level* level)
+  {
+    std::lock_guard<std::mutex> lock(level->convolversMutex);
+    auto& v = level->convolvers;
+    v.erase(std::remove(v.begin(), v.end(), c), v.end());
+  }
+
+ private:
+  std::atomic<bool> _running{true};
+  std::mutex _levelsMutex;
+  std::array<std::unique_ptr<Level>, kMaxLevels> _levels;
+
+  void runWorker(Level& level, size_t levelIdx);
+};
+
+class Convolver
+{
+ public:
+  // ratio of partition sizes between segments.
+  static constexpr size_t kSizeRatio = 8;
+
+  // make a Convolver for the impulse response ir[0, length). This allocates
+  // memory and is not for use in the audio thread.
+  Convolver(const float* ir, size_t length, bool useWorkerThread = true)
+  {
+    makeSegments(ir, length);
+
+    size_t historySize = kFloatsPerDSPVector * 2;
+    for (auto& s : _segments)
+    {
+      historySize = std::max(historySize, s->partitionSize * 4);
+    }
+    _history.resize(size_t(1) << bitsToContain(static_cast<int>(historySize)));
+    _historyMask = _history.size() - 1;
+
+    if (useWorkerThread)
+    {
+      for (size_t i = 1; i < _segments.size(); ++i)
+      {
+        _segments[i]->worker = _workers->addConvolver(this, i);
+      }
+    }
+  }
+
+  ~Convolver()
+  {
+    for (auto& s : _segments)
+    {
+      if (s->worker)
+      {
+        _workers->removeConvolver(this, s->worker);
+      }
+    }
+  }
+
+  Convolver(const Convolver&) = delete;
+  Convolver& operator=(const Convolver&) = delete;
+
+  // convolve the input with the impulse response.
+  DSPVector operator()(const DSPVector& x)
+  {
+    constexpr size_t kBlock = kFloatsPerDSPVector;
+
+    // write the input to the history.
+    std::copy(x.getConstBuffer(), x.getConstBuffer() + kBlock,
+              _history.data() + (_time & _historyMask));
+    const size_t nextTime = _time + kBlock;
+
+    // the first segment, on this vector.
+    DSPVector y(kUninitialized);
+    Segment& head = *_segments[0];
+    computeSegment(head, nextTime - 2 * kBlock);
+    std::copy(head.result.data() + kBlock, head.result.data() + 2 * kBlock, y.getBuffer());
+
+    // add the outputs of the later segments that have started.
+    for (size_t i = 1; i < _segments.size(); ++i)
+    {
+      Segment& s = *_segments[i];
+      if (_time < s.offset) break;
+      const size_t job = (_time - s.offset) / s.partitionSize;
+      if (s.completed.load(std::memory_order_acquire) <= job)
+      {
+        // the worker is late. Leave this segment out rather than wait.
+        _numMisses++;
+        continue;
+      }
+      const float* pOut = s.output.data() + (_time & s.outputMask);
+      float* py = y.getBuffer();
+      for (size_t n = 0; n < kBlock; n += kFloatsPerSIMDVector)
+      {
+        vecStore(py + n, vecAdd(vecLoad(py + n), vecLoadUnaligned(pOut + n)));
+      }
+    }
+
+    // start the later segments whose input partitions are now complete. This
+    // comes after reading their outputs, so a worker can't skip a job that is
+    // still being heard.
+    for (size_t i = 1; i < _segments.size(); ++i)
+    {
+      Segment& s = *_segments[i];
+      if ((nextTime & (s.partitionSize - 1)) == 0)
+      {
+        if (s.worker)
+        {
+          s.requested.store(nextTime / s.partitionSize, std::memory_order_release);
+          s.worker->workReady.post();
+        }
+        else
+        {
+          runJob(s, nextTime / s.partitionSize - 1);
+        }
+      }
+    }
+
+    _time = nextTime;
+    return y;
+  }
+
+  // wait until the workers have finished all the jobs requested so far, so
+  // that the next vector has all of its segments. For running faster than real
+  // time with worker threads. Not for use in the audio thread.
+  void waitForWorkers()
+  {
+    for (auto& s : _segments)
+    {
+      if (s->worker)
+      {
+        while (s->completed.load(std::memory_order_acquire) <
+               s->requested.load(std::memory_order_acquire))
+        {
+          std::this_thread::yield();
+        }
+      }
+    }
+  }
+
+  // the number of segments, for testing.
+  size_t getNumSegments() const { return _segments.size(); }
+
+  // the number of times a segment was left out of a vector because its worker
+  // was late, for testing.
+  size_t getNumMisses() const { return _numMisses; }
+
+ private:
+  struct Segment
+  {
+    size_t partitionSize{0};
+    size_t offset{0};
+    size_t nPartitions{0};
+    std::unique_ptr<FFT> fft;
+
+    // spectra of the impulse response partitions and of past input windows.
+    std::vector<float> irSpectra;
+    std::vector<float> inputSpectra;
+    size_t inputIndex{0};
+    std::vector<float> window, sum, result;
+
+    // outputs of the worker, indexed by time.
+    std::vector<float> output;
+    size_t outputMask{0};
+    std::atomic<size_t> requested{0};
+    std::atomic<size_t> completed{0};
+    ConvolverWorkers::Level* worker{nullptr};
+  };
+
+  std::vector<std::unique_ptr<Segment> > _segments;
+  std::vector<float> _history;
+  size_t _historyMask{0};
+  size_t _time{0};
+  size_t _numMisses{0};
+
+  SharedResourcePointer<ConvolverWorkers> _workers;
+
+  friend class ConvolverWorkers;
+
+  void makeSegments(const float* ir, size_t length)
+  {
+    size_t offset = 0;
+    size_t partitionSize = kFloatsPerDSPVector;
+    do
+    {
+      // each segment ends where the next one can start, at twice its partition size.
+      const size_t nextPartitionSize = partitionSize * kSizeRatio;
+      const size_t end = std::max(std::min(length, nextPartitionSize * 2), offset + 1);
+      const size_t nPartitions = (end - offset + partitionSize - 1) / partitionSize;
+      const size_t fftSize = partitionSize * 2;
+
+      auto s = std::unique_ptr<Segment>(new Segment);
+      s->partitionSize = partitionSize;
+      s->offset = offset;
+      s->nPartitions = nPartitions;
+      s->fft = std::unique_ptr<FFT>(new FFT(fftSize));
+      s->irSpectra.resize(nPartitions * fftSize);
+      s->inputSpectra.resize(nPartitions * fftSize);
+      s->window.resize(fftSize);
+      s->sum.resize(fftSize);
+      s->result.resize(fftSize);
+
+      // the spectrum of each partition, zero padded to the FFT size.
+      std::vector<float> padded(fftSize);
+      for (size_t p = 0; p < nPartitions; ++p)
+      {
+        std::fill(padded.begin(), padded.end(), 0.f);
+        const size_t start = offset + p * partitionSize;
+        const size_t n = std::min(partitionSize, length > start ? length - start : 0);
+        std::copy(ir + start, ir + start + n, padded.begin());
+        s->fft->forward(padded.data(), s->irSpectra.data() + p * fftSize);
+      }
+
+      if (offset > 0)
+      {
+        const size_t outputSize = offset + partitionSize * 2;
+        s->output.resize(size_t(1) << bitsToContain(static_cast<int>(outputSize)));
+        s->outputMask = s->output.size() - 1;
+      }
+
+      _segments.push_back(std::move(s));
+      offset = end;
+      partitionSize = nextPartitionSize;
+    } while (offset < length);
+  }
+
+  // run one step of the overlap-save convolution for a segment, on the input
+  // window of two partitions starting at the given time. The output for the
+  // second partition of the window is left in the second half of s.result.
+  void computeSegment(Segment& s, size_t windowStart)
+  {
+    const size_t fftSize = s.partitionSize * 2;
+    const size_t start = windowStart & _historyMask;
+    const size_t firstPart = std::min(fftSize, _history.size() - start);
+    std::copy(_history.data() + start, _history.data() + start + firstPart, s.window.data());
+    std::copy(_history.data(), _history.data() + fftSize - firstPart,
+              s.window.data() + firstPart);
+
+    // add this window's spectrum to the delay line, then multiply each partition
+    // of the impulse response by the spectrum of its input and sum.
+    float* pInput = s.inputSpectra.data();
+    const float* pIR = s.irSpectra.data();
+    s.fft->forward(s.window.data(), pInput + s.inputIndex * fftSize);
+    size_t inputIndex = s.inputIndex;
+    multiplySpectra(pIR, pInput + inputIndex * fftSize, s.sum.data(), fftSize);
+    for (size_t p = 1; p < s.nPartitions; ++p)
+    {
+      inputIndex = inputIndex ? inputIndex - 1 : s.nPartitions - 1;
+      multiplyAddSpectra(pIR + p * fftSize, pInput + inputIndex * fftSize, s.sum.data(),
+                         fftSize);
+    }
+    s.inputIndex = (s.inputIndex + 1 < s.nPartitions) ? s.inputIndex + 1 : 0;
+    s.fft->inverse(s.sum.data(), s.result.data());
+  }
+
+  // compute the output of a later segment for its input partition number job,
+  // which is heard starting job partitions after the segment's offset.
+  void runJob(Segment& s, size_t job)
+  {
+    const size_t p = s.partitionSize;
+    computeSegment(s, (job - 1) * p);
+    const size_t outStart = (job * p + s.offset) & s.outputMask;
+    std::copy(s.result.data() + p, s.result.data() + 2 * p, s.output.data() + outStart);
+    s.completed.store(job + 1, std::memory_order_release);
+  }
+
+  // skip a job whose output is past due. Its slot in the frequency domain delay
+  // line is cleared, so the later jobs that would use it are missing one
+  // partition of input instead of using a stale one.
+  void skipJob(Segment& s, size_t job)
+  {
+    const size_t fftSize = s.partitionSize * 2;
+    float* pInput = s.inputSpectra.data() + s.inputIndex * fftSize;
+    std::fill(pInput, pInput + fftSize, 0.f);
+    s.inputIndex = (s.inputIndex + 1 < s.nPartitions) ? s.inputIndex + 1 : 0;
+    s.completed.store(job + 1, std::memory_order_release);
+  }
+
+  // run the pending jobs of the segment at the given level, in the worker for
+  // that level.
+  void runPendingJobs(size_t levelIdx)
+  {
+    // the last worker also runs any levels past it.
+    const bool isLast = (levelIdx + 1 == ConvolverWorkers::kMaxLevels);
+    const size_t last = isLast ? _segments.size() - 1 : levelIdx;
+    for (size_t i = levelIdx; i <= last; ++i)
+    {
+      // only this worker runs the segment's jobs, so it owns the completed count.
+      Segment& s = *_segments[i];
+      size_t job = s.completed.load(std::memory_order_relaxed);
+      size_t requested = s.requested.load(std::memory_order_acquire);
+      while (job < requested)
+      {
+        // the output of a job is heard in the partition after its request, so
+        // once two more partitions have been requested it is past due.
+        if (requested > job + 2)
+        {
+          skipJob(s, job++);
+        }
+        else
+        {
+          runJob(s, job++);
+        }
+        requested = s.requested.load(std::memory_order_acquire);
+      }
+    }
+  }
+};
+
+inline void ConvolverWorkers::runWorker(Level& level, size_t levelIdx)
+{
+  while (true)
+  {
+    level.workReady.wait();
+    if (!_running) break;
+    std::lock_guard<std::mutex> lock(level.convolversMutex);
+    for (Convolver* c : level.convolvers)
+    {
+      c->runPendingJobs(levelIdx);
+    }
+  }
+}
+
+}  // namespace ml
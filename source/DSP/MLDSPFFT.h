@@ -0,0 +1,290 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// Real FFTs built on Laurent de Soras' ffft library in external/ffft.
+//
+// FFT transforms a runtime size, FixedFFT<LOG2_SIZE> a compile-time size using
+// ffft's unrolled FFTRealFixLen. Both work on float buffers of their size, or on
+// DSPVectorArrays with the same number of samples.
+//
+// Spectra are stored in split-complex form: the first half of a spectrum of size
+// N holds the real parts of bins 0 to N/2 - 1, and the second half holds their
+// imaginary parts. The DC and Nyquist bins are real, so the real part of the
+// Nyquist bin is packed into the imaginary part of bin 0. This is ffft's layout,
+// except that ffft stores the imaginary parts negated. With this layout the
+// real and imaginary parts of SIMD vectors of bins can be loaded directly.
+//
+// The inverse transforms are scaled by 1/N, so that inverse(forward(x)) == x.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "FFTReal.h"
+#include "FFTRealFixLen.h"
+#include "MLDSPOps.h"
+
+namespace ml
+{
+// ----------------------------------------------------------------
+// utilities for split-complex spectra.
+
+namespace detail
+{
+// negate the imaginary parts of bins 1 to N/2 - 1, converting to or from ffft's
+// layout. x and y may be the same.
+inline void conjugateSpectrum(const float* x, float* y, size_t size)
+{
+  const size_t half = size / 2;
+  if (x != y)
+  {
+    std::copy(x, x + half + 1, y);
+  }
+  const size_t start = half + 1;
+  const size_t nVec = (size > start) ? (size - start) / kFloatsPerSIMDVector : 0;
+  const size_t tailStart = start + nVec * kFloatsPerSIMDVector;
+  const SIMDVectorFloat signBit = vecSet1(-0.f);
+  for (size_t v = 0; v < nVec; ++v)
+  {
+    const size_t i = start + v * kFloatsPerSIMDVector;
+    vecStoreUnaligned(y + i, vecXor(vecLoadUnaligned(x + i), signBit));
+  }
+  for (size_t i = tailStart; i < size; ++i)
+  {
+    y[i] = -x[i];
+  }
+}
+
+inline void scaleBuffer(float* x, size_t size, float gain)
+{
+  const size_t nVec = size / kFloatsPerSIMDVector;
+  const size_t tailStart = nVec * kFloatsPerSIMDVector;
+  const SIMDVectorFloat g = vecSet1(gain);
+  for (size_t v = 0; v < nVec; ++v)
+  {
+    const size_t i = v * kFloatsPerSIMDVector;
+    vecStoreUnaligned(x + i, vecMul(vecLoadUnaligned(x + i), g));
+  }
+  for (size_t i = tailStart; i < size; ++i)
+  {
+    x[i] *= gain;
+  }
+}
+
+// y = a*b, or y += a*b if ACCUMULATE, for split-complex spectra. The packed DC
+// and Nyquist bins at index 0 are multiplied as real numbers.
+template <bool ACCUMULATE>
+inline void multiplySpectra(const float* a, const float* b, float* y, size_t size)
+{
+  const size_t half = size / 2;
+  const float dc = a[0] * b[0];
+  const float nyquist = a[half] * b[half];
+  const float y0 = ACCUMULATE ? y[0] : 0.f;
+  const float yHalf = ACCUMULATE ? y[half] : 0.f;
+
+  const float *ar = a, *ai = a + half, *br = b, *bi = b + half;
+  float *yr = y, *yi = y + half;
+  const size_t nVec = half / kFloatsPerSIMDVector;
+  const size_t tailStart = nVec * kFloatsPerSIMDVector;
+  for (size_t v = 0; v < nVec; ++v)
+  {
+    const size_t i = v * kFloatsPerSIMDVector;
+    const SIMDVectorFloat var = vecLoadUnaligned(ar + i), vai = vecLoadUnaligned(ai + i);
+    const SIMDVectorFloat vbr = vecLoadUnaligned(br + i), vbi = vecLoadUnaligned(bi + i);
+    SIMDVectorFloat re = vecFMS(var, vbr, vecMul(vai, vbi));
+    SIMDVectorFloat im = vecFMA(var, vbi, vecMul(vai, vbr));
+    if (ACCUMULATE)
+    {
+      re = vecAdd(re, vecLoadUnaligned(yr + i));
+      im = vecAdd(im, vecLoadUnaligned(yi + i));
+    }
+    vecStoreUnaligned(yr + i, re);
+    vecStoreUnaligned(yi + i, im);
+  }
+  for (size_t i = tailStart; i < half; ++i)
+  {
+    const float re = ar[i] * br[i] - ai[i] * bi[i];
+    const float im = ar[i] * bi[i] + ai[i] * br[i];
+    yr[i] = ACCUMULATE ? yr[i] + re : re;
+    yi[i] = ACCUMULATE ? yi[i] + im : im;
+  }
+  y[0] = y0 + dc;
+  y[half] = yHalf + nyquist;
+}
+}  // namespace detail
+
+// multiply two spectra of the given size, bin by bin, writing to y.
+inline void multiplySpectra(const float* a, const float* b, float* y, size_t size)
+{
+  detail::multiplySpectra<false>(a, b, y, size);
+}
+
+// multiply two spectra of the given size, bin by bin, adding the products to y.
+inline void multiplyAddSpectra(const float* a, const float* b, float* y, size_t size)
+{
+  detail::multiplySpectra<true>(a, b, y, size);
+}
+
+// ----------------------------------------------------------------
+// FFTPlanCache: keeps the ffft objects for each size, with their bit reversal
+// and twiddle factor tables, so that making a new FFT of a size that has been
+// used before does not recompute them. ffft objects also hold scratch memory,
+// so one is never shared by two FFTs at once: an FFT takes a plan from the cache
+// when it is made and gives it back when it is destroyed.
+
+class FFTPlanCache
+{
+ public:
+  using Plan = ffft::FFTReal<float>;
+
+  static FFTPlanCache& theCache()
+  {
+    static FFTPlanCache cache;
+    return cache;
+  }
+
+  std::unique_ptr<Plan> acquire(size_t size)
+  {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      auto& plans = _idlePlans[size];
+      if (!plans.empty())
+      {
+        std::unique_ptr<Plan> plan = std::move(plans.back());
+        plans.pop_back();
+        return plan;
+      }
+    }
+    return std::unique_ptr<Plan>(new Plan(static_cast<long>(size)));
+  }
+
+  void release(std::unique_ptr<Plan> plan)
+  {
+    if (!plan) return;
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idlePlans[static_cast<size_t>(plan->get_length())].push_back(std::move(plan));
+  }
+
+ private:
+  std::mutex _mutex;
+  std::unordered_map<size_t, std::vector<std::unique_ptr<Plan> > > _idlePlans;
+};
+
+// ----------------------------------------------------------------
+// FFT: a real FFT of any power of two size, set at runtime.
+
+class FFT
+{
+  std::unique_ptr<FFTPlanCache::Plan> _plan;
+  std::vector<float> _scratch;
+  size_t _size{0};
+
+ public:
+  explicit FFT(size_t size) { resize(size); }
+  ~FFT() { FFTPlanCache::theCache().release(std::move(_plan)); }
+  FFT(const FFT&) = delete;
+  FFT& operator=(const FFT&) = delete;
+
+  // change the size, allocating memory if needed. Not for use in the audio thread.
+  void resize(size_t size)
+  {
+    assert(size >= 2 && !(size & (size - 1)));
+    if (size == _size) return;
+    FFTPlanCache::theCache().release(std::move(_plan));
+    _plan = FFTPlanCache::theCache().acquire(size);
+    _scratch.resize(size);
+    _size = size;
+  }
+
+  size_t size() const { return _size; }
+
+  // transform size samples of x to the split-complex spectrum y.
+  void forward(const float* x, float* y)
+  {
+    _plan->do_fft(y, x);
+    detail::conjugateSpectrum(y, y, _size);
+  }
+
+  // transform the split-complex spectrum x to size samples of y.
+  void inverse(const float* x, float* y)
+  {
+    detail::conjugateSpectrum(x, _scratch.data(), _size);
+    _plan->do_ifft(_scratch.data(), y);
+    detail::scaleBuffer(y, _size, 1.f / _size);
+  }
+
+  template <size_t ROWS>
+  DSPVectorArray<ROWS> forward(const DSPVectorArray<ROWS>& x)
+  {
+    assert(ROWS * kFloatsPerDSPVector == _size);
+    DSPVectorArray<ROWS> y(kUninitialized);
+    forward(x.getConstBuffer(), y.getBuffer());
+    return y;
+  }
+
+  template <size_t ROWS>
+  DSPVectorArray<ROWS> inverse(const DSPVectorArray<ROWS>& x)
+  {
+    assert(ROWS * kFloatsPerDSPVector == _size);
+    DSPVectorArray<ROWS> y(kUninitialized);
+    inverse(x.getConstBuffer(), y.getBuffer());
+    return y;
+  }
+};
+
+// ----------------------------------------------------------------
+// FixedFFT: a real FFT of size 2^LOG2_SIZE, using ffft's FFTRealFixLen, which
+// has the passes unrolled for its size. Each FixedFFT has its own tables.
+
+template <int LOG2_SIZE>
+class FixedFFT
+{
+ public:
+  static constexpr size_t kSize = size_t(1) << LOG2_SIZE;
+
+ private:
+  ffft::FFTRealFixLen<LOG2_SIZE> _fft;
+  std::vector<float> _scratch = std::vector<float>(kSize);
+
+ public:
+  constexpr size_t size() const { return kSize; }
+
+  void forward(const float* x, float* y)
+  {
+    _fft.do_fft(y, x);
+    detail::conjugateSpectrum(y, y, kSize);
+  }
+
+  void inverse(const float* x, float* y)
+  {
+    detail::conjugateSpectrum(x, _scratch.data(), kSize);
+    _fft.do_ifft(_scratch.data(), y);
+    detail::scaleBuffer(y, kSize, 1.f / kSize);
+  }
+
+  template <size_t ROWS>
+  DSPVectorArray<ROWS> forward(const DSPVectorArray<ROWS>& x)
+  {
+    static_assert(ROWS * kFloatsPerDSPVector == kSize, "FixedFFT: wrong array size");
+    DSPVectorArray<ROWS> y(kUninitialized);
+    forward(x.getConstBuffer(), y.getBuffer());
+    return y;
+  }
+
+  template <size_t ROWS>
+  DSPVectorArray<ROWS> inverse(const DSPVectorArray<ROWS>& x)
+  {
+    static_assert(ROWS * kFloatsPerDSPVector == kSize, "FixedFFT: wrong array size");
+    DSPVectorArray<ROWS> y(kUninitialized);
+    inverse(x.getConstBuffer(), y.getBuffer());
+    return y;
+  }
+};
+
+}  // namespace ml
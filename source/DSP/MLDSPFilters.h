@@ -21,6 +21,7 @@
 #include <vector>
 
 #include "MLDSPOps.h"
+#include "MLDSPRingStorage.h"
 #include "MLDSPScalarMath.h"
 #include <cmath>
 
@@ -35,7 +36,7 @@ template <size_t COEFFS_SIZE>
 DSPVectorArray<COEFFS_SIZE> interpolateCoeffsLinear(const std::array<float, COEFFS_SIZE> c0,
                                                     const std::array<float, COEFFS_SIZE> c1)
 {
-  DSPVectorArray<COEFFS_SIZE> vy;
+  DSPVectorArray<COEFFS_SIZE> vy(kUninitialized);
   for (int i = 0; i < COEFFS_SIZE; ++i)
   {
     vy.row(i) = interpolateDSPVectorLinear(c0[i], c1[i]);
@@ -43,11 +44,84 @@ DSPVectorArray<COEFFS_SIZE> interpolateCoeffsLinear(const std::array<float, COEF
   return vy;
 }
 
+// ParamCache: remembers the parameters a filter last used to make scalar
+// coefficients, so that a filter called again with the same constant
+// parameters can reuse its coefficients. Only constant parameters are kept,
+// as one value each, so that the cache adds little to the size of filters in
+// banks. Parameters that vary over the vector always need new coefficients.
+template <size_t PARAMS>
+class ParamCache
+{
+  std::array<float, PARAMS> _values{};
+  bool _valid{false};
+  bool _constant{false};
+
+ public:
+  // return false if the parameters are constant and the same as the last
+  // constant ones, otherwise true. Constant parameters are stored.
+  template <typename... Args>
+  inline bool changed(const Args&... params)
+  {
+    static_assert(sizeof...(Args) == PARAMS, "ParamCache: wrong number of parameters");
+    _constant = (isConstant(params) && ...);
+    if (!_constant)
+    {
+      _valid = false;
+      return true;
+    }
+    const std::array<float, PARAMS> values{{params[0]...}};
+    if (_valid && (values == _values)) return false;
+    _values = values;
+    _valid = true;
+    return true;
+  }
+
+  // true if each of the parameters given to the last call of changed() was
+  // constant.
+  inline bool constant() const { return _constant; }
+
+  inline void clear() { _valid = false; }
+};
+
 // --------------------------------------------------------------------------------
 // utility filters implemented as SVF variations
 // Thanks to Andrew Simper [www.cytomic.com] for sharing his work over the
 // years.
 
+// get the SVF coefficients g0, g1 and g2 shared by Lopass, Hipass and Bandpass
+// for each sample of omega and k. Since sin(2x) = 2 sin(x) cos(x), one vecSinCos
+// per SIMD vector replaces two calls to sinf per sample.
+inline DSPVectorArray<3> makeSVFCoeffsVec(DSPVector omega, DSPVector k)
+{
+  DSPVectorArray<3> vy(kUninitialized);
+  omega = min(omega, DSPVector(0.5f));
+  k = max(k, DSPVector(0.01f));
+
+  const float* pOmega = omega.getConstBuffer();
+  const float* pK = k.getConstBuffer();
+  float* pG0 = vy.getRowData(0);
+  float* pG1 = vy.getRowData(1);
+  float* pG2 = vy.getRowData(2);
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+  {
+    SIMDVectorFloat s1, c1;
+    vecSinCos(vecMul(vecSet1(kPi), vecLoad(pOmega)), &s1, &c1);
+    SIMDVectorFloat s2 = vecMul(vecSet1(2.0f), vecMul(s1, c1));
+    SIMDVectorFloat vk = vecLoad(pK);
+    SIMDVectorFloat nrm = vecDiv(vecSet1(1.0f), vecFMA(vk, s2, vecSet1(2.0f)));
+    SIMDVectorFloat twoS1Squared = vecMul(vecSet1(2.0f), vecMul(s1, s1));
+    vecStore(pG0, vecMul(s2, nrm));
+    vecStore(pG1, vecMul(vecSub(vecZeros(), vecFMA(vk, s2, twoS1Squared)), nrm));
+    vecStore(pG2, vecMul(twoS1Squared, nrm));
+    pOmega += kFloatsPerSIMDVector;
+    pK += kFloatsPerSIMDVector;
+    pG0 += kFloatsPerSIMDVector;
+    pG1 += kFloatsPerSIMDVector;
+    pG2 += kFloatsPerSIMDVector;
+  }
+  return vy;
+}
+
 struct Lopass
 {
   enum coeffNames
@@ -95,61 +169,62 @@ struct Lopass
   
   static coeffsVec makeCoeffsVec(DSPVector omega, DSPVector k)
   {
-    coeffsVec vy;
-    // TODO SIMD
-    omega = min(omega, DSPVector(0.5f));
-    k = max(k, DSPVector(0.01f));
-    
-    
-    for (int n = 0; n < kFloatsPerDSPVector; ++n)
-    {
-      float piOmega = kPi * omega[n];
-      float s1 = sinf(piOmega);
-      float s2 = sinf(2.0f * piOmega);
-      float nrm = 1.0f / (2.f + k[n] * s2);
-      vy.row(g0)[n] = s2 * nrm;
-      vy.row(g1)[n] = (-2.f * s1 * s1 - k[n] * s2) * nrm;
-      vy.row(g2)[n] = (2.0f * s1 * s1) * nrm;
-    }
-    return vy;
+    return makeSVFCoeffsVec(omega, k);
   }
   
-  // filter the input vector vx with the stored coefficients.
-  inline DSPVector operator()(const DSPVector vx)
+  // filter the input vector vx with the coefficients c.
+  inline DSPVector process(const DSPVector vx, const coeffs& c)
   {
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       float v0 = vx[n];
       float t0 = v0 - ic2eq;
-      float t1 = _coeffs[g0] * t0 + _coeffs[g1] * ic1eq;
-      float t2 = _coeffs[g2] * t0 + _coeffs[g0] * ic1eq;
+      float t1 = fma(c[g1], ic1eq, c[g0] * t0);
+      float t2 = fma(c[g0], ic1eq, c[g2] * t0);
       float v2 = t2 + ic2eq;
-      ic1eq += 2.0f * t1;
-      ic2eq += 2.0f * t2;
+      ic1eq = fma(2.0f, t1, ic1eq);
+      ic2eq = fma(2.0f, t2, ic2eq);
       vy[n] = v2;
     }
     return vy;
   }
-  
+
+  // filter the input vector vx with the stored coefficients.
+  inline DSPVector operator()(const DSPVector vx) { return process(vx, _coeffs); }
+
   // filter the input vector vx with the coefficients generated from parameters omega and k.
+  // With constant omega and k, the coefficients are only recomputed when they change.
   inline DSPVector operator()(const DSPVector vx, const DSPVector omega, const DSPVector k)
   {
-    DSPVector vy;
-    auto vc = makeCoeffsVec(omega, k);
+    if (_paramCache.changed(omega, k) && _paramCache.constant())
+    {
+      _cachedCoeffs = makeCoeffs(ml::min(omega[0], 0.5f), ml::max(k[0], 0.01f));
+    }
+    if (_paramCache.constant())
+    {
+      return process(vx, _cachedCoeffs);
+    }
+
+    DSPVector vy(kUninitialized);
+    const coeffsVec vc = makeCoeffsVec(omega, k);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       float v0 = vx[n];
       float t0 = v0 - ic2eq;
-      float t1 = vc.constRow(g0)[n] * t0 + vc.constRow(g1)[n] * ic1eq;
-      float t2 = vc.constRow(g2)[n] * t0 + vc.constRow(g0)[n] * ic1eq;
+      float t1 = fma(vc.constRow(g1)[n], ic1eq, vc.constRow(g0)[n] * t0);
+      float t2 = fma(vc.constRow(g0)[n], ic1eq, vc.constRow(g2)[n] * t0);
       float v2 = t2 + ic2eq;
-      ic1eq += 2.0f * t1;
-      ic2eq += 2.0f * t2;
+      ic1eq = fma(2.0f, t1, ic1eq);
+      ic2eq = fma(2.0f, t2, ic2eq);
       vy[n] = v2;
     }
     return vy;
   }
+
+ private:
+  ParamCache<2> _paramCache;
+  coeffs _cachedCoeffs{};
 };
 
 
@@ -179,23 +254,60 @@ class Hipass
     return {g0, g1, g2, k};
   }
 
-  inline DSPVector operator()(const DSPVector vx)
+  inline DSPVector process(const DSPVector vx, const _coeffs& c)
+  {
+    DSPVector vy(kUninitialized);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      float v0 = vx[n];
+      float t0 = v0 - ic2eq;
+      float t1 = fma(c.g1, ic1eq, c.g0 * t0);
+      float t2 = fma(c.g0, ic1eq, c.g2 * t0);
+      float v1 = t1 + ic1eq;
+      float v2 = t2 + ic2eq;
+      ic1eq = fma(2.0f, t1, ic1eq);
+      ic2eq = fma(2.0f, t2, ic2eq);
+      vy[n] = fma(-c.k, v1, v0 - v2);
+    }
+    return vy;
+  }
+
+  inline DSPVector operator()(const DSPVector vx) { return process(vx, mCoeffs); }
+
+  // filter the input vector vx with the coefficients generated from parameters omega and k.
+  // With constant omega and k, the coefficients are only recomputed when they change.
+  inline DSPVector operator()(const DSPVector vx, const DSPVector omega, const DSPVector k)
   {
-    DSPVector vy;
+    if (_paramCache.changed(omega, k) && _paramCache.constant())
+    {
+      _cachedCoeffs = coeffs(ml::min(omega[0], 0.5f), ml::max(k[0], 0.01f));
+    }
+    if (_paramCache.constant())
+    {
+      return process(vx, _cachedCoeffs);
+    }
+
+    DSPVector vy(kUninitialized);
+    const DSPVectorArray<3> vc = makeSVFCoeffsVec(omega, k);
+    const DSPVector vNegK = DSPVector(0.f) - max(k, DSPVector(0.01f));
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       float v0 = vx[n];
       float t0 = v0 - ic2eq;
-      float t1 = mCoeffs.g0 * t0 + mCoeffs.g1 * ic1eq;
-      float t2 = mCoeffs.g2 * t0 + mCoeffs.g0 * ic1eq;
+      float t1 = fma(vc.constRow(1)[n], ic1eq, vc.constRow(0)[n] * t0);
+      float t2 = fma(vc.constRow(0)[n], ic1eq, vc.constRow(2)[n] * t0);
       float v1 = t1 + ic1eq;
       float v2 = t2 + ic2eq;
-      ic1eq += 2.0f * t1;
-      ic2eq += 2.0f * t2;
-      vy[n] = v0 - mCoeffs.k * v1 - v2;
+      ic1eq = fma(2.0f, t1, ic1eq);
+      ic2eq = fma(2.0f, t2, ic2eq);
+      vy[n] = fma(vNegK[n], v1, v0 - v2);
     }
     return vy;
   }
+
+ private:
+  ParamCache<2> _paramCache;
+  _coeffs _cachedCoeffs{0};
 };
 
 class Bandpass
@@ -223,22 +335,57 @@ class Bandpass
     return {g0, g1, g2};
   }
 
-  inline DSPVector operator()(const DSPVector vx)
+  inline DSPVector process(const DSPVector vx, const _coeffs& c)
   {
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       float v0 = vx[n];
       float t0 = v0 - ic2eq;
-      float t1 = mCoeffs.g0 * t0 + mCoeffs.g1 * ic1eq;
-      float t2 = mCoeffs.g2 * t0 + mCoeffs.g0 * ic1eq;
+      float t1 = fma(c.g1, ic1eq, c.g0 * t0);
+      float t2 = fma(c.g0, ic1eq, c.g2 * t0);
       float v1 = t1 + ic1eq;
-      ic1eq += 2.0f * t1;
-      ic2eq += 2.0f * t2;
+      ic1eq = fma(2.0f, t1, ic1eq);
+      ic2eq = fma(2.0f, t2, ic2eq);
       vy[n] = v1;
     }
     return vy;
   }
+
+  inline DSPVector operator()(const DSPVector vx) { return process(vx, mCoeffs); }
+
+  // filter the input vector vx with the coefficients generated from parameters omega and k.
+  // With constant omega and k, the coefficients are only recomputed when they change.
+  inline DSPVector operator()(const DSPVector vx, const DSPVector omega, const DSPVector k)
+  {
+    if (_paramCache.changed(omega, k) && _paramCache.constant())
+    {
+      _cachedCoeffs = coeffs(ml::min(omega[0], 0.5f), ml::max(k[0], 0.01f));
+    }
+    if (_paramCache.constant())
+    {
+      return process(vx, _cachedCoeffs);
+    }
+
+    DSPVector vy(kUninitialized);
+    const DSPVectorArray<3> vc = makeSVFCoeffsVec(omega, k);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      float v0 = vx[n];
+      float t0 = v0 - ic2eq;
+      float t1 = fma(vc.constRow(1)[n], ic1eq, vc.constRow(0)[n] * t0);
+      float t2 = fma(vc.constRow(0)[n], ic1eq, vc.constRow(2)[n] * t0);
+      float v1 = t1 + ic1eq;
+      ic1eq = fma(2.0f, t1, ic1eq);
+      ic2eq = fma(2.0f, t2, ic2eq);
+      vy[n] = v1;
+    }
+    return vy;
+  }
+
+ private:
+  ParamCache<2> _paramCache;
+  _coeffs _cachedCoeffs{0};
 };
 
 class LoShelf
@@ -282,30 +429,61 @@ class LoShelf
     return r;
   }
 
+  // get coefficients for each sample of the parameters omega, k and A.
+  static _vcoeffs makeCoeffsVec(DSPVector omega, DSPVector k, DSPVector A)
+  {
+    _vcoeffs r(kUninitialized);
+    DSPVector g = tan(omega * kPi) / sqrt(A);
+    r.row(a1) = 1.f / (1.f + lazy(g) * (lazy(g) + k));
+    r.row(a2) = g * r.constRow(a1);
+    r.row(a3) = g * r.constRow(a2);
+    r.row(m1) = k * (lazy(A) - 1.f);
+    r.row(m2) = lazy(A) * A - 1.f;
+    return r;
+  }
+
   static _vcoeffs vcoeffs(const params p0, const params p1)
   {
     return interpolateCoeffsLinear(coeffs(p0), coeffs(p1));
   }
 
-  inline DSPVector operator()(const DSPVector vx)
+  inline DSPVector process(const DSPVector vx, const _coeffs& c)
   {
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       float v0 = vx[n];
       float v3 = v0 - ic2eq;
-      float v1 = mCoeffs[a1] * ic1eq + mCoeffs[a2] * v3;
-      float v2 = ic2eq + mCoeffs[a2] * ic1eq + mCoeffs[a3] * v3;
+      float v1 = c[a1] * ic1eq + c[a2] * v3;
+      float v2 = ic2eq + c[a2] * ic1eq + c[a3] * v3;
       ic1eq = 2 * v1 - ic1eq;
       ic2eq = 2 * v2 - ic2eq;
-      vy[n] = v0 + mCoeffs[m1] * v1 + mCoeffs[m2] * v2;
+      vy[n] = v0 + c[m1] * v1 + c[m2] * v2;
     }
     return vy;
   }
 
-  inline DSPVector operator()(const DSPVector vx, const _vcoeffs vc)
+  inline DSPVector operator()(const DSPVector vx) { return process(vx, mCoeffs); }
+
+  // filter the input vector vx with the coefficients generated from parameters omega, k and A.
+  // With constant parameters, the coefficients are only recomputed when they change.
+  inline DSPVector operator()(const DSPVector vx, const DSPVector vOmega, const DSPVector vK,
+                              const DSPVector vA)
   {
-    DSPVector vy;
+    if (_paramCache.changed(vOmega, vK, vA) && _paramCache.constant())
+    {
+      _cachedCoeffs = coeffs({vOmega[0], vK[0], vA[0]});
+    }
+    if (_paramCache.constant())
+    {
+      return process(vx, _cachedCoeffs);
+    }
+    return operator()(vx, makeCoeffsVec(vOmega, vK, vA));
+  }
+
+  inline DSPVector operator()(const DSPVector vx, const _vcoeffs& vc)
+  {
+    DSPVector vy(kUninitialized);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       float v0 = vx[n];
@@ -318,6 +496,10 @@ class LoShelf
     }
     return vy;
   }
+
+ private:
+  ParamCache<PARAMS_SIZE> _paramCache;
+  _coeffs _cachedCoeffs{};
 };
 
 class HiShelf
@@ -363,30 +545,62 @@ class HiShelf
     return r;
   }
 
+  // get coefficients for each sample of the parameters omega, k and A.
+  static _vcoeffs makeCoeffsVec(DSPVector omega, DSPVector k, DSPVector A)
+  {
+    _vcoeffs r(kUninitialized);
+    DSPVector g = tan(omega * kPi) * sqrt(A);
+    r.row(a1) = 1.f / (1.f + lazy(g) * (lazy(g) + k));
+    r.row(a2) = g * r.constRow(a1);
+    r.row(a3) = g * r.constRow(a2);
+    r.row(m0) = A * A;
+    r.row(m1) = k * (1.f - lazy(A)) * A;
+    r.row(m2) = 1.f - lazy(A) * A;
+    return r;
+  }
+
   static _vcoeffs vcoeffs(const params p0, const params p1)
   {
     return interpolateCoeffsLinear(coeffs(p0), coeffs(p1));
   }
 
-  inline DSPVector operator()(const DSPVector vx)
+  inline DSPVector process(const DSPVector vx, const _coeffs& c)
   {
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       float v0 = vx[n];
       float v3 = v0 - ic2eq;
-      float v1 = mCoeffs[a1] * ic1eq + mCoeffs[a2] * v3;
-      float v2 = ic2eq + mCoeffs[a2] * ic1eq + mCoeffs[a3] * v3;
+      float v1 = c[a1] * ic1eq + c[a2] * v3;
+      float v2 = ic2eq + c[a2] * ic1eq + c[a3] * v3;
       ic1eq = 2 * v1 - ic1eq;
       ic2eq = 2 * v2 - ic2eq;
-      vy[n] = mCoeffs[m0] * v0 + mCoeffs[m1] * v1 + mCoeffs[m2] * v2;
+      vy[n] = c[m0] * v0 + c[m1] * v1 + c[m2] * v2;
     }
     return vy;
   }
 
-  inline DSPVector operator()(const DSPVector vx, const _vcoeffs vc)
+  inline DSPVector operator()(const DSPVector vx) { return process(vx, mCoeffs); }
+
+  // filter the input vector vx with the coefficients generated from parameters omega, k and A.
+  // With constant parameters, the coefficients are only recomputed when they change.
+  inline DSPVector operator()(const DSPVector vx, const DSPVector vOmega, const DSPVector vK,
+                              const DSPVector vA)
   {
-    DSPVector vy;
+    if (_paramCache.changed(vOmega, vK, vA) && _paramCache.constant())
+    {
+      _cachedCoeffs = coeffs({vOmega[0], vK[0], vA[0]});
+    }
+    if (_paramCache.constant())
+    {
+      return process(vx, _cachedCoeffs);
+    }
+    return operator()(vx, makeCoeffsVec(vOmega, vK, vA));
+  }
+
+  inline DSPVector operator()(const DSPVector vx, const _vcoeffs& vc)
+  {
+    DSPVector vy(kUninitialized);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       float v0 = vx[n];
@@ -399,6 +613,10 @@ class HiShelf
     }
     return vy;
   }
+
+ private:
+  ParamCache<PARAMS_SIZE> _paramCache;
+  _coeffs _cachedCoeffs{};
 };
 
 class Bell
@@ -426,21 +644,74 @@ class Bell
     return {a1, a2, a3, m1};
   }
 
-  inline DSPVector operator()(const DSPVector vx)
+  // get coefficients a1, a2, a3 and m1 on rows 0-3 for each sample of the
+  // parameters omega, k and A.
+  static DSPVectorArray<4> makeCoeffsVec(DSPVector omega, DSPVector k, DSPVector A)
+  {
+    DSPVectorArray<4> r(kUninitialized);
+    DSPVector kc = k / A;
+    DSPVector g = tan(omega * kPi);
+    r.row(0) = 1.f / (1.f + lazy(g) * (lazy(g) + kc));
+    r.row(1) = g * r.constRow(0);
+    r.row(2) = g * r.constRow(1);
+    r.row(3) = kc * (lazy(A) * A - 1.f);
+    return r;
+  }
+
+  inline DSPVector process(const DSPVector vx, const _coeffs& c)
   {
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       float v0 = vx[n];
       float v3 = v0 - ic2eq;
-      float v1 = mCoeffs.a1 * ic1eq + mCoeffs.a2 * v3;
-      float v2 = ic2eq + mCoeffs.a2 * ic1eq + mCoeffs.a3 * v3;
+      float v1 = c.a1 * ic1eq + c.a2 * v3;
+      float v2 = ic2eq + c.a2 * ic1eq + c.a3 * v3;
       ic1eq = 2 * v1 - ic1eq;
       ic2eq = 2 * v2 - ic2eq;
-      vy[n] = v0 + mCoeffs.m1 * v1;
+      vy[n] = v0 + c.m1 * v1;
     }
     return vy;
   }
+
+  inline DSPVector operator()(const DSPVector vx) { return process(vx, mCoeffs); }
+
+  // filter the input vector vx with the coefficients generated from parameters omega, k and A.
+  // With constant parameters, the coefficients are only recomputed when they change.
+  inline DSPVector operator()(const DSPVector vx, const DSPVector omega, const DSPVector k,
+                              const DSPVector A)
+  {
+    if (_paramCache.changed(omega, k, A) && _paramCache.constant())
+    {
+      _cachedCoeffs = coeffs(omega[0], k[0], A[0]);
+    }
+    if (_paramCache.constant())
+    {
+      return process(vx, _cachedCoeffs);
+    }
+    return operator()(vx, makeCoeffsVec(omega, k, A));
+  }
+
+  // filter the input vector vx with coefficients from makeCoeffsVec().
+  inline DSPVector operator()(const DSPVector vx, const DSPVectorArray<4>& vc)
+  {
+    DSPVector vy(kUninitialized);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      float v0 = vx[n];
+      float v3 = v0 - ic2eq;
+      float v1 = vc.constRow(0)[n] * ic1eq + vc.constRow(1)[n] * v3;
+      float v2 = ic2eq + vc.constRow(1)[n] * ic1eq + vc.constRow(2)[n] * v3;
+      ic1eq = 2 * v1 - ic1eq;
+      ic2eq = 2 * v2 - ic2eq;
+      vy[n] = v0 + vc.constRow(3)[n] * v1;
+    }
+    return vy;
+  }
+
+ private:
+  ParamCache<3> _paramCache;
+  _coeffs _cachedCoeffs{0};
 };
 
 // A one pole filter. see https://ccrma.stanford.edu/~jos/fp/One_Pole.html
@@ -467,10 +738,11 @@ struct OnePole
 
   inline DSPVector operator()(const DSPVector vx)
   {
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
-      y1 = mCoeffs.a0 * vx[n] + mCoeffs.b1 * y1;
+      // keep the product with the input off the feedback path.
+      y1 = fma(mCoeffs.b1, y1, mCoeffs.a0 * vx[n]);
       vy[n] = y1;
     }
     return vy;
@@ -502,7 +774,7 @@ class DCBlocker
 
   inline DSPVector operator()(const DSPVector vx)
   {
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       const float x0 = vx[n];
@@ -515,6 +787,37 @@ class DCBlocker
   }
 };
 
+// PinkFilter: turns white noise into pink noise, with a slope of -3dB per octave
+// over most of the audio range. This is Paul Kellet's "economy" filter: three
+// one-pole lowpasses in parallel plus some of the input, within 0.5dB of the
+// ideal slope above 10Hz at 44.1kHz. kGain brings the output level close to
+// the input level.
+
+class PinkFilter
+{
+  float b0{0}, b1{0}, b2{0};
+
+ public:
+  static constexpr float kPole0{0.99765f}, kPole1{0.96300f}, kPole2{0.57000f};
+  static constexpr float kIn0{0.0990460f}, kIn1{0.2965164f}, kIn2{1.0526913f};
+  static constexpr float kDirect{0.1848f};
+  static constexpr float kGain{0.3376f};
+
+  inline DSPVector operator()(const DSPVector vx)
+  {
+    DSPVector vy(kUninitialized);
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      const float x = vx[n] * kGain;
+      b0 = fma(kPole0, b0, kIn0 * x);
+      b1 = fma(kPole1, b1, kIn1 * x);
+      b2 = fma(kPole2, b2, kIn2 * x);
+      vy[n] = fma(kDirect, x, b0 + b1 + b2);
+    }
+    return vy;
+  }
+};
+
 // Differentiator
 
 class Differentiator
@@ -524,7 +827,7 @@ class Differentiator
  public:
   inline DSPVector operator()(const DSPVector vx)
   {
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
     vy[0] = vx[0] - _x1;
 
     // TODO SIMD
@@ -549,7 +852,16 @@ class Integrator
 
   inline DSPVector operator()(const DSPVector vx)
   {
-    DSPVector vy;
+    // without leak, the output is a running sum. Leaky integrators can be run
+    // with SIMD using BlockIIR<Integrator>.
+    if (mLeak == 0.f)
+    {
+      DSPVector vy = inclusiveScan(vx, y1);
+      y1 = vy[kFloatsPerDSPVector - 1];
+      return vy;
+    }
+
+    DSPVector vy(kUninitialized);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       y1 -= y1 * mLeak;
@@ -586,7 +898,7 @@ class Peak
 
   inline DSPVector operator()(const DSPVector vx)
   {
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
     DSPVector vxSquared = vx * vx;
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
@@ -641,7 +953,7 @@ class RMS
 
   inline DSPVector operator()(const DSPVector vx)
   {
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
     DSPVector vxSquared = vx * vx;
 
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
@@ -790,7 +1102,7 @@ struct ADSR
   
   inline DSPVector operator()(const DSPVector vx)
   {
-    DSPVector r;
+    DSPVector r(kUninitialized);
     for(int i=0; i<kFloatsPerDSPVector; ++i)
     {
       r[i] = processSample(vx[i]);
@@ -800,11 +1112,12 @@ struct ADSR
 };
 
 
-// IntegerDelay delays a signal a whole number of samples.
+// IntegerDelay delays a signal a whole number of samples. The buffer is a
+// RingStorage, so each DSPVector is written and read with a single copy.
 
 class IntegerDelay
 {
-  std::vector<float> mBuffer;
+  RingStorage mBuffer;
   int mIntDelayInSamples{0};
   uintptr_t mWriteIndex{0};
   uintptr_t mLengthMask{0};
@@ -832,51 +1145,25 @@ class IntegerDelay
   void setMaxDelayInSamples(float d)
   {
     int dMax = static_cast<int>(floorf(d));
-    int newSize = 1 << bitsToContain(dMax + kFloatsPerDSPVector);
-    mBuffer.resize(max(1, newSize));
-    mLengthMask = newSize - 1;
+    mBuffer.resize(std::max(dMax, 0) + kFloatsPerDSPVector, kFloatsPerDSPVector);
+    mLengthMask = mBuffer.mask();
     mWriteIndex = 0;
-    clear();
   }
 
-  inline void clear() { std::fill(mBuffer.begin(), mBuffer.end(), 0.f); }
+  inline void clear() { mBuffer.clear(); }
 
   inline DSPVector operator()(const DSPVector vx)
   {
     // write
-    uintptr_t writeEnd = mWriteIndex + kFloatsPerDSPVector;
-    if (writeEnd <= mLengthMask + 1)
-    {
-      const float* srcStart = vx.getConstBuffer();
-      std::copy(srcStart, srcStart + kFloatsPerDSPVector, mBuffer.data() + mWriteIndex);
-    }
-    else
-    {
-      uintptr_t excess = writeEnd - mLengthMask - 1;
-      const float* srcStart = vx.getConstBuffer();
-      const float* srcSplice = srcStart + kFloatsPerDSPVector - excess;
-      const float* srcEnd = srcStart + kFloatsPerDSPVector;
-      std::copy(srcStart, srcSplice, mBuffer.data() + mWriteIndex);
-      std::copy(srcSplice, srcEnd, mBuffer.data());
-    }
+    float* pBuffer = mBuffer.data();
+    const float* srcStart = vx.getConstBuffer();
+    std::copy(srcStart, srcStart + kFloatsPerDSPVector, pBuffer + mWriteIndex);
+    mBuffer.commitWrite(mWriteIndex, kFloatsPerDSPVector);
 
     // read
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
     uintptr_t readStart = (mWriteIndex - mIntDelayInSamples) & mLengthMask;
-    uintptr_t readEnd = readStart + kFloatsPerDSPVector;
-    float* srcBuf = mBuffer.data();
-    if (readEnd <= mLengthMask + 1)
-    {
-      std::copy(srcBuf + readStart, srcBuf + readEnd, vy.getBuffer());
-    }
-    else
-    {
-      uintptr_t excess = readEnd - mLengthMask - 1;
-      uintptr_t readSplice = readStart + kFloatsPerDSPVector - excess;
-      float* pDest = vy.getBuffer();
-      std::copy(srcBuf + readStart, srcBuf + readSplice, pDest);
-      std::copy(srcBuf, srcBuf + excess, pDest + (kFloatsPerDSPVector - excess));
-    }
+    std::copy(pBuffer + readStart, pBuffer + readStart + kFloatsPerDSPVector, vy.getBuffer());
 
     // update index
     mWriteIndex += kFloatsPerDSPVector;
@@ -886,22 +1173,23 @@ class IntegerDelay
 
   inline DSPVector operator()(const DSPVector x, const DSPVector delay)
   {
-    DSPVector y;
+    DSPVector y(kUninitialized);
 
+    // write
+    float* pBuffer = mBuffer.data();
+    const uintptr_t writeStart = mWriteIndex;
+    std::copy(x.getConstBuffer(), x.getConstBuffer() + kFloatsPerDSPVector, pBuffer + writeStart);
+    mBuffer.commitWrite(writeStart, kFloatsPerDSPVector);
+
+    // read
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
-      // write
-      mBuffer[mWriteIndex] = x[n];
-
-      // read
       mIntDelayInSamples = static_cast<int>(delay[n]);
-      uintptr_t readIndex = (mWriteIndex - mIntDelayInSamples) & mLengthMask;
-
-      y[n] = mBuffer[readIndex];
-      mWriteIndex++;
-      mWriteIndex &= mLengthMask;
+      uintptr_t readIndex = (writeStart + n - mIntDelayInSamples) & mLengthMask;
+      y[n] = pBuffer[readIndex];
     }
 
+    mWriteIndex = (writeStart + kFloatsPerDSPVector) & mLengthMask;
     return y;
   }
 
@@ -910,11 +1198,12 @@ class IntegerDelay
     // write
     // note that, for performance, there is no bounds checking. If you crash
     // here, you probably didn't allocate enough delay memory.
-    mBuffer[mWriteIndex] = x;
+    mBuffer.data()[mWriteIndex] = x;
+    mBuffer.commitWrite(mWriteIndex, 1);
 
     // read
     uintptr_t readIndex = (mWriteIndex - mIntDelayInSamples) & mLengthMask;
-    float y = mBuffer[readIndex];
+    float y = mBuffer.data()[readIndex];
 
     // update index
     mWriteIndex++;
@@ -964,7 +1253,7 @@ class Allpass1
 
   inline DSPVector operator()(const DSPVector vx)
   {
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       vy[n] = processSample(vx[n]);
@@ -1025,7 +1314,7 @@ class FractionalDelay
   // return the input signal, delayed by the varying delay time vDelayInSamples.
   inline DSPVector operator()(const DSPVector vx, const DSPVector vDelayInSamples)
   {
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       setDelayInSamples(vDelayInSamples[n]);
@@ -1039,7 +1328,7 @@ class FractionalDelay
   inline DSPVector operator()(const DSPVector vx, const DSPVector vDelayInSamples,
                               const DSPVectorInt vChangeTicks)
   {
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
       if (vChangeTicks[n] != 0 || mIntegerDelay.size() == 0)
@@ -1060,8 +1349,11 @@ class FractionalDelay
 namespace PitchbendableDelayConsts
 {
 // period in samples of allpass fade cycle. must be a power of 2 less than or
-// equal to kFloatsPerDSPVector. 32 sounds good.
-constexpr int kFadePeriod{32};
+// equal to kFloatsPerDSPVector, so that the fade and change ticks repeat
+// exactly in every DSPVector. 32 sounds good.
+constexpr int kFadePeriod{kFloatsPerDSPVector < 32 ? int(kFloatsPerDSPVector) : 32};
+static_assert(kFloatsPerDSPVector % kFadePeriod == 0,
+              "kFadePeriod must divide the DSP vector size.");
 constexpr int fadeRamp(int n) { return n % kFadePeriod; }
 constexpr int ticks1(int n) { return fadeRamp(n) == kFadePeriod / 2; }
 constexpr int ticks2(int n) { return fadeRamp(n) == 0; }
@@ -1115,6 +1407,335 @@ class PitchbendableDelay
   }
 };
 
+// ModulatedDelay
+// A delay line for delay times that change every sample, as in chorus, flanger
+// and vibrato. Each DSPVector of input is written to the buffer first. Then the
+// output is read one SIMD vector at a time, gathering the samples around each
+// delayed time and interpolating between them. INTERPOLATION selects the
+// quality, from cheapest to best:
+//   kLinearInterpolation: 2 samples.
+//   kCubicInterpolation: 4 samples, with a Hermite (Catmull-Rom) cubic.
+//   kSincInterpolation: 8 samples, with a Blackman-windowed sinc from a table.
+// The delay in samples is clamped to [kTaps / 2 - 1, maxDelay]. Because the
+// input is written before reading, delays shorter than a DSPVector are allowed.
+//
+// write() and read() can also be called separately, to read any number of
+// delayed copies of each vector written. A constant delay is read with
+// contiguous loads instead of gathers.
+
+enum DelayInterpolation
+{
+  kLinearInterpolation,
+  kCubicInterpolation,
+  kSincInterpolation
+};
+
+template <int INTERPOLATION = kCubicInterpolation>
+class ModulatedDelay
+{
+ public:
+  static constexpr int kTaps =
+      (INTERPOLATION == kLinearInterpolation) ? 2 : (INTERPOLATION == kCubicInterpolation) ? 4 : 8;
+  static constexpr float kMinDelay = kTaps / 2 - 1;
+
+  ModulatedDelay() = default;
+  ModulatedDelay(float maxDelay) { setMaxDelayInSamples(maxDelay); }
+
+  void setMaxDelayInSamples(float d)
+  {
+    _maxDelay = std::max(d, float(kMinDelay));
+
+    // the samples under any write of a DSPVector or read of a SIMD vector are
+    // contiguous.
+    _buffer.resize(int(_maxDelay) + kTaps + kFloatsPerDSPVector,
+                   std::max(kFloatsPerDSPVector, size_t(kTaps + kFloatsPerSIMDVector)));
+    _mask = _buffer.mask();
+    _writeIndex = 0;
+    _readIndex = 0;
+
+    // make the shared sinc table now, rather than in the first read.
+    if (INTERPOLATION == kSincInterpolation) getSincTable();
+  }
+
+  float getMaxDelayInSamples() const { return _maxDelay; }
+
+  inline void clear() { _buffer.clear(); }
+
+  // write a vector of input, to be read by the following calls to read().
+  inline void write(const DSPVector vx)
+  {
+    if (_buffer.size() == 0) setMaxDelayInSamples(0.f);
+    const float* px = vx.getConstBuffer();
+    std::copy(px, px + kFloatsPerDSPVector, _buffer.data() + _writeIndex);
+    _buffer.commitWrite(_writeIndex, kFloatsPerDSPVector);
+    _readIndex = _writeIndex;
+    _writeIndex = (_writeIndex + kFloatsPerDSPVector) & _mask;
+  }
+
+  // read the last vector written, delayed by the varying delay time vDelayInSamples.
+  inline DSPVector read(const DSPVector vDelayInSamples) const
+  {
+    const float* pBuffer = _buffer.data();
+    const float* pDelay = vDelayInSamples.getConstBuffer();
+    const SIMDVectorFloat vMin = vecSet1(kMinDelay);
+    const SIMDVectorFloat vMax = vecSet1(_maxDelay);
+    const SIMDVectorFloat vOne = vecSet1(1.f);
+    const SIMDVectorInt vMask = vecSetInt1(uint32_t(_mask));
+    const SIMDVectorInt vLanes = vecFloatToIntTruncate(vecLoad(columnIndex().getConstBuffer()));
+
+    DSPVector vy(kUninitialized);
+    float* py = vy.getBuffer();
+    for (int n = 0; n < kFloatsPerDSPVector; n += kFloatsPerSIMDVector)
+    {
+      // the delayed time of each lane is t samples past the sample at start +
+      // kTaps / 2 - 1.
+      const SIMDVectorFloat d = vecClamp(vecLoad(pDelay + n), vMin, vMax);
+      const SIMDVectorInt di = vecFloatToIntTruncate(d);
+      const SIMDVectorFloat t = vecSub(vOne, vecSub(d, vecIntToFloat(di)));
+      const uint32_t first = uint32_t(_readIndex + n - kTaps / 2);
+      const SIMDVectorInt start =
+          vecAndInt(vecSubInt(vecAddInt(vecSetInt1(first), vLanes), di), vMask);
+
+      auto x = [&](int j) { return vecGather(pBuffer, vecAddInt(start, vecSetInt1(j))); };
+      if (INTERPOLATION != kSincInterpolation)
+      {
+        auto noTaps = [](int) { return vecSet1(0.f); };
+        vecStore(py + n, interpolate(x, noTaps, t));
+      }
+      else if (kFloatsPerSIMDVector <= kTaps)
+      {
+        vecStore(py + n, interpolateSincByLane(pBuffer, start, t));
+      }
+      else
+      {
+        // look up the sinc taps for t, interpolating between phases.
+        const SincTable& table = getSincTable();
+        const SIMDVectorFloat phase = vecMul(t, vecSet1(float(kSincPhases)));
+        const SIMDVectorInt pi = vecFloatToIntTruncate(phase);
+        const SIMDVectorFloat pf = vecSub(phase, vecIntToFloat(pi));
+        const SIMDVectorInt row = vecMulInt(pi, vecSetInt1(kTaps));
+        auto h = [&](int j) {
+          const SIMDVectorInt k = vecAddInt(row, vecSetInt1(j));
+          return vecFMA(pf, vecGather(table.deltas.data(), k), vecGather(table.taps.data(), k));
+        };
+        vecStore(py + n, interpolate(x, h, t));
+      }
+    }
+    return vy;
+  }
+
+  // read the last vector written, delayed by the constant delay time delayInSamples.
+  inline DSPVector read(float delayInSamples) const
+  {
+    const float d = std::min(std::max(delayInSamples, float(kMinDelay)), _maxDelay);
+    const int di = int(d);
+    const float t = 1.f - (d - di);
+    const SIMDVectorFloat vt = vecSet1(t);
+
+    // the sinc taps for t.
+    float taps[kTaps]{};
+    if (INTERPOLATION == kSincInterpolation)
+    {
+      const SincTable& table = getSincTable();
+      const float phase = t * kSincPhases;
+      const int row = int(phase);
+      for (int j = 0; j < kTaps; ++j)
+      {
+        const int k = row * kTaps + j;
+        taps[j] = table.taps[k] + (phase - row) * table.deltas[k];
+      }
+    }
+
+    DSPVector vy(kUninitialized);
+    float* py = vy.getBuffer();
+    if (t == 1.f)
+    {
+      // every kind of interpolation gives the sample at a whole number delay.
+      const float* px = _buffer.data() + ((_readIndex - di) & _mask);
+      std::copy(px, px + kFloatsPerDSPVector, py);
+      return vy;
+    }
+    for (int n = 0; n < kFloatsPerDSPVector; n += kFloatsPerSIMDVector)
+    {
+      const float* px = _buffer.data() + ((_readIndex + n - di - kTaps / 2) & _mask);
+      auto x = [&](int j) { return vecLoadUnaligned(px + j); };
+      auto h = [&](int j) { return vecSet1(taps[j]); };
+      vecStore(py + n, interpolate(x, h, vt));
+    }
+    return vy;
+  }
+
+  // write the input, and return it delayed by the varying delay time vDelayInSamples.
+  inline DSPVector operator()(const DSPVector vx, const DSPVector vDelayInSamples)
+  {
+    write(vx);
+    return read(vDelayInSamples);
+  }
+
+ private:
+  RingStorage _buffer;
+  size_t _mask{0};
+  size_t _writeIndex{0};
+  size_t _readIndex{0};
+  float _maxDelay{0.f};
+
+  // the sinc table has kSincPhases + 1 rows of kTaps taps, for fractions t from
+  // 0 to 1, and the difference between each row and the next.
+  static constexpr int kSincPhases = 256;
+  struct SincTable
+  {
+    std::vector<float> taps;
+    std::vector<float> deltas;
+    SincTable() : taps((kSincPhases + 1) * kTaps), deltas((kSincPhases + 1) * kTaps)
+    {
+      const double halfWidth = kTaps / 2;
+      for (int p = 0; p <= kSincPhases; ++p)
+      {
+        double sum{0};
+        std::vector<double> row(kTaps);
+        for (int j = 0; j < kTaps; ++j)
+        {
+          // tap j is u samples before the delayed time.
+          const double u = double(p) / kSincPhases + halfWidth - 1 - j;
+          const double x = kPi * u;
+          const double sinc = (std::fabs(x) < 1e-9) ? 1.0 : std::sin(x) / x;
+          const double w = kPi * u / halfWidth;
+          const double window = 0.42 + 0.5 * std::cos(w) + 0.08 * std::cos(2 * w);
+          row[j] = sinc * window;
+          sum += row[j];
+        }
+        for (int j = 0; j < kTaps; ++j)
+        {
+          taps[p * kTaps + j] = float(row[j] / sum);
+        }
+      }
+      for (int i = 0; i < kSincPhases * kTaps; ++i)
+      {
+        deltas[i] = taps[i + kTaps] - taps[i];
+      }
+    }
+  };
+
+  static const SincTable& getSincTable()
+  {
+    static const SincTable table;
+    return table;
+  }
+
+  // interpolate at the fraction t between the samples x(0) to x(kTaps - 1),
+  // using the sinc taps h(0) to h(kTaps - 1) if needed.
+  template <typename SAMPLE_FN, typename TAP_FN>
+  static inline SIMDVectorFloat interpolate(SAMPLE_FN x, TAP_FN h, SIMDVectorFloat t)
+  {
+    switch (INTERPOLATION)
+    {
+      case kLinearInterpolation:
+      {
+        const SIMDVectorFloat x0 = x(0);
+        return vecFMA(t, vecSub(x(1), x0), x0);
+      }
+      case kCubicInterpolation:
+      {
+        const SIMDVectorFloat xm1 = x(0);
+        const SIMDVectorFloat x0 = x(1);
+        const SIMDVectorFloat x1 = x(2);
+        const SIMDVectorFloat x2 = x(3);
+        const SIMDVectorFloat c1 = vecMul(vecSet1(0.5f), vecSub(x1, xm1));
+        const SIMDVectorFloat c2 =
+            vecAdd(vecSub(xm1, vecMul(vecSet1(2.5f), x0)),
+                   vecSub(vecAdd(x1, x1), vecMul(vecSet1(0.5f), x2)));
+        const SIMDVectorFloat c3 = vecFMA(vecSet1(0.5f), vecSub(x2, xm1),
+                                          vecMul(vecSet1(1.5f), vecSub(x0, x1)));
+        return vecFMA(vecFMA(vecFMA(c3, t, c2), t, c1), t, x0);
+      }
+      default:
+      {
+        SIMDVectorFloat sum = vecSet1(0.f);
+        for (int j = 0; j < kTaps; ++j)
+        {
+          sum = vecFMA(h(j), x(j), sum);
+        }
+        return sum;
+      }
+    }
+  }
+
+  // when a SIMD vector is no wider than the taps, the sinc is faster computed
+  // one lane at a time, with the samples and taps of each lane loaded together.
+  static inline SIMDVectorFloat interpolateSincByLane(const float* p, SIMDVectorInt start,
+                                                      SIMDVectorFloat t)
+  {
+    const SincTable& table = getSincTable();
+    SIMDVectorIntUnion starts;
+    starts.v = start;
+    SIMDVectorFloatUnion phases, y;
+    phases.v = vecMul(t, vecSet1(float(kSincPhases)));
+    for (int i = 0; i < kFloatsPerSIMDVector; ++i)
+    {
+      const int row = int(phases.f[i]);
+      const SIMDVectorFloat pf = vecSet1(phases.f[i] - row);
+      const float* pTaps = table.taps.data() + row * kTaps;
+      const float* pDeltas = table.deltas.data() + row * kTaps;
+      const float* px = p + starts.i[i];
+      SIMDVectorFloat sum = vecSet1(0.f);
+      for (int j = 0; j < kTaps; j += kFloatsPerSIMDVector)
+      {
+        const SIMDVectorFloat h =
+            vecFMA(pf, vecLoadUnaligned(pDeltas + j), vecLoadUnaligned(pTaps + j));
+        sum = vecFMA(h, vecLoadUnaligned(px + j), sum);
+      }
+      y.f[i] = vecSumH(sum);
+    }
+    return y.v;
+  }
+};
+
+// MultiTapDelay
+// Reads TAPS delayed copies of one signal from a single buffer, written once per
+// DSPVector. The delay of each tap can be constant, set with setDelaysInSamples,
+// or vary every sample. Each row of the output is one tap.
+
+template <size_t TAPS, int INTERPOLATION = kLinearInterpolation>
+class MultiTapDelay
+{
+  ModulatedDelay<INTERPOLATION> _delay;
+  std::array<float, TAPS> _delays{};
+
+ public:
+  MultiTapDelay() = default;
+  MultiTapDelay(float maxDelay) { setMaxDelayInSamples(maxDelay); }
+
+  void setMaxDelayInSamples(float d) { _delay.setMaxDelayInSamples(d); }
+  void setDelaysInSamples(std::array<float, TAPS> delays) { _delays = delays; }
+  inline void clear() { _delay.clear(); }
+
+  // return the input delayed by the constant delay time of each tap.
+  inline DSPVectorArray<TAPS> operator()(const DSPVector vx)
+  {
+    _delay.write(vx);
+    DSPVectorArray<TAPS> vy(kUninitialized);
+    for (int j = 0; j < int(TAPS); ++j)
+    {
+      vy.row(j) = _delay.read(_delays[j]);
+    }
+    return vy;
+  }
+
+  // return the input delayed by the varying delay time of each tap, in the
+  // corresponding row of vDelaysInSamples.
+  inline DSPVectorArray<TAPS> operator()(const DSPVector vx,
+                                         const DSPVectorArray<TAPS>& vDelaysInSamples)
+  {
+    _delay.write(vx);
+    DSPVectorArray<TAPS> vy(kUninitialized);
+    for (int j = 0; j < int(TAPS); ++j)
+    {
+      vy.row(j) = _delay.read(vDelaysInSamples.constRow(j));
+    }
+    return vy;
+  }
+};
+
 // General purpose allpass filter with arbitrary delay length.
 // For efficiency, the minimum delay time is one DSPVector.
 
@@ -1146,8 +1767,8 @@ class Allpass
   inline DSPVector operator()(const DSPVector vInput)
   {
     DSPVector vGain(-mGain);
-    DSPVector vDelayInput = vInput - vy1 * vGain;
-    DSPVector y = vDelayInput * vGain + vy1;
+    DSPVector vDelayInput = vInput - lazy(vy1) * vGain;
+    DSPVector y = lazy(vDelayInput) * vGain + vy1;
     vy1 = mDelay(vDelayInput);
     return y;
   }
@@ -1157,8 +1778,8 @@ class Allpass
   inline DSPVector operator()(const DSPVector vInput, const DSPVector vDelayInSamples)
   {
     DSPVector vGain(-mGain);
-    DSPVector vDelayInput = vInput - vy1 * vGain;
-    DSPVector y = vDelayInput * vGain + vy1;
+    DSPVector vDelayInput = vInput - lazy(vy1) * vGain;
+    DSPVector y = lazy(vDelayInput) * vGain + vy1;
     vy1 = mDelay(vDelayInput, vDelayInSamples - DSPVector(kFloatsPerDSPVector));
     return y;
   }
@@ -1166,8 +1787,8 @@ class Allpass
 
 // FDN
 // A general Feedback Delay Network with N delay lines connected in an NxN
-// matrix.
-// TODO DELAY_TYPE parameter for modulation?
+// matrix. For modulated delays, more lines or more outputs, see ModulatedFDN
+// in MLDSPFunctional.h.
 
 template <int SIZE>
 class FDN
@@ -1201,7 +1822,6 @@ class FDN
   }
 
   // stereo output function
-  // TODO generalize n-channel output function somehow
   DSPVectorArray<2> operator()(const DSPVector x)
   {
     // run delays, getting DSPVector for each delay
@@ -1248,111 +1868,391 @@ class FDN
   }
 };
 
-// Half Band Filter
-// Polyphase allpass filter used to upsample or downsample a signal by 2x.
-// Structure due to fred harris, A. G. Constantinides and Valenzuela.
+// HalfBandFilterArray
+// Polyphase allpass filters used to upsample or downsample CHANNELS signals by
+// 2x. Structure due to fred harris, A. G. Constantinides and Valenzuela.
+// Each channel has two branches, each a cascade of two first order allpasses.
+// The branches of all the channels run together in SIMD lanes, the two branches
+// of channel c in lanes 2c and 2c + 1, so each sample step advances every
+// branch of kFloatsPerSIMDVector / 2 channels at once.
 
-class HalfBandFilter
+template <size_t CHANNELS>
+class HalfBandFilterArray
 {
+  static constexpr int kLanes = kFloatsPerSIMDVector;
+  static constexpr int kGroups = std::max(int(CHANNELS * 2 + kLanes - 1) / kLanes, 1);
+  static constexpr int kWidth = kGroups * kLanes;
+  static constexpr int kSteps = kFloatsPerDSPVector / 2;
+
+  // order=4, rejection=70dB, transition band=0.1.
+  static constexpr float kA0{0.07986642623635751f}, kA1{0.5453536510711322f};
+  static constexpr float kB0{0.28382934487410993f}, kB1{0.8344118914807379f};
+
  public:
-  inline DSPVector upsampleFirstHalf(const DSPVector vx)
+  // the group delay at low frequencies, in samples at the higher rate. Each
+  // allpass delays low frequencies by (1 - c) / (1 + c) samples at the lower
+  // rate, and the second branch is one sample later at the higher rate. The
+  // output is the average of the two branches.
+  static constexpr float kGroupDelay = (1.f - kA0) / (1.f + kA0) + (1.f - kA1) / (1.f + kA1) +
+                                       (1.f - kB0) / (1.f + kB0) + (1.f - kB1) / (1.f + kB1) +
+                                       0.5f;
+
+ private:
+  // coefficients of each allpass and their negatives, and for each lane the
+  // previous input and outputs of the two allpasses.
+  enum { x1, y1a, y1b, nState };
+  SIMDVectorFloat _c0[kGroups], _c1[kGroups], _negC0[kGroups], _negC1[kGroups];
+  SIMDVectorFloat _state[kGroups][nState]{};
+
+  // the output of the second branch one step back, for downsampling.
+  float _b1[CHANNELS > 0 ? CHANNELS : 1]{};
+
+  // the interleaved samples for half a DSPVector of steps.
+  using Interleaved = DSPVectorArray<kWidth / 2>;
+
+  // run the allpasses for all steps, in place. Each allpass is computed as
+  // y = (x1 + c*x) - c*y1 so that only the last multiply-add depends on y1.
+  inline void run(Interleaved& buf)
+  {
+    // the groups are independent, so the inner loop lets their recursions
+    // overlap.
+    float* p = buf.getBuffer();
+    for (int i = 0; i < kSteps; ++i)
+    {
+      for (int g = 0; g < kGroups; ++g)
+      {
+        SIMDVectorFloat* s = _state[g];
+        SIMDVectorFloat x = vecLoad(p);
+        SIMDVectorFloat ya = vecFMA(_negC0[g], s[y1a], vecFMA(_c0[g], x, s[x1]));
+        SIMDVectorFloat yb = vecFMA(_negC1[g], s[y1b], vecFMA(_c1[g], ya, s[y1a]));
+        s[x1] = x;
+        s[y1a] = ya;
+        s[y1b] = yb;
+        vecStore(p, yb);
+        p += kLanes;
+      }
+    }
+  }
+
+  // upsample half of the input vector, starting at sample start.
+  inline DSPVectorArray<CHANNELS> upsample(const DSPVectorArray<CHANNELS>& vx, int start)
   {
-    DSPVector vy;
-    int i2 = 0;
-    for (int i = 0; i < kFloatsPerDSPVector / 2; ++i)
+    // each input sample goes to both branches of its channel. Unused lanes are
+    // set to zero.
+    Interleaved buf(kUninitialized);
+    if ((CHANNELS * 2) % kLanes)
+    {
+      buf = 0.f;
+    }
+    float* pBuf = buf.getBuffer();
+    for (int c = 0; c < int(CHANNELS); ++c)
     {
-      vy[i2++] = apa1.processSample(apa0.processSample(vx[i]));
-      vy[i2++] = apb1.processSample(apb0.processSample(vx[i]));
+      const float* px = vx.getRowDataConst(c) + start;
+      float* pLane = pBuf + 2 * c;
+      for (int i = 0; i < kSteps; ++i)
+      {
+        pLane[i * kWidth] = pLane[i * kWidth + 1] = px[i];
+      }
+    }
+    run(buf);
+
+    // the outputs of the two branches are the even and odd output samples.
+    DSPVectorArray<CHANNELS> vy(kUninitialized);
+    for (int c = 0; c < int(CHANNELS); ++c)
+    {
+      const float* pLane = pBuf + 2 * c;
+      float* py = vy.getRowData(c);
+      for (int i = 0; i < kSteps; ++i)
+      {
+        py[2 * i] = pLane[i * kWidth];
+        py[2 * i + 1] = pLane[i * kWidth + 1];
+      }
     }
     return vy;
   }
 
-  inline DSPVector upsampleSecondHalf(const DSPVector vx)
+  // downsample one vector of input to half a vector of output, starting at
+  // sample start of vy.
+  inline void downsample(const DSPVectorArray<CHANNELS>& vx, DSPVectorArray<CHANNELS>& vy,
+                         int start)
   {
-    DSPVector vy;
-    int i2 = 0;
-    for (int i = kFloatsPerDSPVector / 2; i < kFloatsPerDSPVector; ++i)
+    // the even input samples go to the first branch and the odd ones to the
+    // second, so each pair of input samples is copied as it is.
+    Interleaved buf(kUninitialized);
+    if ((CHANNELS * 2) % kLanes)
     {
-      vy[i2++] = apa1.processSample(apa0.processSample(vx[i]));
-      vy[i2++] = apb1.processSample(apb0.processSample(vx[i]));
+      buf = 0.f;
+    }
+    float* pBuf = buf.getBuffer();
+    for (int c = 0; c < int(CHANNELS); ++c)
+    {
+      const float* px = vx.getRowDataConst(c);
+      float* pLane = pBuf + 2 * c;
+      for (int i = 0; i < kSteps; ++i)
+      {
+        pLane[i * kWidth] = px[2 * i];
+        pLane[i * kWidth + 1] = px[2 * i + 1];
+      }
+    }
+    run(buf);
+
+    for (int c = 0; c < int(CHANNELS); ++c)
+    {
+      const float* pLane = pBuf + 2 * c;
+      float* py = vy.getRowData(c) + start;
+      float b1 = _b1[c];
+      for (int i = 0; i < kSteps; ++i)
+      {
+        py[i] = (pLane[i * kWidth] + b1) * 0.5f;
+        b1 = pLane[i * kWidth + 1];
+      }
+      _b1[c] = b1;
     }
-    return vy;
   }
 
-  inline DSPVector downsample(const DSPVector vx1, const DSPVector vx2)
+ public:
+  HalfBandFilterArray()
   {
-    DSPVector vy;
-    int i2 = 0;
-    for (int i = 0; i < kFloatsPerDSPVector / 2; ++i)
+    // the first branch in even lanes and the second in odd ones. Unused lanes
+    // run with zero coefficients.
+    SIMDVectorFloatUnion c0[kGroups]{}, c1[kGroups]{};
+    for (int lane = 0; lane < int(CHANNELS * 2); ++lane)
     {
-      float a0 = apa1.processSample(apa0.processSample(vx1[i2]));
-      float b0 = apb1.processSample(apb0.processSample(vx1[i2 + 1]));
-      vy[i] = (a0 + b1) * 0.5f;
-      b1 = b0;
-      i2 += 2;
+      c0[lane / kLanes].f[lane % kLanes] = (lane & 1) ? kB0 : kA0;
+      c1[lane / kLanes].f[lane % kLanes] = (lane & 1) ? kB1 : kA1;
     }
-    i2 = 0;
-    for (int i = kFloatsPerDSPVector / 2; i < kFloatsPerDSPVector; ++i)
+    for (int g = 0; g < kGroups; ++g)
     {
-      float a0 = apa1.processSample(apa0.processSample(vx2[i2]));
-      float b0 = apb1.processSample(apb0.processSample(vx2[i2 + 1]));
-      vy[i] = (a0 + b1) * 0.5f;
-      b1 = b0;
-      i2 += 2;
+      _c0[g] = c0[g].v;
+      _c1[g] = c1[g].v;
+      _negC0[g] = vecSub(vecZeros(), _c0[g]);
+      _negC1[g] = vecSub(vecZeros(), _c1[g]);
     }
+  }
+
+  inline DSPVectorArray<CHANNELS> upsampleFirstHalf(const DSPVectorArray<CHANNELS>& vx)
+  {
+    return upsample(vx, 0);
+  }
+
+  inline DSPVectorArray<CHANNELS> upsampleSecondHalf(const DSPVectorArray<CHANNELS>& vx)
+  {
+    return upsample(vx, kSteps);
+  }
+
+  inline DSPVectorArray<CHANNELS> downsample(const DSPVectorArray<CHANNELS>& vx1,
+                                             const DSPVectorArray<CHANNELS>& vx2)
+  {
+    DSPVectorArray<CHANNELS> vy(kUninitialized);
+    downsample(vx1, vy, 0);
+    downsample(vx2, vy, kSteps);
     return vy;
   }
 
- private:
-  // order=4, rejection=70dB, transition band=0.1.
-  Allpass1 apa0{0.07986642623635751f}, apa1{0.5453536510711322f}, apb0{0.28382934487410993f},
-      apb1{0.8344118914807379f};
-  float b1{0};
+  inline void clear()
+  {
+    for (int g = 0; g < kGroups; ++g)
+    {
+      for (int i = 0; i < nState; ++i)
+      {
+        _state[g][i] = vecZeros();
+      }
+    }
+    std::fill(std::begin(_b1), std::end(_b1), 0.f);
+  }
 };
 
-// Downsampler
-// a cascade of half band filters, one for each octave.
-// TODO this is complicated. replace with single-channel version then use Bank<Downsampler> for multiple channels?
-class Downsampler
+// HalfBandFilter: a single channel half band filter.
+using HalfBandFilter = HalfBandFilterArray<1>;
+
+// HalfBandFIRArray
+// Linear phase half band FIR filters used to upsample or downsample CHANNELS
+// signals by 2x, with the same interface as HalfBandFilterArray. The filter is
+// a Blackman-windowed sinc of 4 * kHalfLength - 1 taps, of which every other one
+// is zero except the center tap. So in polyphase form one phase of each output
+// is a delay, and the other is an FIR of 2 * kHalfLength taps, computed with
+// SIMD across time. It has more delay and uses more CPU than the allpass
+// filters, but its delay is the same at all frequencies.
+
+template <size_t CHANNELS>
+class HalfBandFIRArray
 {
-  std::vector<HalfBandFilter> _filters;
-  std::vector<float> _buffers;
-  int _octaves;
-  int _numBuffers;
-  uint32_t _counter{0};
+ public:
+  static constexpr int kHalfLength = 16;
+  static constexpr int kTaps = kHalfLength * 2;
+
+  // the delay in samples at the higher rate: the center of the filter.
+  static constexpr float kGroupDelay = kTaps - 1;
+
+ private:
+  static constexpr int kSteps = kFloatsPerDSPVector / 2;
+  static constexpr int kHistory = kTaps;
+  static constexpr int kRowSize = kHistory + kSteps;
+  static_assert(kSteps % kFloatsPerSIMDVector == 0, "HalfBandFIRArray: vector size too small");
 
-  float* bufferPtr(int idx)
+  // the nonzero taps other than the center, each in all lanes.
+  SIMDVectorFloat _taps[kTaps];
+
+  // for each channel, past and current input at the lower rate, for
+  // upsampling, or the even and odd input samples, for downsampling.
+  std::vector<float> _low, _even, _odd;
+
+  float* row(std::vector<float>& v, size_t c) { return v.data() + c * kRowSize; }
+
+  // y[i] = sum over k of taps[k] * x[i - k], for kSteps outputs. px points to
+  // the current input, with kTaps - 1 samples of history before it.
+  inline void convolve(const float* px, float* py)
   {
-    return _buffers.data() + idx * kFloatsPerDSPVector;
+    for (int i = 0; i < kSteps; i += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat acc0 = vecZeros(), acc1 = vecZeros();
+      for (int k = 0; k < kTaps; k += 2)
+      {
+        acc0 = vecFMA(_taps[k], vecLoadUnaligned(px + i - k), acc0);
+        acc1 = vecFMA(_taps[k + 1], vecLoadUnaligned(px + i - k - 1), acc1);
+      }
+      vecStoreUnaligned(py + i, vecAdd(acc0, acc1));
+    }
   }
 
- public:
-  Downsampler(int octavesDown) : _octaves(octavesDown)
+  // move the most recent input to the history.
+  static void shift(float* pRow) { std::copy(pRow + kSteps, pRow + kRowSize, pRow); }
+
+  inline DSPVectorArray<CHANNELS> upsample(const DSPVectorArray<CHANNELS>& vx, int start)
   {
-    if (_octaves)
+    DSPVectorArray<CHANNELS> vy(kUninitialized);
+    float even[kSteps];
+    for (int c = 0; c < int(CHANNELS); ++c)
+    {
+      float* pLow = row(_low, c);
+      const float* px = vx.getRowDataConst(c) + start;
+      std::copy(px, px + kSteps, pLow + kHistory);
+
+      // the even outputs are filtered, with a gain of two for the zeros
+      // between input samples, and the odd outputs are the input delayed to
+      // the center of the filter.
+      convolve(pLow + kHistory, even);
+      const float* pDelayed = pLow + kHistory - (kHalfLength - 1);
+      float* py = vy.getRowData(c);
+      for (int i = 0; i < kSteps; ++i)
+      {
+        py[2 * i] = even[i] * 2.f;
+        py[2 * i + 1] = pDelayed[i];
+      }
+      shift(pLow);
+    }
+    return vy;
+  }
+
+  inline void downsample(const DSPVectorArray<CHANNELS>& vx, DSPVectorArray<CHANNELS>& vy,
+                         int start)
+  {
+    for (int c = 0; c < int(CHANNELS); ++c)
     {
-      // one pair of buffers for each octave plus one output buffer.
-      _numBuffers = 2 * _octaves + 1;
+      float* pEven = row(_even, c);
+      float* pOdd = row(_odd, c);
+      const float* px = vx.getRowDataConst(c);
+      for (int i = 0; i < kSteps; ++i)
+      {
+        pEven[kHistory + i] = px[2 * i];
+        pOdd[kHistory + i] = px[2 * i + 1];
+      }
 
-      // each octave uses one filter.
-      _filters.resize(_octaves);
+      // the even input samples are filtered, and the odd ones are at the
+      // center tap of 0.5, one sample before the center of the filter.
+      float* py = vy.getRowData(c) + start;
+      convolve(pEven + kHistory, py);
+      const float* pDelayed = pOdd + kHistory - kHalfLength;
+      for (int i = 0; i < kSteps; ++i)
+      {
+        py[i] += pDelayed[i] * 0.5f;
+      }
+      shift(pEven);
+      shift(pOdd);
+    }
+  }
 
-      // get all buffers as a single contiguous array of floats.
-      _buffers.resize(kFloatsPerDSPVector * _numBuffers);
+ public:
+  HalfBandFIRArray()
+      : _low(CHANNELS * kRowSize), _even(CHANNELS * kRowSize), _odd(CHANNELS * kRowSize)
+  {
+    // tap k is at an odd offset of 2k - (kTaps - 1) from the center. The taps
+    // are normalized to sum to 1/2, to make the DC gain exactly one.
+    const int length = kTaps * 2 - 1;
+    double taps[kTaps];
+    double sum{0};
+    for (int k = 0; k < kTaps; ++k)
+    {
+      const int offset = 2 * k - (kTaps - 1);
+      const double x = double(2 * k + 1) / (length + 1);
+      const double window = 0.42 - 0.5 * std::cos(2 * kPi * x) + 0.08 * std::cos(4 * kPi * x);
+      taps[k] = std::sin(kPi * offset * 0.5) / (kPi * offset) * window;
+      sum += taps[k];
+    }
+    for (int k = 0; k < kTaps; ++k)
+    {
+      _taps[k] = vecSet1(float(taps[k] * 0.5 / sum));
     }
   }
-  ~Downsampler() = default;
+
+  inline DSPVectorArray<CHANNELS> upsampleFirstHalf(const DSPVectorArray<CHANNELS>& vx)
+  {
+    return upsample(vx, 0);
+  }
+
+  inline DSPVectorArray<CHANNELS> upsampleSecondHalf(const DSPVectorArray<CHANNELS>& vx)
+  {
+    return upsample(vx, kSteps);
+  }
+
+  inline DSPVectorArray<CHANNELS> downsample(const DSPVectorArray<CHANNELS>& vx1,
+                                             const DSPVectorArray<CHANNELS>& vx2)
+  {
+    DSPVectorArray<CHANNELS> vy(kUninitialized);
+    downsample(vx1, vy, 0);
+    downsample(vx2, vy, kSteps);
+    return vy;
+  }
+
+  inline void clear()
+  {
+    std::fill(_low.begin(), _low.end(), 0.f);
+    std::fill(_even.begin(), _even.end(), 0.f);
+    std::fill(_odd.begin(), _odd.end(), 0.f);
+  }
+};
+
+// DownsamplerArray
+// a cascade of half band filters, one for each octave, for CHANNELS signals.
+template <size_t CHANNELS>
+class DownsamplerArray
+{
+  std::vector<HalfBandFilterArray<CHANNELS>> _filters;
+  std::vector<DSPVectorArray<CHANNELS>> _buffers;
+  int _octaves;
+  int _numBuffers;
+  uint32_t _counter{0};
+
+ public:
+  DownsamplerArray(int octavesDown) : _octaves(octavesDown)
+  {
+    // one pair of buffers for each octave plus one output buffer.
+    _numBuffers = 2 * _octaves + 1;
+
+    // each octave uses one filter.
+    _filters.resize(_octaves);
+    _buffers.resize(_numBuffers);
+  }
+  ~DownsamplerArray() = default;
 
   // write a vector of samples to the filter chain, run filters, and return
   // true if there is a new vector of output to read (every 2^octaves writes)
-  bool write(DSPVector v)
+  bool write(const DSPVectorArray<CHANNELS>& v)
   {
     if (_octaves)
     {
       // write input to one of first two buffers
-      const float* pSrc = v.getConstBuffer();
-      float* pDest = bufferPtr(_counter & 1);
-      std::copy(pSrc, pSrc + kFloatsPerDSPVector, pDest);
+      _buffers[_counter & 1] = v;
 
       // look at the bits of the counter from lowest to highest.
       // there is one bit for each octave of downsampling.
@@ -1366,11 +2266,7 @@ class Downsampler
         bool b1 = _counter & mask;
 
         // run filter
-        HalfBandFilter* f = &(_filters[h]);
-        DSPVector vSrc1(bufferPtr(h * 2));
-        DSPVector vSrc2(bufferPtr(h * 2 + 1));
-        DSPVector vDest = f->downsample(vSrc1, vSrc2);
-        store(vDest, bufferPtr(h * 2 + 2 + b1));
+        _buffers[h * 2 + 2 + b1] = _filters[h].downsample(_buffers[h * 2], _buffers[h * 2 + 1]);
       }
 
       // advance and wrap counter. If it's back to 0, we have output
@@ -1381,53 +2277,41 @@ class Downsampler
     else
     {
       // write input to final buffer
-      const float* pSrc = v.getConstBuffer();
-      float* pDest = bufferPtr(_numBuffers - 1);
-      std::copy(pSrc, pSrc + kFloatsPerDSPVector, pDest);
+      _buffers[_numBuffers - 1] = v;
       return true;
     }
   }
 
-  DSPVector read()
-  {
-    return DSPVector(bufferPtr(_numBuffers - 1));
-  }
+  DSPVectorArray<CHANNELS> read() { return _buffers[_numBuffers - 1]; }
 };
 
+using Downsampler = DownsamplerArray<1>;
 
-struct Upsampler
+// UpsamplerArray
+// a cascade of half band filters, one for each octave, for CHANNELS signals.
+template <size_t CHANNELS>
+class UpsamplerArray
 {
-  std::vector<HalfBandFilter> _filters;
-  std::vector<float> _buffers;
+  std::vector<HalfBandFilterArray<CHANNELS>> _filters;
+  std::vector<DSPVectorArray<CHANNELS>> _buffers;
   int _octaves;
   int _numBuffers;
   int readIdx_{0};
 
-  float* bufferPtr(int idx)
+ public:
+  UpsamplerArray(int octavesUp) : _octaves(octavesUp)
   {
-    return _buffers.data() + idx * kFloatsPerDSPVector;
+    _numBuffers = 1 << _octaves;
+    _filters.resize(_octaves);
+    _buffers.resize(_numBuffers);
   }
+  ~UpsamplerArray() = default;
 
-  Upsampler(int octavesUp) : _octaves(octavesUp)
-  {
-    if (_octaves)
-    {
-      _numBuffers = 1 << _octaves;
-      
-      size_t numFilters = _octaves;//(1 << _octaves) - 1;
-      _filters.resize(numFilters);
-      
-      // get all buffers as a single contiguous array of floats.
-      _buffers.resize(kFloatsPerDSPVector * _numBuffers);
-    }
-  }
-  ~Upsampler() = default;
-
-  void write(DSPVector x)
+  void write(const DSPVectorArray<CHANNELS>& x)
   {
     // write to last vector in buffer
-    store(x, bufferPtr(_numBuffers - 1));
-    
+    _buffers[_numBuffers - 1] = x;
+
     // for each octave of upsampling, upsample blocks to twice as many, in place, ending at buffers end
     for (int j = 0; j < _octaves; ++j)
     {
@@ -1436,29 +2320,21 @@ struct Upsampler
       int srcStart = _numBuffers - sourceBufs;
       int destStart = _numBuffers - destBufs;
 
-      for(int i=0; i < sourceBufs; ++i)
+      for (int i = 0; i < sourceBufs; ++i)
       {
-        DSPVector src, dest1, dest2;
-        load(src, bufferPtr(srcStart + i));
-        dest1 = _filters[j].upsampleFirstHalf(src);
-        dest2 = _filters[j].upsampleSecondHalf(src);
-        store(dest1, bufferPtr(destStart + (i*2)));
-        store(dest2, bufferPtr(destStart + (i*2) + 1));
+        DSPVectorArray<CHANNELS> src = _buffers[srcStart + i];
+        _buffers[destStart + (i * 2)] = _filters[j].upsampleFirstHalf(src);
+        _buffers[destStart + (i * 2) + 1] = _filters[j].upsampleSecondHalf(src);
       }
     }
     readIdx_ = 0;
   }
-  
+
   // after a write, 1 << octaves reads are available.
-  DSPVector read()
-  {
-    DSPVector result;
-    load(result, bufferPtr(readIdx_++));
-    return result;
-  }
+  DSPVectorArray<CHANNELS> read() { return _buffers[readIdx_++]; }
 };
 
-
+using Upsampler = UpsamplerArray<1>;
 
 // PLL: Phase Locked Loop for synching an output phasor to an input phasor at some ratio.
 
@@ -1479,7 +2355,7 @@ class PLL
   // 1.0/sampleRate is a good amount of feedback to start with.
   DSPVector operator()(DSPVector x, DSPVector dydx, DSPVector feedback)
   {
-    DSPVector y;
+    DSPVector y(kUninitialized);
     
     // if input phasor is inactive, reset and bail.
     // (inactive / active switch is only done every vector)
@@ -1607,4 +2483,188 @@ class PLL
   }
 };
 
+// --------------------------------------------------------------------------------
+// SIMD kernels for lane-interleaved banks of filters.
+// A BankKernel<T> runs one sample step of filter T for several voices at once,
+// one voice in each SIMD lane. getCoeffs() copies the coefficients of a filter
+// object to floats, and step() advances the state s for the input x using
+// coefficients c, each holding one SIMD vector per coefficient or state variable.
+// See InterleavedBank in MLDSPFunctional.h.
+
+template <typename T>
+struct BankKernel;
+
+template <>
+struct BankKernel<Lopass>
+{
+  enum { g0, g1, g2, nCoeffs };
+  enum { ic1eq, ic2eq, nState };
+
+  static void getCoeffs(const Lopass& f, float* c)
+  {
+    c[g0] = f._coeffs[Lopass::g0];
+    c[g1] = f._coeffs[Lopass::g1];
+    c[g2] = f._coeffs[Lopass::g2];
+  }
+
+  static SIMDVectorFloat step(SIMDVectorFloat x, const SIMDVectorFloat* c, SIMDVectorFloat* s)
+  {
+    SIMDVectorFloat t0 = vecSub(x, s[ic2eq]);
+    SIMDVectorFloat t1 = vecFMA(c[g1], s[ic1eq], vecMul(c[g0], t0));
+    SIMDVectorFloat t2 = vecFMA(c[g0], s[ic1eq], vecMul(c[g2], t0));
+    SIMDVectorFloat v2 = vecAdd(t2, s[ic2eq]);
+    s[ic1eq] = vecFMA(vecSet1(2.0f), t1, s[ic1eq]);
+    s[ic2eq] = vecFMA(vecSet1(2.0f), t2, s[ic2eq]);
+    return v2;
+  }
+};
+
+template <>
+struct BankKernel<Hipass>
+{
+  enum { g0, g1, g2, negK, nCoeffs };
+  enum { ic1eq, ic2eq, nState };
+
+  static void getCoeffs(const Hipass& f, float* c)
+  {
+    c[g0] = f.mCoeffs.g0;
+    c[g1] = f.mCoeffs.g1;
+    c[g2] = f.mCoeffs.g2;
+    c[negK] = -f.mCoeffs.k;
+  }
+
+  static SIMDVectorFloat step(SIMDVectorFloat x, const SIMDVectorFloat* c, SIMDVectorFloat* s)
+  {
+    SIMDVectorFloat t0 = vecSub(x, s[ic2eq]);
+    SIMDVectorFloat t1 = vecFMA(c[g1], s[ic1eq], vecMul(c[g0], t0));
+    SIMDVectorFloat t2 = vecFMA(c[g0], s[ic1eq], vecMul(c[g2], t0));
+    SIMDVectorFloat v1 = vecAdd(t1, s[ic1eq]);
+    SIMDVectorFloat v2 = vecAdd(t2, s[ic2eq]);
+    s[ic1eq] = vecFMA(vecSet1(2.0f), t1, s[ic1eq]);
+    s[ic2eq] = vecFMA(vecSet1(2.0f), t2, s[ic2eq]);
+    return vecFMA(c[negK], v1, vecSub(x, v2));
+  }
+};
+
+template <>
+struct BankKernel<Bandpass>
+{
+  enum { g0, g1, g2, nCoeffs };
+  enum { ic1eq, ic2eq, nState };
+
+  static void getCoeffs(const Bandpass& f, float* c)
+  {
+    c[g0] = f.mCoeffs.g0;
+    c[g1] = f.mCoeffs.g1;
+    c[g2] = f.mCoeffs.g2;
+  }
+
+  static SIMDVectorFloat step(SIMDVectorFloat x, const SIMDVectorFloat* c, SIMDVectorFloat* s)
+  {
+    SIMDVectorFloat t0 = vecSub(x, s[ic2eq]);
+    SIMDVectorFloat t1 = vecFMA(c[g1], s[ic1eq], vecMul(c[g0], t0));
+    SIMDVectorFloat t2 = vecFMA(c[g0], s[ic1eq], vecMul(c[g2], t0));
+    SIMDVectorFloat v1 = vecAdd(t1, s[ic1eq]);
+    s[ic1eq] = vecFMA(vecSet1(2.0f), t1, s[ic1eq]);
+    s[ic2eq] = vecFMA(vecSet1(2.0f), t2, s[ic2eq]);
+    return v1;
+  }
+};
+
+template <>
+struct BankKernel<OnePole>
+{
+  enum { a0, b1, nCoeffs };
+  enum { y1, nState };
+
+  static void getCoeffs(const OnePole& f, float* c)
+  {
+    c[a0] = f.mCoeffs.a0;
+    c[b1] = f.mCoeffs.b1;
+  }
+
+  static SIMDVectorFloat step(SIMDVectorFloat x, const SIMDVectorFloat* c, SIMDVectorFloat* s)
+  {
+    s[y1] = vecFMA(c[b1], s[y1], vecMul(c[a0], x));
+    return s[y1];
+  }
+};
+
+template <>
+struct BankKernel<DCBlocker>
+{
+  enum { r, nCoeffs };
+  enum { x1, y1, nState };
+
+  static void getCoeffs(const DCBlocker& f, float* c) { c[r] = f.mCoeffs; }
+
+  static SIMDVectorFloat step(SIMDVectorFloat x, const SIMDVectorFloat* c, SIMDVectorFloat* s)
+  {
+    SIMDVectorFloat y0 = vecFMA(c[r], s[y1], vecSub(x, s[x1]));
+    s[x1] = x;
+    s[y1] = y0;
+    return y0;
+  }
+};
+
+template <>
+struct BankKernel<PinkFilter>
+{
+  enum { pole0, pole1, pole2, in0, in1, in2, direct, gain, nCoeffs };
+  enum { b0, b1, b2, nState };
+
+  static void getCoeffs(const PinkFilter&, float* c)
+  {
+    c[pole0] = PinkFilter::kPole0;
+    c[pole1] = PinkFilter::kPole1;
+    c[pole2] = PinkFilter::kPole2;
+    c[in0] = PinkFilter::kIn0;
+    c[in1] = PinkFilter::kIn1;
+    c[in2] = PinkFilter::kIn2;
+    c[direct] = PinkFilter::kDirect;
+    c[gain] = PinkFilter::kGain;
+  }
+
+  static SIMDVectorFloat step(SIMDVectorFloat x, const SIMDVectorFloat* c, SIMDVectorFloat* s)
+  {
+    x = vecMul(x, c[gain]);
+    s[b0] = vecFMA(c[pole0], s[b0], vecMul(c[in0], x));
+    s[b1] = vecFMA(c[pole1], s[b1], vecMul(c[in1], x));
+    s[b2] = vecFMA(c[pole2], s[b2], vecMul(c[in2], x));
+    return vecFMA(c[direct], x, vecAdd(vecAdd(s[b0], s[b1]), s[b2]));
+  }
+};
+
+template <>
+struct BankKernel<Integrator>
+{
+  enum { leak, nCoeffs };
+  enum { y1, nState };
+
+  static void getCoeffs(const Integrator& f, float* c) { c[leak] = f.mLeak; }
+
+  static SIMDVectorFloat step(SIMDVectorFloat x, const SIMDVectorFloat* c, SIMDVectorFloat* s)
+  {
+    s[y1] = vecAdd(vecSub(s[y1], vecMul(s[y1], c[leak])), x);
+    return s[y1];
+  }
+};
+
+template <>
+struct BankKernel<Allpass1>
+{
+  enum { a, nCoeffs };
+  enum { x1, y1, nState };
+
+  static void getCoeffs(const Allpass1& f, float* c) { c[a] = f.mCoeffs; }
+
+  static SIMDVectorFloat step(SIMDVectorFloat x, const SIMDVectorFloat* c, SIMDVectorFloat* s)
+  {
+    SIMDVectorFloat y = vecFMA(vecSub(x, s[y1]), c[a], s[x1]);
+    s[x1] = x;
+    s[y1] = y;
+    return y;
+  }
+};
+
 }  // namespace ml
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <functional>
 
 #include "MLDSPFilters.h"
@@ -23,7 +24,7 @@ namespace ml
 template <size_t ROWS>
 inline DSPVectorArray<ROWS> map(std::function<float()> f, const DSPVectorArray<ROWS> x)
 {
-  DSPVectorArray<ROWS> y;
+  DSPVectorArray<ROWS> y(kUninitialized);
   for (int n = 0; n < kFloatsPerDSPVector * ROWS; ++n)
   {
     y[n] = f();
@@ -36,7 +37,7 @@ inline DSPVectorArray<ROWS> map(std::function<float()> f, const DSPVectorArray<R
 template <size_t ROWS>
 inline DSPVectorArray<ROWS> map(std::function<float(float)> f, const DSPVectorArray<ROWS> x)
 {
-  DSPVectorArray<ROWS> y;
+  DSPVectorArray<ROWS> y(kUninitialized);
   for (int n = 0; n < kFloatsPerDSPVector * ROWS; ++n)
   {
     y[n] = f(x[n]);
@@ -49,7 +50,7 @@ inline DSPVectorArray<ROWS> map(std::function<float(float)> f, const DSPVectorAr
 template <size_t ROWS>
 inline DSPVectorArray<ROWS> map(std::function<float(int)> f, const DSPVectorArrayInt<ROWS> x)
 {
-  DSPVectorArray<ROWS> y;
+  DSPVectorArray<ROWS> y(kUninitialized);
   for (int n = 0; n < kFloatsPerDSPVector * ROWS; ++n)
   {
     y[n] = f(x[n]);
@@ -63,7 +64,7 @@ template <size_t ROWS>
 inline DSPVectorArray<ROWS> map(std::function<DSPVector(const DSPVector)> f,
                                 const DSPVectorArray<ROWS> x)
 {
-  DSPVectorArray<ROWS> y;
+  DSPVectorArray<ROWS> y(kUninitialized);
   for (int j = 0; j < ROWS; ++j)
   {
     y.row(j) = f(x.constRow(j));
@@ -77,7 +78,7 @@ template <size_t ROWS>
 inline DSPVectorArray<ROWS> map(std::function<DSPVector(const DSPVector, int)> f,
                                 const DSPVectorArray<ROWS> x)
 {
-  DSPVectorArray<ROWS> y;
+  DSPVectorArray<ROWS> y(kUninitialized);
   for (int j = 0; j < ROWS; ++j)
   {
     y.row(j) = f(x.constRow(j), j);
@@ -92,7 +93,7 @@ template <size_t ROWS>
 inline DSPVectorArray<ROWS> map(std::function<DSPVector(const DSPVector, const DSPVector)> f,
                                 const DSPVectorArray<ROWS> x)
 {
-  DSPVectorArray<ROWS> y;
+  DSPVectorArray<ROWS> y(kUninitialized);
   for (int j = 0; j < ROWS; ++j)
   {
     y.row(j) = f(x.constRow(j), j);
@@ -127,32 +128,21 @@ class Upsample2xFunction
   // DSPVectorArray.
   inline outputType operator()(ProcessFn fn, inputType vx)
   {
-    // upsample each row of input to 2x buffers
-    for (int j = 0; j < IN_ROWS; ++j)
-    {
-      DSPVector x1a = mUppers[j].upsampleFirstHalf(vx.constRow(j));
-      DSPVector x1b = mUppers[j].upsampleSecondHalf(vx.constRow(j));
-      mUpsampledInput1.row(j) = x1a;
-      mUpsampledInput2.row(j) = x1b;
-    }
+    // upsample the input to 2x buffers
+    mUpsampledInput1 = mUppers.upsampleFirstHalf(vx);
+    mUpsampledInput2 = mUppers.upsampleSecondHalf(vx);
 
     // process upsampled input
     mUpsampledOutput1 = fn(mUpsampledInput1);
     mUpsampledOutput2 = fn(mUpsampledInput2);
 
-    // downsample each processed row to 1x output
-    outputType vy;
-    for (int j = 0; j < OUT_ROWS; ++j)
-    {
-      vy.row(j) =
-          mDowners[j].downsample(mUpsampledOutput1.constRow(j), mUpsampledOutput2.constRow(j));
-    }
-    return vy;
+    // downsample the processed output to 1x
+    return mDowners.downsample(mUpsampledOutput1, mUpsampledOutput2);
   }
 
  private:
-  std::array<HalfBandFilter, IN_ROWS> mUppers;
-  std::array<HalfBandFilter, OUT_ROWS> mDowners;
+  HalfBandFilterArray<IN_ROWS> mUppers;
+  HalfBandFilterArray<OUT_ROWS> mDowners;
   DSPVectorArray<IN_ROWS> mUpsampledInput1, mUpsampledInput2;
   DSPVectorArray<OUT_ROWS> mUpsampledOutput1, mUpsampledOutput2;
 };
@@ -184,24 +174,16 @@ class Downsample2xFunction
     DSPVectorArray<OUT_ROWS> vy;
     if (mPhase)
     {
-      // downsample each row of input to 1/2x buffers
-      for (int j = 0; j < IN_ROWS; ++j)
-      {
-        mDownsampledInput.row(j) = mDowners[j].downsample(mInputBuffer.constRow(j), vx.constRow(j));
-      }
+      // downsample the input to 1/2x buffers
+      mDownsampledInput = mDowners.downsample(mInputBuffer, vx);
 
       // process downsampled input
       mDownsampledOutput = fn(mDownsampledInput);
 
-      // upsample each processed row to output
-      for (int j = 0; j < OUT_ROWS; ++j)
-      {
-        // first half is returned
-        vy.row(j) = mUppers[j].upsampleFirstHalf(mDownsampledOutput.constRow(j));
-
-        // second half is buffered
-        mOutputBuffer.row(j) = mUppers[j].upsampleSecondHalf(mDownsampledOutput.constRow(j));
-      }
+      // upsample the processed output. The first half is returned and the
+      // second half is buffered.
+      vy = mUppers.upsampleFirstHalf(mDownsampledOutput);
+      mOutputBuffer = mUppers.upsampleSecondHalf(mDownsampledOutput);
     }
     else
     {
@@ -215,8 +197,8 @@ class Downsample2xFunction
   }
 
  private:
-  std::array<HalfBandFilter, IN_ROWS> mDowners;
-  std::array<HalfBandFilter, OUT_ROWS> mUppers;
+  HalfBandFilterArray<IN_ROWS> mDowners;
+  HalfBandFilterArray<OUT_ROWS> mUppers;
   DSPVectorArray<IN_ROWS> mInputBuffer;
   DSPVectorArray<OUT_ROWS> mOutputBuffer;
   DSPVectorArray<IN_ROWS> mDownsampledInput;
@@ -224,30 +206,93 @@ class Downsample2xFunction
   bool mPhase{false};
 };
 
-// OverlapAddFunction TODO
-/*
-template<int LENGTH, int DIVISIONS, int IN_ROWS, int OUT_ROWS>
-class OverlapAddFunction
+// OversampleFunction is a function object that given a process function f,
+// upsamples the input x by 2^octaves, applies f to each of the 2^octaves
+// vectors, downsamples and returns the result. Each octave up and down uses a
+// half band filter of type HALF_BAND<ROWS>: HalfBandFilterArray, the allpass
+// filters with low delay and low CPU, or HalfBandFIRArray, the linear phase
+// filters. getLatency() returns the total delay at the original rate, which is
+// exact for the linear phase filters and for low frequencies with the allpass
+// ones. All buffers are allocated in the constructor, and the process function
+// is a template parameter of operator(), so calling it with a lambda does not
+// allocate.
+
+template <int ROWS, template <size_t> class HALF_BAND = HalfBandFilterArray>
+class OversampleFunction
 {
-        typedef std::function<DSPVectorArray<OUT_ROWS>(const
-DSPVectorArray<IN_ROWS>)> ProcessFn;
+  int _octaves;
+  std::vector<HALF_BAND<ROWS>> _uppers;
+  std::vector<HALF_BAND<ROWS>> _downers;
+  std::vector<DSPVectorArray<ROWS>> _buffers;
 
-public:
-        inline DSPVectorArray<OUT_ROWS> operator()(ProcessFn fn, const
-DSPVectorArray<IN_ROWS> vx)
-        {
-        }
+ public:
+  // octaves from 1 to 4 oversample by 2x to 16x.
+  explicit OversampleFunction(int octaves)
+      : _octaves(octaves), _uppers(octaves), _downers(octaves), _buffers(size_t(1) << octaves)
+  {
+  }
 
-private:
-        //Matrix mHistory;
-        const DSPVector& mWindow;
+  int getFactor() const { return 1 << _octaves; }
+
+  // each octave delays the signal by the filter's group delay at its higher
+  // rate, once on the way up and once on the way down.
+  float getLatency() const
+  {
+    float latency{0.f};
+    for (int j = 1; j <= _octaves; ++j)
+    {
+      latency += 2.f * HALF_BAND<ROWS>::kGroupDelay / float(1 << j);
+    }
+    return latency;
+  }
+
+  template <typename FN>
+  inline DSPVectorArray<ROWS> operator()(FN&& fn, const DSPVectorArray<ROWS>& vx)
+  {
+    const int n = 1 << _octaves;
+
+    // upsample in place, ending at the end of the buffers.
+    _buffers[n - 1] = vx;
+    for (int j = 0; j < _octaves; ++j)
+    {
+      const int sourceBufs = 1 << j;
+      const int srcStart = n - sourceBufs;
+      const int destStart = n - sourceBufs * 2;
+      for (int i = 0; i < sourceBufs; ++i)
+      {
+        const DSPVectorArray<ROWS> src = _buffers[srcStart + i];
+        _buffers[destStart + i * 2] = _uppers[j].upsampleFirstHalf(src);
+        _buffers[destStart + i * 2 + 1] = _uppers[j].upsampleSecondHalf(src);
+      }
+    }
+
+    // process at the highest rate.
+    for (int i = 0; i < n; ++i)
+    {
+      _buffers[i] = fn(_buffers[i]);
+    }
+
+    // downsample in place, from the start of the buffers.
+    for (int j = _octaves - 1; j >= 0; --j)
+    {
+      const int destBufs = 1 << j;
+      for (int i = 0; i < destBufs; ++i)
+      {
+        _buffers[i] = _downers[j].downsample(_buffers[i * 2], _buffers[i * 2 + 1]);
+      }
+    }
+    return _buffers[0];
+  }
 };
-*/
+
+// for overlap-add processing of spectra, see STFT in MLDSPSTFT.h.
 
 // FeedbackDelayFunction
 // Wraps a function in a pitchbendable delay with feedback per row.
 // Since the feedback adds the output of the function to its input, the function
 // must input and output the same number of rows.
+// The loop has a latency of one DSPVector. For shorter loops, see
+// SubBlockFeedbackDelayFunction.
 
 // template<int ROWS>
 class FeedbackDelayFunction
@@ -263,8 +308,8 @@ class FeedbackDelayFunction
   inline DSPVectorArray<ROWS> operator()(const DSPVectorArray<ROWS> vx, ProcessFn fn,
                                          const DSPVector vDelayTime)
   {
-    DSPVectorArray<ROWS> vFnOutput;
-    vFnOutput = fn(vx + vy1 * DSPVectorArray<ROWS>(feedbackGain));
+    DSPVectorArray<ROWS> vFnOutput(kUninitialized);
+    vFnOutput = fn(vx + lazy(vy1) * feedbackGain);
 
     for (int j = 0; j < ROWS; ++j)
     {
@@ -299,9 +344,9 @@ class FeedbackDelayFunctionWithTap
   inline DSPVectorArray<ROWS> operator()(const DSPVectorArray<ROWS> vx, ProcessFn fn,
                                          const DSPVector vDelayTime)
   {
-    DSPVectorArray<ROWS> vFeedback;
+    DSPVectorArray<ROWS> vFeedback(kUninitialized);
     DSPVectorArray<ROWS> vOutputTap;
-    vFeedback = fn(vx + vy1 * DSPVectorArray<ROWS>(feedbackGain), vOutputTap);
+    vFeedback = fn(vx + lazy(vy1) * feedbackGain, vOutputTap);
 
     for (int j = 0; j < ROWS; ++j)
     {
@@ -315,6 +360,126 @@ class FeedbackDelayFunctionWithTap
   DSPVectorArray<ROWS> vy1;
 };
 
+// SubBlockFeedbackDelayFunction
+// Wraps a function in a delay with feedback, like FeedbackDelayFunction, but
+// runs the loop in sub-blocks of BLOCK samples, so that the total delay around
+// the loop can be as short as BLOCK samples instead of more than a DSPVector.
+// This is for physical models such as plucked strings, short combs and
+// waveguides.
+// The function processes one sub-block in place: it is called with a pointer to
+// BLOCK samples of input, which it replaces with its output. When BLOCK is a
+// multiple of kFloatsPerSIMDVector, the samples are aligned for SIMD.
+// The delay time is the total delay around the loop, including the function's
+// sub-block, and is clamped to [BLOCK, maxDelay]. Fractional delays are read
+// with linear interpolation, with SIMD when the sub-block allows.
+// Smaller blocks allow shorter loops at the cost of more calls to the function
+// and less SIMD. With a simple plucked string loop, blocks of one sample take
+// about twice as long as blocks of 16: see the timing in the
+// dsp_filters/sub_block_feedback test.
+
+template <int BLOCK>
+class SubBlockFeedbackDelayFunction
+{
+  static_assert(BLOCK >= 1 && (BLOCK & (BLOCK - 1)) == 0 && BLOCK <= kFloatsPerDSPVector,
+                "SubBlockFeedbackDelayFunction: BLOCK must be a power of two up to "
+                "kFloatsPerDSPVector");
+  static constexpr bool kSIMDBlocks = (BLOCK % kFloatsPerSIMDVector == 0);
+
+  RingStorage _buffer;
+  float _maxDelay{0.f};
+  size_t _writeIndex{0};
+
+ public:
+  float feedbackGain{1.f};
+
+  SubBlockFeedbackDelayFunction() = default;
+  SubBlockFeedbackDelayFunction(float maxDelay) { setMaxDelayInSamples(maxDelay); }
+
+  // This allocates memory and is not for use in the audio thread.
+  void setMaxDelayInSamples(float d)
+  {
+    _maxDelay = std::max(d, float(BLOCK));
+
+    // a sub-block write and the two samples of an interpolated read are contiguous.
+    _buffer.resize(size_t(_maxDelay) + BLOCK + 2, std::max(BLOCK, 2));
+    _writeIndex = 0;
+  }
+
+  inline void clear() { _buffer.clear(); }
+
+  template <typename FN>
+  inline DSPVector operator()(const DSPVector vx, FN fn, const DSPVector vDelayTime)
+  {
+    if (_buffer.size() == 0) setMaxDelayInSamples(0.f);
+    const DSPVector vDelay = clamp(vDelayTime, DSPVector(BLOCK), DSPVector(_maxDelay));
+    const float* px = vx.getConstBuffer();
+    const float* pDelay = vDelay.getConstBuffer();
+    DSPVector vy(kUninitialized);
+    float* py = vy.getBuffer();
+
+    for (int start = 0; start < kFloatsPerDSPVector; start += BLOCK)
+    {
+      // read the delayed output of the earlier sub-blocks and add the input.
+      float* pBlock = py + start;
+      readBlock(pBlock, pDelay + start);
+      for (int n = 0; n < BLOCK; ++n)
+      {
+        pBlock[n] = px[start + n] + feedbackGain * pBlock[n];
+      }
+
+      // run the function and write its output to the delay.
+      fn(pBlock);
+      std::copy(pBlock, pBlock + BLOCK, _buffer.data() + _writeIndex);
+      _buffer.commitWrite(_writeIndex, BLOCK);
+      _writeIndex = (_writeIndex + BLOCK) & _buffer.mask();
+    }
+    return vy;
+  }
+
+ private:
+  // read the sub-block at the write index, delayed by the given times. Each
+  // sample is interpolated between the two written samples around it: the
+  // delay of at least BLOCK keeps both of them in earlier sub-blocks.
+  inline void readBlock(float* py, const float* pDelay) const
+  {
+    const float* pBuffer = _buffer.data();
+    const int mask = int(_buffer.mask());
+    if (kSIMDBlocks)
+    {
+      SIMDVectorIntUnion laneIndex;
+      for (int i = 0; i < kFloatsPerSIMDVector; ++i)
+      {
+        laneIndex.i[i] = i;
+      }
+      for (int n = 0; n < BLOCK; n += kFloatsPerSIMDVector)
+      {
+        // sample (time - 1 - delayInt) and the one after it, in the mirror if
+        // need be.
+        const SIMDVectorFloat vDelay = vecLoad(pDelay + n);
+        const SIMDVectorInt vDelayInt = vecFloatToIntTruncate(vDelay);
+        const SIMDVectorFloat vFrac = vecSub(vDelay, vecIntToFloat(vDelayInt));
+        const SIMDVectorInt vTime = vecAddInt(vecSetInt1(int(_writeIndex) + n - 1), laneIndex.v);
+        const SIMDVectorInt vIndex = vecAndInt(vecSubInt(vTime, vDelayInt), vecSetInt1(mask));
+        const SIMDVectorFloat vEarlier = vecGather(pBuffer, vIndex);
+        const SIMDVectorFloat vLater = vecGather(pBuffer + 1, vIndex);
+        vecStore(py + n, vecFMA(vFrac, vecSub(vEarlier, vLater), vLater));
+      }
+    }
+    else
+    {
+      for (int n = 0; n < BLOCK; ++n)
+      {
+        const int delayInt = int(pDelay[n]);
+        const float frac = pDelay[n] - delayInt;
+        const int index = (int(_writeIndex) + n - 1 - delayInt) & mask;
+        const float earlier = pBuffer[index];
+        const float later = pBuffer[index + 1];
+        py[n] = later + frac * (earlier - later);
+      }
+    }
+  }
+};
+
 // Bank: a bank of processors. The processor type T must have a process() method
 // that outputs a single DSPVector and has only DSPVectors as arguments.
 // Each input is a DSPVectorArray with arguments for processor i on row i.
@@ -329,9 +494,9 @@ class Bank
   
   // Bank(): each processor gets arguments on its own row of each input DSPVectorArray<ROWS>.
   template <typename... Args>
-  inline DSPVectorArray<ROWS> operator()(Args... args)
+  inline DSPVectorArray<ROWS> operator()(const Args&... args)
   {
-    DSPVectorArray<ROWS> output;
+    DSPVectorArray<ROWS> output(kUninitialized);
     for (int i = 0; i < ROWS; ++i)
     {
       output.row(i) = _processors[i](args.constRow(i)...);
@@ -343,7 +508,7 @@ class Bank
   template <typename... Args>
   inline DSPVectorArray<ROWS> processArrays(Args... args)
   {
-    DSPVectorArray<ROWS> output;
+    DSPVectorArray<ROWS> output(kUninitialized);
     for (int i = 0; i < ROWS; ++i)
     {
       output.row(i) = _processors[i](args[i]...);
@@ -362,4 +527,507 @@ class Bank
   T& operator[](size_t n) { return _processors[n]; }
 };
 
+// InterleavedBank: a bank of recursive filters that runs one voice in each SIMD
+// lane, so that each sample step advances kFloatsPerSIMDVector voices at once.
+// The filter type T needs a BankKernel<T>, defined in MLDSPFilters.h for Lopass,
+// Hipass, Bandpass, OnePole, DCBlocker, PinkFilter, Integrator and Allpass1.
+// As with Bank, coefficients are set on each processor through operator[]. The
+// filter state is kept in the bank, so the processors' own state is not used.
+
+template <typename T, int ROWS>
+class InterleavedBank
+{
+  using Kernel = BankKernel<T>;
+  static constexpr int kLanes = kFloatsPerSIMDVector;
+  static constexpr int kGroups = (ROWS + kLanes - 1) / kLanes;
+
+  std::array<T, ROWS> _processors;
+  SIMDVectorFloat _state[kGroups][Kernel::nState]{};
+
+ public:
+  // operator(): each processor gets its input on its own row of vx.
+  inline DSPVectorArray<ROWS> operator()(const DSPVectorArray<ROWS>& vx)
+  {
+    // get coefficients for each lane. unused lanes run with zero coefficients.
+    SIMDVectorFloatUnion laneCoeffs[kGroups][Kernel::nCoeffs]{};
+    for (int row = 0; row < ROWS; ++row)
+    {
+      float c[Kernel::nCoeffs];
+      Kernel::getCoeffs(_processors[row], c);
+      for (int i = 0; i < Kernel::nCoeffs; ++i)
+      {
+        laneCoeffs[row / kLanes][i].f[row % kLanes] = c[i];
+      }
+    }
+    SIMDVectorFloat vCoeffs[kGroups][Kernel::nCoeffs];
+    for (int g = 0; g < kGroups; ++g)
+    {
+      for (int i = 0; i < Kernel::nCoeffs; ++i)
+      {
+        vCoeffs[g][i] = laneCoeffs[g][i].v;
+      }
+    }
+
+    // interleave the input samples so that each SIMD vector holds sample n of
+    // kLanes voices. Unused lanes are set to zero.
+    DSPVectorArray<kGroups * kLanes> interleaved(kUninitialized);
+    if (ROWS % kLanes)
+    {
+      interleaved = 0.f;
+    }
+    float* pInterleaved = interleaved.getBuffer();
+    for (int row = 0; row < ROWS; ++row)
+    {
+      // lanes of successive groups are adjacent, so voice row is at offset row.
+      const float* px = vx.constRow(row).getConstBuffer();
+      float* pLane = pInterleaved + row;
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        pLane[n * kGroups * kLanes] = px[n];
+      }
+    }
+
+    // run the filters, writing output in place. The groups of voices are
+    // independent, so the inner loop lets their recursions overlap.
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      float* p = pInterleaved + n * kGroups * kLanes;
+      for (int g = 0; g < kGroups; ++g)
+      {
+        vecStore(p, Kernel::step(vecLoad(p), vCoeffs[g], _state[g]));
+        p += kLanes;
+      }
+    }
+
+    // deinterleave the outputs.
+    DSPVectorArray<ROWS> output(kUninitialized);
+    for (int row = 0; row < ROWS; ++row)
+    {
+      const float* pLane = pInterleaved + row;
+      float* py = output.getRowData(row);
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        py[n] = pLane[n * kGroups * kLanes];
+      }
+    }
+    return output;
+  }
+
+  inline void clear()
+  {
+    for (int g = 0; g < kGroups; ++g)
+    {
+      for (int i = 0; i < Kernel::nState; ++i)
+      {
+        _state[g][i] = vecZeros();
+      }
+    }
+  }
+
+  // clear(row): zero the state of one voice, leaving the others running.
+  inline void clear(int row)
+  {
+    SIMDVectorFloat* s = _state[row / kLanes];
+    for (int i = 0; i < Kernel::nState; ++i)
+    {
+      SIMDVectorFloatUnion u;
+      u.v = s[i];
+      u.f[row % kLanes] = 0.f;
+      s[i] = u.v;
+    }
+  }
+
+  T& operator[](size_t n) { return _processors[n]; }
+};
+
+// ----------------------------------------------------------------
+// BlockIIR: runs a single recursive filter with SIMD by processing blocks of
+// kFloatsPerSIMDVector samples in state-space form. With state s, each block of
+// inputs x gives the outputs y = Hx + Os and the next state s' = Ps + Kx, where H
+// holds the filter's impulse response, O the response to each state variable,
+// P the state transition over the block and K the effect of each input on the
+// next state. Hx and Kx don't depend on s, so only the small product Ps is left
+// on the recursive path.
+// The matrices are made by running BankKernel<T>, so any filter with a kernel
+// can be used. They are only recomputed when the coefficients change.
+// As with InterleavedBank, coefficients are set on the processor and the state
+// is kept here.
+
+template <typename T>
+class BlockIIR
+{
+  using Kernel = BankKernel<T>;
+  static constexpr int kLanes = kFloatsPerSIMDVector;
+  static constexpr int kStates = Kernel::nState;
+  static constexpr int kBlocks = kFloatsPerDSPVector / kLanes;
+  static_assert(kStates < kLanes, "BlockIIR: too many state variables");
+
+  T _processor;
+  float _coeffs[Kernel::nCoeffs]{};
+  bool _valid{false};
+  float _state[kStates]{};
+
+  SIMDVectorFloat _impulse[kLanes];
+  SIMDVectorFloat _stateResponse[kStates];
+  SIMDVectorFloat _inputToState[kStates];
+  float _transition[kStates][kStates];
+
+  // get the block matrices by running the kernel once in each lane: lane 0 gets
+  // an impulse input, and lane i + 1 starts with state variable i set to 1.
+  void makeMatrices()
+  {
+    SIMDVectorFloat vCoeffs[Kernel::nCoeffs];
+    for (int i = 0; i < Kernel::nCoeffs; ++i)
+    {
+      vCoeffs[i] = vecSet1(_coeffs[i]);
+    }
+    SIMDVectorFloatUnion s[kStates]{};
+    for (int i = 0; i < kStates; ++i)
+    {
+      s[i].f[i + 1] = 1.f;
+    }
+    SIMDVectorFloat vs[kStates];
+    for (int i = 0; i < kStates; ++i)
+    {
+      vs[i] = s[i].v;
+    }
+
+    // the impulse response h and the state of lane 0 after each step.
+    float h[kLanes];
+    float impulseState[kLanes][kStates];
+    SIMDVectorFloatUnion stateResponse[kStates];
+    for (int n = 0; n < kLanes; ++n)
+    {
+      SIMDVectorFloatUnion x{};
+      x.f[0] = (n == 0) ? 1.f : 0.f;
+      SIMDVectorFloatUnion y;
+      y.v = Kernel::step(x.v, vCoeffs, vs);
+      h[n] = y.f[0];
+      for (int i = 0; i < kStates; ++i)
+      {
+        stateResponse[i].f[n] = y.f[i + 1];
+        s[i].v = vs[i];
+        impulseState[n][i] = s[i].f[0];
+      }
+    }
+
+    for (int j = 0; j < kLanes; ++j)
+    {
+      SIMDVectorFloatUnion column;
+      for (int n = 0; n < kLanes; ++n)
+      {
+        column.f[n] = (n >= j) ? h[n - j] : 0.f;
+      }
+      _impulse[j] = column.v;
+    }
+    for (int i = 0; i < kStates; ++i)
+    {
+      _stateResponse[i] = stateResponse[i].v;
+
+      // the input at sample j has kLanes - j steps to affect the next state.
+      SIMDVectorFloatUnion k;
+      for (int j = 0; j < kLanes; ++j)
+      {
+        k.f[j] = impulseState[kLanes - 1 - j][i];
+      }
+      _inputToState[i] = k.v;
+      for (int m = 0; m < kStates; ++m)
+      {
+        _transition[i][m] = s[i].f[m + 1];
+      }
+    }
+  }
+
+ public:
+  inline DSPVector operator()(const DSPVector& vx)
+  {
+    float c[Kernel::nCoeffs];
+    Kernel::getCoeffs(_processor, c);
+    if (!_valid || !std::equal(c, c + Kernel::nCoeffs, _coeffs))
+    {
+      std::copy(c, c + Kernel::nCoeffs, _coeffs);
+      makeMatrices();
+      _valid = true;
+    }
+
+    // get the zero-state output and the input's part of the next state for
+    // each block. The blocks are independent, so this can run in parallel.
+    DSPVector vy(kUninitialized);
+    float inputToState[kBlocks][kStates];
+    const float* px = vx.getConstBuffer();
+    float* py = vy.getBuffer();
+    for (int b = 0; b < kBlocks; ++b)
+    {
+      const float* pxb = px + b * kLanes;
+      SIMDVectorFloat acc0 = vecMul(_impulse[0], vecSet1(pxb[0]));
+      SIMDVectorFloat acc1 = vecMul(_impulse[1], vecSet1(pxb[1]));
+      for (int j = 2; j < kLanes; j += 2)
+      {
+        acc0 = vecFMA(_impulse[j], vecSet1(pxb[j]), acc0);
+        acc1 = vecFMA(_impulse[j + 1], vecSet1(pxb[j + 1]), acc1);
+      }
+      vecStore(py + b * kLanes, vecAdd(acc0, acc1));
+
+      SIMDVectorFloat xb = vecLoad(pxb);
+      for (int i = 0; i < kStates; ++i)
+      {
+        inputToState[b][i] = vecSumH(vecMul(_inputToState[i], xb));
+      }
+    }
+
+    // add the response to the state and advance the state through each block.
+    for (int b = 0; b < kBlocks; ++b)
+    {
+      float* pyb = py + b * kLanes;
+      SIMDVectorFloat y = vecLoad(pyb);
+      for (int i = 0; i < kStates; ++i)
+      {
+        y = vecFMA(_stateResponse[i], vecSet1(_state[i]), y);
+      }
+      vecStore(pyb, y);
+
+      float nextState[kStates];
+      for (int i = 0; i < kStates; ++i)
+      {
+        float si = inputToState[b][i];
+        for (int m = 0; m < kStates; ++m)
+        {
+          si = fma(_transition[i][m], _state[m], si);
+        }
+        nextState[i] = si;
+      }
+      std::copy(nextState, nextState + kStates, _state);
+    }
+    return vy;
+  }
+
+  inline void clear() { std::fill(_state, _state + kStates, 0.f); }
+
+  // clear(row): BlockIIR has one row, so this is the same as clear(). It lets
+  // BlockIIR stand in for a one-row InterleavedBank.
+  inline void clear(int) { clear(); }
+
+  T& processor() { return _processor; }
+};
+
+// ----------------------------------------------------------------
+// ModulatedFDN: a feedback delay network for reverberation, with SIZE delay
+// lines and OUTPUTS outputs.
+// Each vector, the outputs of all the lines are mixed by an orthogonal matrix,
+// lowpass filtered and scaled by the feedback gains, then added to the input
+// and fed back to the lines. MIXING selects the matrix: a Hadamard matrix,
+// applied as a fast butterfly in log2(SIZE) passes, or the Householder matrix
+// used by FDN. The mixing runs on whole rows, and the filters in an
+// InterleavedBank, so both use SIMD across the delay lines.
+// The delay lines are ModulatedDelays, and setModulation() sweeps each delay
+// time with a sine at a slightly different rate per line, to smooth out the
+// resonances of the network.
+// Output j is the sum of lines j, j + OUTPUTS, j + 2 * OUTPUTS ..., scaled by
+// sqrt(OUTPUTS / SIZE) so that the level does not depend on SIZE.
+// As with FDN, there is one DSPVector of latency in the feedback path, which
+// is subtracted from the delay times, so delay times must be longer than
+// kFloatsPerDSPVector.
+
+enum FDNMixing
+{
+  kHadamardMixing,
+  kHouseholderMixing
+};
+
+template <int SIZE, int OUTPUTS = 2, int MIXING = kHadamardMixing>
+class ModulatedFDN
+{
+  static_assert(MIXING != kHadamardMixing || (SIZE & (SIZE - 1)) == 0,
+                "ModulatedFDN: Hadamard mixing needs a power of two SIZE");
+  static_assert(OUTPUTS >= 1 && OUTPUTS <= SIZE, "ModulatedFDN: bad number of outputs");
+
+  std::array<ModulatedDelay<kCubicInterpolation>, SIZE> _delays;
+  InterleavedBank<OnePole, SIZE> _filters;
+  DSPVectorArray<SIZE> _delayInputs;
+  std::array<float, SIZE> _delayTimes{};
+
+  // LFO phase and its last value for each line.
+  float _modDepth{0.f};
+  std::array<float, SIZE> _lfoRates{};
+  std::array<float, SIZE> _lfoPhases{};
+  std::array<float, SIZE> _lfoValues{};
+
+ public:
+  // feedback gains array is public—just copy values to set.
+  std::array<float, SIZE> mFeedbackGains{{0}};
+
+  ModulatedFDN()
+  {
+    for (int n = 0; n < SIZE; ++n)
+    {
+      _filters[n].mCoeffs = OnePole::passthru();
+      _lfoPhases[n] = float(n) / SIZE;
+    }
+  }
+
+  // allocate each delay line to hold the given delay time plus any modulation.
+  // This allocates memory and is not for use in the audio thread.
+  void setMaxDelayInSamples(float d)
+  {
+    for (auto& delay : _delays)
+    {
+      delay.setMaxDelayInSamples(d);
+    }
+  }
+
+  // set the delay time of each line. If a line does not have room for its time
+  // plus the modulation depth, it is reallocated.
+  void setDelaysInSamples(std::array<float, SIZE> times)
+  {
+    _delayTimes = times;
+    allocateDelays();
+  }
+
+  // set the feedback gains for a decay of 60 dB in t60 samples. Call this after
+  // setDelaysInSamples().
+  void setDecayTimeInSamples(float t60)
+  {
+    for (int n = 0; n < SIZE; ++n)
+    {
+      mFeedbackGains[n] = powf(10.f, -3.f * _delayTimes[n] / t60);
+    }
+  }
+
+  void setFilterCutoffs(std::array<float, SIZE> omegas)
+  {
+    for (int n = 0; n < SIZE; ++n)
+    {
+      _filters[n].mCoeffs = OnePole::coeffs(omegas[n]);
+    }
+  }
+
+  // sweep each delay time by up to depth samples, at around omega cycles per
+  // sample.
+  void setModulation(float depth, float omega)
+  {
+    _modDepth = depth;
+    for (int n = 0; n < SIZE; ++n)
+    {
+      _lfoRates[n] = omega * (1.f + 0.5f * n / SIZE);
+    }
+    allocateDelays();
+  }
+
+  void clear()
+  {
+    for (auto& delay : _delays)
+    {
+      delay.clear();
+    }
+    _filters.clear();
+    _delayInputs = 0.f;
+  }
+
+  DSPVectorArray<OUTPUTS> operator()(const DSPVector x)
+  {
+    // run the delays, writing the inputs made in the last vector and reading
+    // the outputs for this one.
+    DSPVectorArray<SIZE> y(kUninitialized);
+    for (int n = 0; n < SIZE; ++n)
+    {
+      const float delayTime = _delayTimes[n] - kFloatsPerDSPVector;
+      _delays[n].write(_delayInputs.constRow(n));
+      if (_modDepth > 0.f)
+      {
+        float phase = _lfoPhases[n] + _lfoRates[n] * kFloatsPerDSPVector;
+        phase -= floorf(phase);
+        _lfoPhases[n] = phase;
+        const float lfo = sinf(kTwoPi * phase) * _modDepth;
+        y.row(n) = _delays[n].read(
+            interpolateDSPVectorLinear(delayTime + _lfoValues[n], delayTime + lfo));
+        _lfoValues[n] = lfo;
+      }
+      else
+      {
+        y.row(n) = _delays[n].read(delayTime);
+      }
+    }
+
+    // sum the outputs.
+    DSPVectorArray<OUTPUTS> outputs;
+    for (int n = 0; n < SIZE; ++n)
+    {
+      outputs.row(n % OUTPUTS) += y.constRow(n);
+    }
+    outputs *= DSPVectorArray<OUTPUTS>(sqrtf(float(OUTPUTS) / SIZE));
+
+    // mix, filter and scale the feedback, and add the input.
+    mix(y);
+    y = _filters(y);
+    const float mixGain = (MIXING == kHadamardMixing) ? 1.f / sqrtf(float(SIZE)) : 1.f;
+    const float* px = x.getConstBuffer();
+    for (int n = 0; n < SIZE; ++n)
+    {
+      const SIMDVectorFloat g = vecSet1(mFeedbackGains[n] * mixGain);
+      const float* py = y.getRowDataConst(n);
+      float* pIn = _delayInputs.getRowData(n);
+      for (int i = 0; i < kFloatsPerDSPVector; i += kFloatsPerSIMDVector)
+      {
+        vecStore(pIn + i, vecFMA(g, vecLoad(py + i), vecLoad(px + i)));
+      }
+    }
+    return outputs;
+  }
+
+ private:
+  void allocateDelays()
+  {
+    for (int n = 0; n < SIZE; ++n)
+    {
+      const float maxDelay = _delayTimes[n] + _modDepth;
+      if (_delays[n].getMaxDelayInSamples() < maxDelay)
+      {
+        _delays[n].setMaxDelayInSamples(maxDelay);
+      }
+    }
+  }
+
+  // multiply the rows by the mixing matrix, in place. The Hadamard butterfly
+  // leaves out the normalization by 1 / sqrt(SIZE), which is applied with the
+  // feedback gains.
+  static void mix(DSPVectorArray<SIZE>& y)
+  {
+    if (MIXING == kHadamardMixing)
+    {
+      for (int h = 1; h < SIZE; h *= 2)
+      {
+        for (int i = 0; i < SIZE; i += h * 2)
+        {
+          for (int j = i; j < i + h; ++j)
+          {
+            float* pa = y.getRowData(j);
+            float* pb = y.getRowData(j + h);
+            for (int k = 0; k < kFloatsPerDSPVector; k += kFloatsPerSIMDVector)
+            {
+              const SIMDVectorFloat a = vecLoad(pa + k);
+              const SIMDVectorFloat b = vecLoad(pb + k);
+              vecStore(pa + k, vecAdd(a, b));
+              vecStore(pb + k, vecSub(a, b));
+            }
+          }
+        }
+      }
+    }
+    else
+    {
+      // the Householder matrix is the identity minus 2 / SIZE times the sum.
+      DSPVector sum;
+      for (int n = 0; n < SIZE; ++n)
+      {
+        sum += y.constRow(n);
+      }
+      sum *= DSPVector(2.0f / SIZE);
+      for (int n = 0; n < SIZE; ++n)
+      {
+        y.row(n) -= sum;
+      }
+    }
+  }
+};
+
 }  // namespace ml
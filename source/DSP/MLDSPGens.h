@@ -20,27 +20,51 @@
 
 namespace ml
 {
+// accumulate a 32-bit phase, where 2^32 steps make one cycle, from the frequency
+// input in cycles per sample. Returns the phase after each sample and updates
+// omega32 to the last one. The phase wraps at the end of each cycle.
+// Only the fraction of a cycle in each step moves the phase, which is taken
+// from the nearest whole number of cycles so that the step fits in an int for
+// any frequency, including negative ones and ones of 0.5 cycles per sample or
+// more.
+inline DSPVectorInt accumulatePhase(const DSPVector cyclesPerSample, uint32_t& omega32)
+{
+  constexpr float kStepsPerCycle{static_cast<float>(const_math::pow(2., 32))};
+  DSPVector wholeCycles = intToFloat(roundFloatToInt(cyclesPerSample));
+  DSPVectorInt intStepsPerSampleV =
+      roundFloatToInt((cyclesPerSample - wholeCycles) * DSPVector(kStepsPerCycle));
+  DSPVectorInt omega32V = inclusiveScan(intStepsPerSampleV, omega32);
+  omega32 = omega32V[kIntsPerDSPVector - 1];
+  return omega32V;
+}
+
+// true if the phase from accumulatePhase() passed the end of a cycle going
+// from omegaPrev to omega. At a positive frequency, the phase wraps when it
+// decreases, and at one cycle per sample or more it wraps every sample. At
+// negative frequencies the phase runs backwards and never passes the end of
+// a cycle.
+inline bool phaseWrapped(uint32_t omega, uint32_t omegaPrev, float cyclesPerSample)
+{
+  return (cyclesPerSample > 0.f) && ((omega < omegaPrev) || (cyclesPerSample >= 1.f));
+}
+
 // generate a single-sample tick, repeating at a frequency given by the input.
 class TickGen
 {
-  float mOmega{0};
+  uint32_t mOmega32{0};
 
  public:
   inline DSPVector operator()(const DSPVector cyclesPerSample)
   {
-    // calculate counter delta per sample
-    DSPVector stepsPerSampleV = cyclesPerSample;
-
-    // accumulate phase and wrap to generate ticks
-    DSPVector vy{0.f};
+    // accumulate phase and generate a tick at each wrap
+    uint32_t omegaPrev = mOmega32;
+    DSPVectorInt omega32V = accumulatePhase(cyclesPerSample, mOmega32);
+    DSPVector vy(kUninitialized);
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
-      mOmega += stepsPerSampleV[n];
-      if (mOmega > 1.0f)
-      {
-        mOmega -= 1.0f;
-        vy[n] = 1.0f;
-      }
+      uint32_t omega = omega32V[n];
+      vy[n] = phaseWrapped(omega, omegaPrev, cyclesPerSample[n]) ? 1.0f : 0.f;
+      omegaPrev = omega;
     }
     return vy;
   }
@@ -58,8 +82,9 @@ class ImpulseGen
   static_assert(kTableSize < kFloatsPerDSPVector,
                 "ImpulseGen: table size must be < the DSP vector size.");
 
-  int _outputCounter;
-  float _omega{0.f};
+  // start with an impulse at the first sample.
+  int _outputCounter{0};
+  uint32_t _omega32{0};
 
  public:
   ImpulseGen()
@@ -81,17 +106,18 @@ class ImpulseGen
   inline DSPVector operator()(const DSPVector cyclesPerSample)
   {
     // accumulate phase and wrap to generate ticks
+    uint32_t omegaPrev = _omega32;
+    DSPVectorInt omega32V = accumulatePhase(cyclesPerSample, _omega32);
     DSPVector vy{0.f};
     for (int n = 0; n < kFloatsPerDSPVector; ++n)
     {
-      _omega += cyclesPerSample[n];
-      if (_omega > 1.0f)
+      uint32_t omega = omega32V[n];
+      if (phaseWrapped(omega, omegaPrev, cyclesPerSample[n]))
       {
-        _omega -= 1.0f;
-
         // start an output impulse
         _outputCounter = 0;
       }
+      omegaPrev = omega;
 
       if (_outputCounter < kTableSize)
       {
@@ -103,9 +129,30 @@ class ImpulseGen
   }
 };
 
+// multiplier and increment that advance NoiseGen's generator by n + 1 steps.
+constexpr int noiseJumpMultiplier(int n)
+{
+  uint32_t m = 1;
+  for (int i = 0; i <= n; ++i)
+  {
+    m *= 0x0019660D;
+  }
+  return static_cast<int>(m);
+}
+
+constexpr int noiseJumpIncrement(int n)
+{
+  uint32_t a = 0;
+  for (int i = 0; i <= n; ++i)
+  {
+    a = a * 0x0019660D + 0x3C6EF35F;
+  }
+  return static_cast<int>(a);
+}
+
 // generate a random number from -1 to 1 every sample.
 // NOTE: this will create more energy at higher sample rates!
-// TODO make proper pink noise, white noise gens
+// For many voices of noise, or for pink or Gaussian noise, see WhiteNoiseGen etc.
 class NoiseGen
 {
  public:
@@ -128,16 +175,36 @@ class NoiseGen
     return (*reinterpret_cast<float*>(&temp)) * 2.f - 3.f;
   }
 
-  // TODO SIMD
   inline DSPVector operator()()
   {
-    DSPVector y;
-    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    // the seed after n + 1 steps is mSeed * noiseJumpMultiplier(n) +
+    // noiseJumpIncrement(n), so all the seeds for the vector can be made at once.
+    // This is done in one pass over the SIMD vectors to keep the seeds in registers.
+    static const DSPVectorInt kMultipliers{noiseJumpMultiplier};
+    static const DSPVectorInt kIncrements{noiseJumpIncrement};
+    const float* pMul = kMultipliers.getConstBuffer();
+    const float* pInc = kIncrements.getConstBuffer();
+    const SIMDVectorInt seed = vecSetInt1(mSeed);
+    const SIMDVectorInt mantissaMask = vecSetInt1(0x007FFFFF);
+    const SIMDVectorInt one = vecSetInt1(0x3F800000);
+
+    DSPVector y(kUninitialized);
+    float* py = y.getBuffer();
+    for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
     {
-      step();
-      uint32_t temp = ((mSeed >> 9) & 0x007FFFFF) | 0x3F800000;
-      y[i] = (*reinterpret_cast<float*>(&temp)) * 2.f - 3.f;
+      SIMDVectorInt seeds =
+          vecAddInt(vecMulInt(VecF2I(vecLoad(pMul)), seed), VecF2I(vecLoad(pInc)));
+
+      // make floats in [1, 2) from the high bits of each seed, then scale to [-1, 1).
+      SIMDVectorInt bits = vecOrInt(vecAndInt(vecShiftRightInt32(seeds, 9), mantissaMask), one);
+      vecStore(py, vecFMA(VecI2F(bits), vecSet1(2.f), vecSet1(-3.f)));
+      pMul += kIntsPerSIMDVector;
+      pInc += kIntsPerSIMDVector;
+      py += kFloatsPerSIMDVector;
     }
+    constexpr uint32_t kVectorMultiplier = noiseJumpMultiplier(kIntsPerDSPVector - 1);
+    constexpr uint32_t kVectorIncrement = noiseJumpIncrement(kIntsPerDSPVector - 1);
+    mSeed = mSeed * kVectorMultiplier + kVectorIncrement;
     return y;
   }
 
@@ -147,6 +214,155 @@ class NoiseGen
   uint32_t mSeed = 0;
 };
 
+// ----------------------------------------------------------------
+// multi-voice noise generators.
+//
+// WhiteNoiseGen makes ROWS voices of uniform noise from -1 to 1. Each voice runs
+// an independent xorshift32 generator in each SIMD lane, so every step makes
+// kFloatsPerSIMDVector consecutive samples of one voice. The rows are stepped
+// together so that their generators can overlap.
+//
+// setSeed(seed) seeds all the voices from one number, and setSeed(row, seed)
+// seeds one voice. A voice gets the same output from the same seed whatever
+// the other voices are doing. The sequence depends on the SIMD vector width,
+// so it is repeatable on one platform, but not between SSE and AVX builds.
+
+// MurmurHash3's finalizer, for spreading seeds over the generator states.
+constexpr uint32_t mixNoiseSeed(uint32_t x)
+{
+  x ^= x >> 16;
+  x *= 0x85EBCA6B;
+  x ^= x >> 13;
+  x *= 0xC2B2AE35;
+  x ^= x >> 16;
+  return x;
+}
+
+template <int ROWS = 1>
+class WhiteNoiseGen
+{
+  static constexpr int kLanes = kIntsPerSIMDVector;
+  SIMDVectorInt _state[ROWS];
+
+ public:
+  explicit WhiteNoiseGen(uint32_t seed = 0) { setSeed(seed); }
+
+  void setSeed(uint32_t seed)
+  {
+    for (int row = 0; row < ROWS; ++row)
+    {
+      setSeed(row, seed + row);
+    }
+  }
+
+  void setSeed(int row, uint32_t seed)
+  {
+    // xorshift never leaves the zero state, so avoid it.
+    SIMDVectorIntUnion u;
+    for (int i = 0; i < kLanes; ++i)
+    {
+      uint32_t x = mixNoiseSeed(seed + 0x9E3779B9 * (i + 1));
+      u.i[i] = x ? x : 1;
+    }
+    _state[row] = u.v;
+  }
+
+  inline DSPVectorArray<ROWS> operator()()
+  {
+    const SIMDVectorInt mantissaMask = vecSetInt1(0x007FFFFF);
+    const SIMDVectorInt one = vecSetInt1(0x3F800000);
+
+    DSPVectorArray<ROWS> y(kUninitialized);
+    for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+    {
+      for (int row = 0; row < ROWS; ++row)
+      {
+        SIMDVectorInt x = _state[row];
+        x = vecXorInt(x, vecShiftLeftInt32(x, 13));
+        x = vecXorInt(x, vecShiftRightInt32(x, 17));
+        x = vecXorInt(x, vecShiftLeftInt32(x, 5));
+        _state[row] = x;
+
+        // make floats in [1, 2) from the high bits of each state, then scale to [-1, 1).
+        SIMDVectorInt bits = vecOrInt(vecAndInt(vecShiftRightInt32(x, 9), mantissaMask), one);
+        vecStore(y.getRowData(row) + n * kFloatsPerSIMDVector,
+                 vecFMA(VecI2F(bits), vecSet1(2.f), vecSet1(-3.f)));
+      }
+    }
+    return y;
+  }
+};
+
+// GaussianNoiseGen makes ROWS voices of noise with a normal distribution, mean 0
+// and variance 1, from pairs of uniform voices with the Box-Muller transform.
+
+template <int ROWS = 1>
+class GaussianNoiseGen
+{
+  WhiteNoiseGen<ROWS * 2> _uniform;
+
+ public:
+  explicit GaussianNoiseGen(uint32_t seed = 0) { setSeed(seed); }
+
+  void setSeed(uint32_t seed)
+  {
+    for (int row = 0; row < ROWS; ++row)
+    {
+      setSeed(row, seed + row);
+    }
+  }
+
+  void setSeed(int row, uint32_t seed)
+  {
+    _uniform.setSeed(row * 2, seed);
+    _uniform.setSeed(row * 2 + 1, ~seed);
+  }
+
+  inline DSPVectorArray<ROWS> operator()()
+  {
+    DSPVectorArray<ROWS * 2> u = _uniform();
+    DSPVectorArray<ROWS> y(kUninitialized);
+    for (int row = 0; row < ROWS; ++row)
+    {
+      // map the first voice to (0, 1] so that log is finite, and the second to an
+      // angle in [-pi, pi).
+      DSPVector u1 = 0.5f - lazy(u.constRow(row * 2)) * 0.5f;
+      DSPVector r = sqrt(log(u1) * DSPVector(-2.f));
+      y.row(row) = r * cos(u.constRow(row * 2 + 1) * DSPVector(kPi));
+    }
+    return y;
+  }
+};
+
+// PinkNoiseGen makes ROWS voices of pink noise by filtering white noise with
+// PinkFilter. Each voice has roughly the same RMS level as WhiteNoiseGen.
+
+template <int ROWS = 1>
+class PinkNoiseGen
+{
+  using Filters = typename std::conditional<ROWS == 1, BlockIIR<PinkFilter>,
+                                            InterleavedBank<PinkFilter, ROWS>>::type;
+
+  WhiteNoiseGen<ROWS> _white;
+  Filters _filters;
+
+ public:
+  explicit PinkNoiseGen(uint32_t seed = 0) { setSeed(seed); }
+
+  void setSeed(uint32_t seed)
+  {
+    _white.setSeed(seed);
+    _filters.clear();
+  }
+  void setSeed(int row, uint32_t seed)
+  {
+    _white.setSeed(row, seed);
+    _filters.clear(row);
+  }
+
+  inline DSPVectorArray<ROWS> operator()() { return _filters(_white()); }
+};
+
 // super slow + accurate sine generator for testing
 class TestSineGen
 {
@@ -157,7 +373,7 @@ class TestSineGen
 
   DSPVector operator()(const DSPVector freq)
   {
-    DSPVector vy;
+    DSPVector vy(kUninitialized);
 
     for (int i = 0; i < kFloatsPerDSPVector; ++i)
     {
@@ -191,12 +407,8 @@ public:
     DSPVectorInt intStepsPerSampleV = roundFloatToInt(stepsPerSampleV);
     
     // accumulate 32-bit phase with wrap
-    DSPVectorInt omega32V;
-    for (int n = 0; n < kIntsPerDSPVector; ++n)
-    {
-      mOmega32 += intStepsPerSampleV[n];
-      omega32V[n] = mOmega32;
-    }
+    DSPVectorInt omega32V = inclusiveScan(intStepsPerSampleV, mOmega32);
+    mOmega32 = omega32V[kIntsPerDSPVector - 1];
     
     // convert counter to float output range
     return unsignedIntToFloat(omega32V) * DSPVector(cyclesPerStep);
@@ -239,17 +451,24 @@ public:
     
     // accumulate 32-bit phase with wrap
     // we test for wrap at every sample to get a clean ending
-    DSPVectorInt omega32V;
+    DSPVectorInt omega32V = mGate ? inclusiveScan(intStepsPerSampleV, mOmega32)
+                                  : DSPVectorInt(mOmega32);
     for (int n = 0; n < kIntsPerDSPVector; ++n)
     {
-      mOmega32 += intStepsPerSampleV[n]*mGate;
-      if(mOmega32 < mOmegaPrev)
+      uint32_t omega = omega32V[n];
+      if (omega < mOmegaPrev)
       {
+        // the ramp is over, so output start from here to the end of the vector.
         mGate = 0;
-        mOmega32 = start;
+        for (int m = n; m < kIntsPerDSPVector; ++m)
+        {
+          omega32V[m] = start;
+        }
+        break;
       }
-      omega32V[n] = mOmegaPrev = mOmega32;
+      mOmegaPrev = omega;
     }
+    mOmega32 = mOmegaPrev = omega32V[kIntsPerDSPVector - 1];
     // convert counter to float output range
     return unsignedIntToFloat(omega32V) * DSPVector(cyclesPerStep);
   }
@@ -280,7 +499,7 @@ public:
 // bandlimited step function for reducing aliasing.
 static DSPVector polyBLEP(const DSPVector phase, const DSPVector freq)
 {
-  DSPVector blep;
+  DSPVector blep(kUninitialized);
 
   for (int n = 0; n < kFloatsPerDSPVector; ++n)
   {
@@ -323,14 +542,14 @@ inline DSPVector phasorToSine(DSPVector phasorV)
   DSPVector oneSixthV(1.0f / 6.f);
 
   // scale and offset input phasor on (0, 1) to sine approx domain (-sqrt(2), 3*sqrt(2))
-  DSPVector omegaV = phasorV * (domainScaleV) + (domainOffsetV);
+  DSPVector omegaV = lazy(phasorV) * domainScaleV + domainOffsetV;
 
   // reverse upper half of phasor to get triangle
   // equivalent to: if (phasor > 0) x = flipOffset - fOmega; else x = fOmega;
   DSPVector triangleV = select(flipOffsetV - omegaV, omegaV, greaterThan(omegaV, DSPVector(sqrt2)));
 
   // convert triangle to sine approx.
-  return scaleV * triangleV * (oneV - triangleV * triangleV * oneSixthV);
+  return lazy(scaleV) * triangleV * (oneV - lazy(triangleV) * triangleV * oneSixthV);
 }
 
 // input: phasor on (0, 1), normalized freq, pulse width
@@ -347,7 +566,7 @@ inline DSPVector phasorToPulse(DSPVector omegaV, DSPVector freqV, DSPVector puls
   pulseV += polyBLEP(omegaV, freqV);
 
   // subtract blep for down-going transition
-  DSPVector omegaVDown = fractionalPart(omegaV - pulseWidthV + DSPVector(1.0f));
+  DSPVector omegaVDown = fractionalPart(lazy(omegaV) - pulseWidthV + 1.0f);
   pulseV -= polyBLEP(omegaVDown, freqV);
 
   return pulseV;
@@ -357,11 +576,9 @@ inline DSPVector phasorToPulse(DSPVector omegaV, DSPVector freqV, DSPVector puls
 // output: antialiased saw on (-1, 1)
 inline DSPVector phasorToSaw(DSPVector omegaV, DSPVector freqV)
 {
-  // scale phasor to saw range (-1, 1)
-  DSPVector sawV = omegaV * DSPVector(2.f) - DSPVector(1.f);
-
-  // subtract BLEP from saw to smooth down-going transition
-  return sawV - polyBLEP(omegaV, freqV);
+  // scale phasor to saw range (-1, 1), and subtract BLEP from saw to smooth
+  // down-going transition
+  return lazy(omegaV) * 2.f - 1.f - polyBLEP(omegaV, freqV);
 }
 
 // these antialiased waveform generators use a PhasorGen and the functions above.
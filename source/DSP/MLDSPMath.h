@@ -4,14 +4,40 @@
 
 #pragma once
 
-// Here is the DSP vector size, an important constant.
-constexpr size_t kFloatsPerDSPVectorBits = 6;
+// Here is the DSP vector size, an important constant. It defaults to 64 and can
+// be set to 32, 64, 128 or 256 by defining ML_DSP_VECTOR_SIZE, normally through
+// the ML_DSP_VECTOR_SIZE CMake option. Like the SIMD backend, it must be the
+// same for every translation unit in a program.
+#ifndef ML_DSP_VECTOR_SIZE
+#define ML_DSP_VECTOR_SIZE 64
+#endif
+
+constexpr size_t kFloatsPerDSPVectorBits = (ML_DSP_VECTOR_SIZE == 32)    ? 5
+                                           : (ML_DSP_VECTOR_SIZE == 64)  ? 6
+                                           : (ML_DSP_VECTOR_SIZE == 128) ? 7
+                                           : (ML_DSP_VECTOR_SIZE == 256) ? 8
+                                                                         : 0;
+static_assert(kFloatsPerDSPVectorBits != 0, "ML_DSP_VECTOR_SIZE must be 32, 64, 128 or 256.");
 constexpr size_t kFloatsPerDSPVector = 1 << kFloatsPerDSPVectorBits;
 
 // Load definitions for low-level SIMD math.
 // These must define SIMDVectorFloat, SIMDVectorInt, their sizes, and a bunch of
-// operations on them. We are currently only using 4-element vectors on both SSE
-// and NEON.
+// operations on them. By default we use 4-element vectors on both SSE and NEON.
+// On x86, wider backends can be selected at compile time by defining
+// ML_SIMD_AVX2 (8 floats) or ML_SIMD_AVX512 (16 floats), normally through the
+// ML_SIMD CMake option. Because the vector types and DSPVector alignment depend
+// on the backend, the choice must be the same for every translation unit in a
+// program.
+//
+// AVX2 and AVX-512 builds are per-machine binaries: they run only on CPUs with
+// those instructions. Such a program checks the CPU when it starts, with
+// cpuSupportsSIMDBackend(), and stops with a message if the check fails.
+//
+// A binary for every x86 machine uses the default SSE2 backend, and all of its
+// operations on DSPVectors run 4 floats wide. Only the sin, cos, log and exp
+// kernels, and the log2, exp2 and pow made from them, are dispatched at runtime
+// to the widest vector size the CPU supports. That happens on x86-64 Linux with
+// GCC or Clang only. See MLDSPMathDispatch.h.
 
 #if (defined __ARM_NEON) || (defined __ARM_NEON__)
 
@@ -20,6 +46,18 @@ constexpr size_t kFloatsPerDSPVector = 1 << kFloatsPerDSPVectorBits;
 #define ML_SSE_TO_NEON
 #include "MLDSPMathNEON.h"
 
+#elif defined(ML_SIMD_AVX512)
+
+// AVX-512
+
+#include "MLDSPMathAVX512.h"
+
+#elif defined(ML_SIMD_AVX2)
+
+// AVX2
+
+#include "MLDSPMathAVX.h"
+
 #else
 
 // SSE2
@@ -28,6 +66,73 @@ constexpr size_t kFloatsPerDSPVector = 1 << kFloatsPerDSPVectorBits;
 
 #endif
 
+#include "MLDSPMathDispatch.h"
+
+#if (defined(ML_SIMD_AVX2) || defined(ML_SIMD_AVX512))
+#include <cstdio>
+#include <cstdlib>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// Returns true if the CPU we are running on can execute the SIMD backend
+// selected at compile time. Always true for the SSE2 and NEON baselines.
+inline bool cpuSupportsSIMDBackend()
+{
+#if defined(ML_SIMD_AVX2) || defined(ML_SIMD_AVX512)
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuidex(info, 1, 0);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool fma = (info[2] & (1 << 12)) != 0;
+  if (!osxsave || !fma) return false;
+  const unsigned long long xcr0 = _xgetbv(0);
+  if ((xcr0 & 0x6) != 0x6) return false;
+  __cpuidex(info, 7, 0);
+  const bool avx2 = (info[1] & (1 << 5)) != 0;
+#if defined(ML_SIMD_AVX512)
+  const bool avx512f = (info[1] & (1 << 16)) != 0;
+  return avx2 && avx512f && ((xcr0 & 0xe6) == 0xe6);
+#else
+  return avx2;
+#endif
+#else
+  __builtin_cpu_init();
+#if defined(ML_SIMD_AVX512)
+  return __builtin_cpu_supports("avx512f");
+#else
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#endif
+#else
+  return true;
+#endif
+}
+
+#if defined(ML_SIMD_AVX2) || defined(ML_SIMD_AVX512)
+// stop with a message if the CPU can't run the backend. This runs when the
+// program is loaded, through the initialization of kSIMDBackendChecked, before
+// any DSP code can reach an illegal instruction.
+inline bool checkSIMDBackend()
+{
+  if (!cpuSupportsSIMDBackend())
+  {
+#if defined(ML_SIMD_AVX512)
+    const char* backend = "AVX-512";
+#else
+    const char* backend = "AVX2 and FMA";
+#endif
+    fprintf(stderr, "madronalib: this program was built for %s, which this CPU does not support.\n",
+            backend);
+    abort();
+  }
+  return true;
+}
+
+inline const bool kSIMDBackendChecked = checkSIMDBackend();
+#endif
+
 // A C++11 implementation of std::integer_sequence from C++14
 // Copyright Jonathan Wakely 2012-2013
 // Distributed under the Boost Software License, Version 1.0.
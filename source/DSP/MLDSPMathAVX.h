@@ -0,0 +1,326 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPMathAVX.h
+// AVX2 implementations of madronalib SIMD primitives, 8 floats wide.
+// Selected by defining ML_SIMD_AVX2 and compiling with AVX2 enabled.
+
+#pragma once
+
+#include "MLPlatform.h"
+
+#include <immintrin.h>
+
+#include <float.h>
+#include <stdint.h>
+
+#include <iostream>
+
+#ifndef __AVX2__
+#error "MLDSPMathAVX.h: ML_SIMD_AVX2 is defined but the compiler is not targeting AVX2."
+#endif
+
+// AVX types
+typedef __m256 SIMDVectorFloat;
+typedef __m256i SIMDVectorInt;
+
+// AVX casts
+#define VecF2I _mm256_castps_si256
+#define VecI2F _mm256_castsi256_ps
+
+constexpr int kFloatsPerSIMDVectorBits = 3;
+constexpr int kFloatsPerSIMDVector = 1 << kFloatsPerSIMDVectorBits;
+constexpr int kSIMDVectorsPerDSPVector = kFloatsPerDSPVector / kFloatsPerSIMDVector;
+constexpr int kBytesPerSIMDVector = kFloatsPerSIMDVector * sizeof(float);
+constexpr int kSIMDVectorMask = ~(kBytesPerSIMDVector - 1);
+
+constexpr int kIntsPerSIMDVectorBits = 3;
+constexpr int kIntsPerSIMDVector = 1 << kIntsPerSIMDVectorBits;
+
+constexpr const char* kSIMDBackendName = "AVX2";
+
+inline bool isSIMDAligned(float* p)
+{
+  uintptr_t pM = (uintptr_t)p;
+  return ((pM & kSIMDVectorMask) == 0);
+}
+
+// primitive AVX operations
+#define vecAdd _mm256_add_ps
+#define vecSub _mm256_sub_ps
+#define vecMul _mm256_mul_ps
+#define vecDiv _mm256_div_ps
+#define vecDivApprox(x1, x2) (_mm256_mul_ps(x1, _mm256_rcp_ps(x2)))
+#define vecMin _mm256_min_ps
+#define vecMax _mm256_max_ps
+
+// fused multiply-add: vecFMA(a, b, c) = a*b + c, vecFMS(a, b, c) = a*b - c.
+// AVX2 machines all have FMA3, but only use it when the compiler targets it.
+#ifdef __FMA__
+#define vecFMA _mm256_fmadd_ps
+#define vecFMS _mm256_fmsub_ps
+#else
+#define vecFMA(x1, x2, x3) _mm256_add_ps(_mm256_mul_ps(x1, x2), x3)
+#define vecFMS(x1, x2, x3) _mm256_sub_ps(_mm256_mul_ps(x1, x2), x3)
+#endif
+
+#define vecSqrt _mm256_sqrt_ps
+#define vecSqrtApprox(x) (vecMul(x, vecRSqrt(x)))
+#define vecRSqrt _mm256_rsqrt_ps
+#define vecAbs(x) (_mm256_andnot_ps(_mm256_set1_ps(-0.0f), x))
+
+#define vecSign(x)                                                                         \
+  (_mm256_and_ps(_mm256_or_ps(_mm256_and_ps(_mm256_set1_ps(-0.0f), x), _mm256_set1_ps(1.0f)), \
+                 vecNotEqual(_mm256_set1_ps(-0.0f), x)))
+
+#define vecSignBit(x) (_mm256_or_ps(_mm256_and_ps(_mm256_set1_ps(-0.0f), x), _mm256_set1_ps(1.0f)))
+#define vecClamp(x1, x2, x3) _mm256_min_ps(_mm256_max_ps(x1, x2), x3)
+#define vecWithin(x1, x2, x3) _mm256_and_ps(vecGreaterThanOrEqual(x1, x2), vecLessThan(x1, x3))
+
+// comparisons use the same predicates as the SSE compare instructions.
+#define vecEqual(x1, x2) _mm256_cmp_ps(x1, x2, _CMP_EQ_OQ)
+#define vecNotEqual(x1, x2) _mm256_cmp_ps(x1, x2, _CMP_NEQ_UQ)
+#define vecGreaterThan(x1, x2) _mm256_cmp_ps(x1, x2, _CMP_GT_OS)
+#define vecGreaterThanOrEqual(x1, x2) _mm256_cmp_ps(x1, x2, _CMP_GE_OS)
+#define vecLessThan(x1, x2) _mm256_cmp_ps(x1, x2, _CMP_LT_OS)
+#define vecLessThanOrEqual(x1, x2) _mm256_cmp_ps(x1, x2, _CMP_LE_OS)
+
+#define vecSet1 _mm256_set1_ps
+
+// low-level store and load a vector to/from a float*.
+// the pointer must be aligned or the program will crash!
+#define vecStore _mm256_store_ps
+#define vecLoad _mm256_load_ps
+
+#define vecStoreUnaligned _mm256_storeu_ps
+#define vecLoadUnaligned _mm256_loadu_ps
+
+#define vecAnd _mm256_and_ps
+#define vecAndNot _mm256_andnot_ps
+#define vecOr _mm256_or_ps
+#define vecXor _mm256_xor_ps
+
+#define vecZeros _mm256_setzero_ps
+#define vecOnes() VecI2F(_mm256_set1_epi32(-1))
+
+#define vecFloatToIntRound _mm256_cvtps_epi32
+#define vecFloatToIntTruncate _mm256_cvttps_epi32
+#define vecIntToFloat _mm256_cvtepi32_ps
+
+// _mm256_cvtepi32_ps approximation for unsigned int data
+// this loses a bit of precision
+inline SIMDVectorFloat vecUnsignedIntToFloat(SIMDVectorInt v)
+{
+  __m256i v_hi = _mm256_srli_epi32(v, 1);
+  __m256 v_hi_flt = _mm256_cvtepi32_ps(v_hi);
+  return _mm256_add_ps(v_hi_flt, v_hi_flt);
+}
+
+#define vecAddInt _mm256_add_epi32
+#define vecSubInt _mm256_sub_epi32
+#define vecSet1Int _mm256_set1_epi32
+#define vecAndInt _mm256_and_si256
+#define vecAndNotInt _mm256_andnot_si256
+#define vecEqualInt _mm256_cmpeq_epi32
+#define vecShiftLeftInt32 _mm256_slli_epi32
+#define vecShiftRightInt32 _mm256_srli_epi32
+
+typedef union
+{
+  SIMDVectorFloat v;
+  float f[8];
+} SIMDVectorFloatUnion;
+
+typedef union
+{
+  SIMDVectorInt v;
+  uint32_t i[8];
+} SIMDVectorIntUnion;
+
+inline SIMDVectorInt vecSetInt1(uint32_t a) { return _mm256_set1_epi32(a); }
+
+inline std::ostream& operator<<(std::ostream& out, SIMDVectorFloat v)
+{
+  SIMDVectorFloatUnion u;
+  u.v = v;
+  out << "[";
+  for (int i = 0; i < kFloatsPerSIMDVector; ++i)
+  {
+    out << u.f[i];
+    if (i < kFloatsPerSIMDVector - 1) out << ", ";
+  }
+  out << "]";
+  return out;
+}
+
+inline std::ostream& operator<<(std::ostream& out, SIMDVectorInt v)
+{
+  SIMDVectorIntUnion u;
+  u.v = v;
+  out << "[";
+  for (int i = 0; i < kIntsPerSIMDVector; ++i)
+  {
+    out << u.i[i];
+    if (i < kIntsPerSIMDVector - 1) out << ", ";
+  }
+  out << "]";
+  return out;
+}
+
+// ----------------------------------------------------------------
+#pragma mark select
+
+inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b, SIMDVectorInt conditionMask)
+{
+  return _mm256_blendv_ps(b, a, VecI2F(conditionMask));
+}
+
+inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b, SIMDVectorFloat conditionMask)
+{
+  return _mm256_blendv_ps(b, a, conditionMask);
+}
+
+inline SIMDVectorInt vecSelect(SIMDVectorInt a, SIMDVectorInt b, SIMDVectorInt conditionMask)
+{
+  return _mm256_blendv_epi8(b, a, conditionMask);
+}
+
+// ----------------------------------------------------------------
+// int32 operations
+// unsigned compares flip the sign bits and use the signed compares.
+
+#define vecMulInt _mm256_mullo_epi32
+#define vecOrInt _mm256_or_si256
+#define vecXorInt _mm256_xor_si256
+#define vecGreaterThanInt _mm256_cmpgt_epi32
+#define vecLessThanInt(x1, x2) _mm256_cmpgt_epi32(x2, x1)
+#define vecShiftRightArithmeticInt32 _mm256_srai_epi32
+#define vecMinInt _mm256_min_epi32
+#define vecMaxInt _mm256_max_epi32
+#define vecMinUInt _mm256_min_epu32
+#define vecMaxUInt _mm256_max_epu32
+
+inline SIMDVectorInt vecGreaterThanUInt(SIMDVectorInt a, SIMDVectorInt b)
+{
+  const __m256i signBit = _mm256_set1_epi32(0x80000000);
+  return _mm256_cmpgt_epi32(_mm256_xor_si256(a, signBit), _mm256_xor_si256(b, signBit));
+}
+
+inline SIMDVectorInt vecLessThanUInt(SIMDVectorInt a, SIMDVectorInt b)
+{
+  return vecGreaterThanUInt(b, a);
+}
+
+// ----------------------------------------------------------------
+// gather: load base[indices[i]] into each lane i.
+
+inline SIMDVectorFloat vecGather(const float* base, SIMDVectorInt indices)
+{
+  return _mm256_i32gather_ps(base, indices, 4);
+}
+
+// ----------------------------------------------------------------
+// horizontal operations returning float
+
+inline float vecSumH(SIMDVectorFloat v)
+{
+  __m128 x = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  __m128 tmp0 = _mm_add_ps(x, _mm_movehl_ps(x, x));
+  __m128 tmp1 = _mm_add_ss(tmp0, _mm_shuffle_ps(tmp0, tmp0, 1));
+  return _mm_cvtss_f32(tmp1);
+}
+
+inline float vecMaxH(SIMDVectorFloat v)
+{
+  __m128 x = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  __m128 tmp0 = _mm_max_ps(x, _mm_movehl_ps(x, x));
+  __m128 tmp1 = _mm_max_ss(tmp0, _mm_shuffle_ps(tmp0, tmp0, 1));
+  return _mm_cvtss_f32(tmp1);
+}
+
+inline float vecMinH(SIMDVectorFloat v)
+{
+  __m128 x = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  __m128 tmp0 = _mm_min_ps(x, _mm_movehl_ps(x, x));
+  __m128 tmp1 = _mm_min_ss(tmp0, _mm_shuffle_ps(tmp0, tmp0, 1));
+  return _mm_cvtss_f32(tmp1);
+}
+
+// ----------------------------------------------------------------
+// shuffles across the whole vector
+
+// Given vectors [ ?, ?, ?, ?, ?, ?, ?, 7 ], [ 8, 9, 10, 11, 12, 13, 14, 15 ]
+// Returns [ 7, 8, 9, 10, 11, 12, 13, 14 ]
+inline SIMDVectorFloat vecShuffleRight(SIMDVectorFloat v1, SIMDVectorFloat v2)
+{
+  const __m256i rotateRight = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+  __m256 r1 = _mm256_permutevar8x32_ps(v1, rotateRight);
+  __m256 r2 = _mm256_permutevar8x32_ps(v2, rotateRight);
+  return _mm256_blend_ps(r2, r1, 0x01);
+}
+
+// Given vectors [ 0, 1, 2, 3, 4, 5, 6, 7 ], [ 8, ?, ?, ?, ?, ?, ?, ? ]
+// Returns [ 1, 2, 3, 4, 5, 6, 7, 8 ]
+inline SIMDVectorFloat vecShuffleLeft(SIMDVectorFloat v1, SIMDVectorFloat v2)
+{
+  const __m256i rotateLeft = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+  __m256 r1 = _mm256_permutevar8x32_ps(v1, rotateLeft);
+  __m256 r2 = _mm256_permutevar8x32_ps(v2, rotateLeft);
+  return _mm256_blend_ps(r1, r2, 0x80);
+}
+
+// ----------------------------------------------------------------
+// scans
+
+// Given vector [ a, b, c, ..., h ]
+// Returns [ a, a+b, a+b+c, ..., a+b+...+h ]
+// Each step adds the vector shifted up by 1, 2 and 4 elements.
+inline SIMDVectorFloat vecPrefixSum(SIMDVectorFloat v)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  v = _mm256_add_ps(
+      v, _mm256_blend_ps(_mm256_permutevar8x32_ps(v, _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6)),
+                         zero, 0x01));
+  v = _mm256_add_ps(
+      v, _mm256_blend_ps(_mm256_permutevar8x32_ps(v, _mm256_setr_epi32(0, 0, 0, 1, 2, 3, 4, 5)),
+                         zero, 0x03));
+  return _mm256_add_ps(
+      v, _mm256_blend_ps(_mm256_permutevar8x32_ps(v, _mm256_setr_epi32(0, 0, 0, 0, 0, 1, 2, 3)),
+                         zero, 0x0F));
+}
+
+inline SIMDVectorInt vecPrefixSumInt(SIMDVectorInt v)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  v = _mm256_add_epi32(
+      v, _mm256_blend_epi32(
+             _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6)), zero,
+             0x01));
+  v = _mm256_add_epi32(
+      v, _mm256_blend_epi32(
+             _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 0, 0, 1, 2, 3, 4, 5)), zero,
+             0x03));
+  return _mm256_add_epi32(
+      v, _mm256_blend_epi32(
+             _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 0, 0, 0, 0, 1, 2, 3)), zero,
+             0x0F));
+}
+
+// Given vector [ a, b, c, ..., h ]
+// Returns [ h, h, h, ..., h ]
+inline SIMDVectorFloat vecBroadcastLast(SIMDVectorFloat v)
+{
+  return _mm256_permutevar8x32_ps(v, _mm256_set1_epi32(7));
+}
+
+inline SIMDVectorInt vecBroadcastLastInt(SIMDVectorInt v)
+{
+  return _mm256_permutevar8x32_epi32(v, _mm256_set1_epi32(7));
+}
+
+#define STATIC_SIMD_CONST(name, val) \
+  static const SIMDVectorFloat name = {val, val, val, val, val, val, val, val};
+
+// the transcendental functions are written once in terms of the primitives above.
+#include "MLDSPMathCommon.h"
@@ -0,0 +1,311 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPMathAVX512.h
+// AVX-512 implementations of madronalib SIMD primitives, 16 floats wide.
+// Selected by defining ML_SIMD_AVX512 and compiling with AVX-512F enabled.
+//
+// AVX-512 comparisons return bit masks instead of vector masks. Since the rest
+// of madronalib combines comparison results with vecAnd / vecSelect, the
+// comparisons here expand the bit masks back into all-ones / all-zeros lanes.
+
+#pragma once
+
+#include "MLPlatform.h"
+
+#include <immintrin.h>
+
+#include <float.h>
+#include <stdint.h>
+
+#include <iostream>
+
+#ifndef __AVX512F__
+#error "MLDSPMathAVX512.h: ML_SIMD_AVX512 is defined but the compiler is not targeting AVX-512F."
+#endif
+
+// AVX-512 types
+typedef __m512 SIMDVectorFloat;
+typedef __m512i SIMDVectorInt;
+
+// AVX-512 casts
+#define VecF2I _mm512_castps_si512
+#define VecI2F _mm512_castsi512_ps
+
+constexpr int kFloatsPerSIMDVectorBits = 4;
+constexpr int kFloatsPerSIMDVector = 1 << kFloatsPerSIMDVectorBits;
+constexpr int kSIMDVectorsPerDSPVector = kFloatsPerDSPVector / kFloatsPerSIMDVector;
+constexpr int kBytesPerSIMDVector = kFloatsPerSIMDVector * sizeof(float);
+constexpr int kSIMDVectorMask = ~(kBytesPerSIMDVector - 1);
+
+constexpr int kIntsPerSIMDVectorBits = 4;
+constexpr int kIntsPerSIMDVector = 1 << kIntsPerSIMDVectorBits;
+
+constexpr const char* kSIMDBackendName = "AVX-512";
+
+inline bool isSIMDAligned(float* p)
+{
+  uintptr_t pM = (uintptr_t)p;
+  return ((pM & kSIMDVectorMask) == 0);
+}
+
+// expand a comparison bit mask to a vector mask.
+inline SIMDVectorFloat vecMaskToFloat(__mmask16 m)
+{
+  return _mm512_castsi512_ps(_mm512_maskz_mov_epi32(m, _mm512_set1_epi32(-1)));
+}
+
+// and contract a vector mask to a bit mask, looking only at the sign bits.
+inline __mmask16 vecFloatToMask(SIMDVectorFloat v)
+{
+  return _mm512_cmplt_epi32_mask(_mm512_castps_si512(v), _mm512_setzero_si512());
+}
+
+// bitwise float operations. AVX512DQ has these for floats directly, but
+// going through the integer unit only requires AVX-512F.
+inline SIMDVectorFloat vecAnd(SIMDVectorFloat a, SIMDVectorFloat b)
+{
+  return VecI2F(_mm512_and_si512(VecF2I(a), VecF2I(b)));
+}
+
+inline SIMDVectorFloat vecAndNot(SIMDVectorFloat a, SIMDVectorFloat b)
+{
+  return VecI2F(_mm512_andnot_si512(VecF2I(a), VecF2I(b)));
+}
+
+inline SIMDVectorFloat vecOr(SIMDVectorFloat a, SIMDVectorFloat b)
+{
+  return VecI2F(_mm512_or_si512(VecF2I(a), VecF2I(b)));
+}
+
+inline SIMDVectorFloat vecXor(SIMDVectorFloat a, SIMDVectorFloat b)
+{
+  return VecI2F(_mm512_xor_si512(VecF2I(a), VecF2I(b)));
+}
+
+// primitive AVX-512 operations
+#define vecAdd _mm512_add_ps
+#define vecSub _mm512_sub_ps
+#define vecMul _mm512_mul_ps
+#define vecDiv _mm512_div_ps
+#define vecDivApprox(x1, x2) (_mm512_mul_ps(x1, _mm512_rcp14_ps(x2)))
+#define vecMin _mm512_min_ps
+#define vecMax _mm512_max_ps
+
+// fused multiply-add: vecFMA(a, b, c) = a*b + c, vecFMS(a, b, c) = a*b - c.
+// FMA is part of AVX-512F.
+#define vecFMA _mm512_fmadd_ps
+#define vecFMS _mm512_fmsub_ps
+
+#define vecSqrt _mm512_sqrt_ps
+#define vecSqrtApprox(x) (vecMul(x, vecRSqrt(x)))
+#define vecRSqrt _mm512_rsqrt14_ps
+#define vecAbs(x) (vecAndNot(_mm512_set1_ps(-0.0f), x))
+
+#define vecSign(x)                                                                \
+  (vecAnd(vecOr(vecAnd(_mm512_set1_ps(-0.0f), x), _mm512_set1_ps(1.0f)),       \
+          vecNotEqual(_mm512_set1_ps(-0.0f), x)))
+
+#define vecSignBit(x) (vecOr(vecAnd(_mm512_set1_ps(-0.0f), x), _mm512_set1_ps(1.0f)))
+#define vecClamp(x1, x2, x3) _mm512_min_ps(_mm512_max_ps(x1, x2), x3)
+#define vecWithin(x1, x2, x3) vecAnd(vecGreaterThanOrEqual(x1, x2), vecLessThan(x1, x3))
+
+// comparisons use the same predicates as the SSE compare instructions.
+#define vecEqual(x1, x2) vecMaskToFloat(_mm512_cmp_ps_mask(x1, x2, _CMP_EQ_OQ))
+#define vecNotEqual(x1, x2) vecMaskToFloat(_mm512_cmp_ps_mask(x1, x2, _CMP_NEQ_UQ))
+#define vecGreaterThan(x1, x2) vecMaskToFloat(_mm512_cmp_ps_mask(x1, x2, _CMP_GT_OS))
+#define vecGreaterThanOrEqual(x1, x2) vecMaskToFloat(_mm512_cmp_ps_mask(x1, x2, _CMP_GE_OS))
+#define vecLessThan(x1, x2) vecMaskToFloat(_mm512_cmp_ps_mask(x1, x2, _CMP_LT_OS))
+#define vecLessThanOrEqual(x1, x2) vecMaskToFloat(_mm512_cmp_ps_mask(x1, x2, _CMP_LE_OS))
+
+#define vecSet1 _mm512_set1_ps
+
+// low-level store and load a vector to/from a float*.
+// the pointer must be aligned or the program will crash!
+#define vecStore _mm512_store_ps
+#define vecLoad _mm512_load_ps
+
+#define vecStoreUnaligned _mm512_storeu_ps
+#define vecLoadUnaligned _mm512_loadu_ps
+
+#define vecZeros _mm512_setzero_ps
+#define vecOnes() VecI2F(_mm512_set1_epi32(-1))
+
+#define vecFloatToIntRound _mm512_cvtps_epi32
+#define vecFloatToIntTruncate _mm512_cvttps_epi32
+#define vecIntToFloat _mm512_cvtepi32_ps
+
+// AVX-512 has a native unsigned conversion, so unlike SSE and AVX2 this
+// does not lose precision.
+#define vecUnsignedIntToFloat _mm512_cvtepu32_ps
+
+#define vecAddInt _mm512_add_epi32
+#define vecSubInt _mm512_sub_epi32
+#define vecSet1Int _mm512_set1_epi32
+#define vecAndInt _mm512_and_si512
+#define vecAndNotInt _mm512_andnot_si512
+#define vecEqualInt(x1, x2) _mm512_maskz_mov_epi32(_mm512_cmpeq_epi32_mask(x1, x2), _mm512_set1_epi32(-1))
+#define vecShiftLeftInt32 _mm512_slli_epi32
+#define vecShiftRightInt32 _mm512_srli_epi32
+
+typedef union
+{
+  SIMDVectorFloat v;
+  float f[16];
+} SIMDVectorFloatUnion;
+
+typedef union
+{
+  SIMDVectorInt v;
+  uint32_t i[16];
+} SIMDVectorIntUnion;
+
+inline SIMDVectorInt vecSetInt1(uint32_t a) { return _mm512_set1_epi32(a); }
+
+inline std::ostream& operator<<(std::ostream& out, SIMDVectorFloat v)
+{
+  SIMDVectorFloatUnion u;
+  u.v = v;
+  out << "[";
+  for (int i = 0; i < kFloatsPerSIMDVector; ++i)
+  {
+    out << u.f[i];
+    if (i < kFloatsPerSIMDVector - 1) out << ", ";
+  }
+  out << "]";
+  return out;
+}
+
+inline std::ostream& operator<<(std::ostream& out, SIMDVectorInt v)
+{
+  SIMDVectorIntUnion u;
+  u.v = v;
+  out << "[";
+  for (int i = 0; i < kIntsPerSIMDVector; ++i)
+  {
+    out << u.i[i];
+    if (i < kIntsPerSIMDVector - 1) out << ", ";
+  }
+  out << "]";
+  return out;
+}
+
+// ----------------------------------------------------------------
+#pragma mark select
+
+inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b, SIMDVectorInt conditionMask)
+{
+  return _mm512_mask_blend_ps(vecFloatToMask(VecI2F(conditionMask)), b, a);
+}
+
+inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b, SIMDVectorFloat conditionMask)
+{
+  return _mm512_mask_blend_ps(vecFloatToMask(conditionMask), b, a);
+}
+
+inline SIMDVectorInt vecSelect(SIMDVectorInt a, SIMDVectorInt b, SIMDVectorInt conditionMask)
+{
+  return _mm512_mask_blend_epi32(vecFloatToMask(VecI2F(conditionMask)), b, a);
+}
+
+// ----------------------------------------------------------------
+// int32 operations
+// compares return masks, which are expanded to full vectors like vecEqualInt.
+
+#define vecMulInt _mm512_mullo_epi32
+#define vecOrInt _mm512_or_si512
+#define vecXorInt _mm512_xor_si512
+#define vecShiftRightArithmeticInt32 _mm512_srai_epi32
+#define vecMinInt _mm512_min_epi32
+#define vecMaxInt _mm512_max_epi32
+#define vecMinUInt _mm512_min_epu32
+#define vecMaxUInt _mm512_max_epu32
+
+#define vecIntMaskToVector(m) _mm512_maskz_mov_epi32(m, _mm512_set1_epi32(-1))
+#define vecGreaterThanInt(x1, x2) vecIntMaskToVector(_mm512_cmpgt_epi32_mask(x1, x2))
+#define vecLessThanInt(x1, x2) vecIntMaskToVector(_mm512_cmplt_epi32_mask(x1, x2))
+#define vecGreaterThanUInt(x1, x2) vecIntMaskToVector(_mm512_cmpgt_epu32_mask(x1, x2))
+#define vecLessThanUInt(x1, x2) vecIntMaskToVector(_mm512_cmplt_epu32_mask(x1, x2))
+
+// ----------------------------------------------------------------
+// gather: load base[indices[i]] into each lane i.
+
+inline SIMDVectorFloat vecGather(const float* base, SIMDVectorInt indices)
+{
+  return _mm512_i32gather_ps(indices, base, 4);
+}
+
+// ----------------------------------------------------------------
+// horizontal operations returning float
+
+inline float vecSumH(SIMDVectorFloat v) { return _mm512_reduce_add_ps(v); }
+
+inline float vecMaxH(SIMDVectorFloat v) { return _mm512_reduce_max_ps(v); }
+
+inline float vecMinH(SIMDVectorFloat v) { return _mm512_reduce_min_ps(v); }
+
+// ----------------------------------------------------------------
+// shuffles across the whole vector
+
+// Given vectors [ ?, ..., ?, 15 ], [ 16, 17, ..., 31 ]
+// Returns [ 15, 16, ..., 30 ]
+inline SIMDVectorFloat vecShuffleRight(SIMDVectorFloat v1, SIMDVectorFloat v2)
+{
+  // indices 0-15 select from v1, 16-31 from v2.
+  const __m512i idx =
+      _mm512_setr_epi32(15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30);
+  return _mm512_permutex2var_ps(v1, idx, v2);
+}
+
+// Given vectors [ 0, 1, ..., 15 ], [ 16, ?, ..., ? ]
+// Returns [ 1, 2, ..., 16 ]
+inline SIMDVectorFloat vecShuffleLeft(SIMDVectorFloat v1, SIMDVectorFloat v2)
+{
+  const __m512i idx = _mm512_setr_epi32(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16);
+  return _mm512_permutex2var_ps(v1, idx, v2);
+}
+
+// ----------------------------------------------------------------
+// scans
+
+// Given vector [ a, b, c, ..., p ]
+// Returns [ a, a+b, a+b+c, ..., a+b+...+p ]
+// Each step adds the vector shifted up by 1, 2, 4 and 8 elements. alignr with a
+// zero vector shifts in zeros at the bottom.
+inline SIMDVectorInt vecPrefixSumInt(SIMDVectorInt v)
+{
+  const __m512i zero = _mm512_setzero_si512();
+  v = _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 15));
+  v = _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 14));
+  v = _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 12));
+  return _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 8));
+}
+
+inline SIMDVectorFloat vecPrefixSum(SIMDVectorFloat v)
+{
+  const __m512i zero = _mm512_setzero_si512();
+  v = _mm512_add_ps(v, VecI2F(_mm512_alignr_epi32(VecF2I(v), zero, 15)));
+  v = _mm512_add_ps(v, VecI2F(_mm512_alignr_epi32(VecF2I(v), zero, 14)));
+  v = _mm512_add_ps(v, VecI2F(_mm512_alignr_epi32(VecF2I(v), zero, 12)));
+  return _mm512_add_ps(v, VecI2F(_mm512_alignr_epi32(VecF2I(v), zero, 8)));
+}
+
+// Given vector [ a, b, c, ..., p ]
+// Returns [ p, p, p, ..., p ]
+inline SIMDVectorFloat vecBroadcastLast(SIMDVectorFloat v)
+{
+  return _mm512_permutexvar_ps(_mm512_set1_epi32(15), v);
+}
+
+inline SIMDVectorInt vecBroadcastLastInt(SIMDVectorInt v)
+{
+  return _mm512_permutexvar_epi32(_mm512_set1_epi32(15), v);
+}
+
+#define STATIC_SIMD_CONST(name, val)                                                  \
+  static const SIMDVectorFloat name = {val, val, val, val, val, val, val, val, val, val, \
+                                       val, val, val, val, val, val};
+
+// the transcendental functions are written once in terms of the primitives above.
+#include "MLDSPMathCommon.h"
@@ -0,0 +1,333 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPMathCommon.h
+// Transcendental functions and approximations written in terms of the
+// primitive vec* operations, so that they can be shared by any SIMD backend
+// that defines those primitives. Currently used by the AVX2 and AVX-512
+// backends. The SSE / NEON backend keeps its own hand-written versions in
+// MLDSPMathSSE.h, which these follow operation for operation.
+//
+// The backend must define, in addition to the public vec* operations:
+// vecAndNot, vecXor, vecAndInt, vecAndNotInt, vecEqualInt,
+// vecShiftLeftInt32 and vecShiftRightInt32.
+
+// cephes-derived approximate math functions adapted from code by Julien
+// Pommier, licensed as follows:
+/*
+ Copyright (C) 2007  Julien Pommier
+
+ This software is provided 'as-is', without any express or implied
+ warranty.  In no event will the authors be held liable for any damages
+ arising from the use of this software.
+
+ Permission is granted to anyone to use this software for any purpose,
+ including commercial applications, and to alter it and redistribute it
+ freely, subject to the following restrictions:
+
+ 1. The origin of this software must not be misrepresented; you must not
+ claim that you wrote the original software. If you use this software
+ in a product, an acknowledgment in the product documentation would be
+ appreciated but is not required.
+ 2. Altered source versions must be plainly marked as such, and must not be
+ misrepresented as being the original software.
+ 3. This notice may not be removed or altered from any source distribution.
+
+ (this is the zlib license)
+ */
+
+#pragma once
+
+// ----------------------------------------------------------------
+// cephes-derived log, exp, sin, cos
+
+// natural logarithm. returns NaN for x <= 0
+inline SIMDVectorFloat vecLog(SIMDVectorFloat x)
+{
+  const SIMDVectorFloat one = vecSet1(1.0f);
+  SIMDVectorFloat invalidMask = vecLessThanOrEqual(x, vecZeros());
+
+  // cut off denormalized stuff
+  x = vecMax(x, vecSet1(FLT_MIN));
+
+  SIMDVectorInt emm0 = vecShiftRightInt32(VecF2I(x), 23);
+
+  // keep only the fractional part
+  x = vecAnd(x, VecI2F(vecSet1Int(~0x7f800000)));
+  x = vecOr(x, vecSet1(0.5f));
+
+  emm0 = vecSubInt(emm0, vecSet1Int(0x7f));
+  SIMDVectorFloat e = vecAdd(vecIntToFloat(emm0), one);
+
+  // if( x < SQRTHF ) { e -= 1; x = x + x - 1.0; } else { x = x - 1.0; }
+  SIMDVectorFloat mask = vecLessThan(x, vecSet1(0.707106781186547524f));
+  SIMDVectorFloat tmp = vecAnd(x, mask);
+  x = vecSub(x, one);
+  e = vecSub(e, vecAnd(one, mask));
+  x = vecAdd(x, tmp);
+
+  SIMDVectorFloat z = vecMul(x, x);
+
+  SIMDVectorFloat y = vecSet1(7.0376836292E-2f);
+  y = vecAdd(vecMul(y, x), vecSet1(-1.1514610310E-1f));
+  y = vecAdd(vecMul(y, x), vecSet1(1.1676998740E-1f));
+  y = vecAdd(vecMul(y, x), vecSet1(-1.2420140846E-1f));
+  y = vecAdd(vecMul(y, x), vecSet1(+1.4249322787E-1f));
+  y = vecAdd(vecMul(y, x), vecSet1(-1.6668057665E-1f));
+  y = vecAdd(vecMul(y, x), vecSet1(+2.0000714765E-1f));
+  y = vecAdd(vecMul(y, x), vecSet1(-2.4999993993E-1f));
+  y = vecAdd(vecMul(y, x), vecSet1(+3.3333331174E-1f));
+  y = vecMul(y, x);
+  y = vecMul(y, z);
+
+  y = vecAdd(y, vecMul(e, vecSet1(-2.12194440e-4f)));
+  y = vecSub(y, vecMul(z, vecSet1(0.5f)));
+
+  tmp = vecMul(e, vecSet1(0.693359375f));
+  x = vecAdd(x, y);
+  x = vecAdd(x, tmp);
+
+  // negative arg will be NAN
+  return vecOr(x, invalidMask);
+}
+
+inline SIMDVectorFloat vecExp(SIMDVectorFloat x)
+{
+  const SIMDVectorFloat one = vecSet1(1.0f);
+
+  x = vecMin(x, vecSet1(88.3762626647949f));
+  x = vecMax(x, vecSet1(-88.3762626647949f));
+
+  // express exp(x) as exp(g + n*log(2))
+  SIMDVectorFloat fx = vecMul(x, vecSet1(1.44269504088896341f));
+  fx = vecAdd(fx, vecSet1(0.5f));
+
+  // floorf: truncate, then subtract 1 if greater
+  SIMDVectorFloat tmp = vecIntToFloat(vecFloatToIntTruncate(fx));
+  SIMDVectorFloat mask = vecAnd(vecGreaterThan(tmp, fx), one);
+  fx = vecSub(tmp, mask);
+
+  tmp = vecMul(fx, vecSet1(0.693359375f));
+  SIMDVectorFloat z = vecMul(fx, vecSet1(-2.12194440e-4f));
+  x = vecSub(x, tmp);
+  x = vecSub(x, z);
+  z = vecMul(x, x);
+
+  SIMDVectorFloat y = vecSet1(1.9875691500E-4f);
+  y = vecAdd(vecMul(y, x), vecSet1(1.3981999507E-3f));
+  y = vecAdd(vecMul(y, x), vecSet1(8.3334519073E-3f));
+  y = vecAdd(vecMul(y, x), vecSet1(4.1665795894E-2f));
+  y = vecAdd(vecMul(y, x), vecSet1(1.6666665459E-1f));
+  y = vecAdd(vecMul(y, x), vecSet1(5.0000001201E-1f));
+  y = vecMul(y, z);
+  y = vecAdd(y, x);
+  y = vecAdd(y, one);
+
+  // build 2^n
+  SIMDVectorInt emm0 = vecFloatToIntTruncate(fx);
+  emm0 = vecAddInt(emm0, vecSet1Int(0x7f));
+  emm0 = vecShiftLeftInt32(emm0, 23);
+
+  return vecMul(y, VecI2F(emm0));
+}
+
+// range reduction shared by vecSin, vecCos and vecSinCos. Given |x|, returns
+// the reduced argument and sets j to the octant as computed by cephes.
+inline SIMDVectorFloat vecReduceTrigArg(SIMDVectorFloat absX, SIMDVectorInt& j)
+{
+  // scale by 4/Pi
+  SIMDVectorFloat y = vecMul(absX, vecSet1(1.27323954473516f));
+
+  // j=(j+1) & (~1) (see the cephes sources)
+  j = vecFloatToIntTruncate(y);
+  j = vecAddInt(j, vecSet1Int(1));
+  j = vecAndInt(j, vecSet1Int(~1));
+  y = vecIntToFloat(j);
+
+  // The magic pass: "Extended precision modular arithmetic"
+  // x = ((x - y * DP1) - y * DP2) - y * DP3;
+  SIMDVectorFloat x = absX;
+  x = vecAdd(x, vecMul(y, vecSet1(-0.78515625f)));
+  x = vecAdd(x, vecMul(y, vecSet1(-2.4187564849853515625e-4f)));
+  x = vecAdd(x, vecMul(y, vecSet1(-3.77489497744594108e-8f)));
+  return x;
+}
+
+// evaluate the cosine polynomial in z = x*x, valid for 0 <= x <= Pi/4
+inline SIMDVectorFloat vecCosPoly(SIMDVectorFloat z)
+{
+  SIMDVectorFloat y = vecSet1(2.443315711809948E-005f);
+  y = vecAdd(vecMul(y, z), vecSet1(-1.388731625493765E-003f));
+  y = vecAdd(vecMul(y, z), vecSet1(4.166664568298827E-002f));
+  y = vecMul(y, z);
+  y = vecMul(y, z);
+  y = vecSub(y, vecMul(z, vecSet1(0.5f)));
+  return vecAdd(y, vecSet1(1.0f));
+}
+
+// evaluate the sine polynomial, valid for 0 <= x <= Pi/4
+inline SIMDVectorFloat vecSinPoly(SIMDVectorFloat x, SIMDVectorFloat z)
+{
+  SIMDVectorFloat y2 = vecSet1(-1.9515295891E-4f);
+  y2 = vecAdd(vecMul(y2, z), vecSet1(8.3321608736E-3f));
+  y2 = vecAdd(vecMul(y2, z), vecSet1(-1.6666654611E-1f));
+  y2 = vecMul(y2, z);
+  y2 = vecMul(y2, x);
+  return vecAdd(y2, x);
+}
+
+inline SIMDVectorFloat vecSin(SIMDVectorFloat x)
+{
+  const SIMDVectorFloat signMask = vecSet1(-0.0f);
+  SIMDVectorFloat signBit = vecAnd(x, signMask);
+  SIMDVectorInt j;
+  x = vecReduceTrigArg(vecAndNot(signMask, x), j);
+
+  // get the swap sign flag and the polynomial selection mask
+  SIMDVectorInt swapSign = vecShiftLeftInt32(vecAndInt(j, vecSet1Int(4)), 29);
+  SIMDVectorInt polyMask = vecEqualInt(vecAndInt(j, vecSet1Int(2)), vecSet1Int(0));
+  signBit = vecXor(signBit, VecI2F(swapSign));
+
+  SIMDVectorFloat z = vecMul(x, x);
+  SIMDVectorFloat y = vecCosPoly(z);
+  SIMDVectorFloat y2 = vecSinPoly(x, z);
+
+  // select the correct result from the two polynomials and update the sign
+  y = vecAdd(vecAnd(VecI2F(polyMask), y2), vecAndNot(VecI2F(polyMask), y));
+  return vecXor(y, signBit);
+}
+
+inline SIMDVectorFloat vecCos(SIMDVectorFloat x)
+{
+  SIMDVectorInt j;
+  x = vecReduceTrigArg(vecAndNot(vecSet1(-0.0f), x), j);
+  j = vecSubInt(j, vecSet1Int(2));
+
+  // get the swap sign flag and the polynomial selection mask
+  SIMDVectorInt signBit = vecShiftLeftInt32(vecAndNotInt(j, vecSet1Int(4)), 29);
+  SIMDVectorInt polyMask = vecEqualInt(vecAndInt(j, vecSet1Int(2)), vecSet1Int(0));
+
+  SIMDVectorFloat z = vecMul(x, x);
+  SIMDVectorFloat y = vecCosPoly(z);
+  SIMDVectorFloat y2 = vecSinPoly(x, z);
+
+  // select the correct result from the two polynomials and update the sign
+  y = vecAdd(vecAnd(VecI2F(polyMask), y2), vecAndNot(VecI2F(polyMask), y));
+  return vecXor(y, VecI2F(signBit));
+}
+
+inline void vecSinCos(SIMDVectorFloat x, SIMDVectorFloat* s, SIMDVectorFloat* c)
+{
+  const SIMDVectorFloat signMask = vecSet1(-0.0f);
+  SIMDVectorFloat signBitSin = vecAnd(x, signMask);
+  SIMDVectorInt j;
+  x = vecReduceTrigArg(vecAndNot(signMask, x), j);
+
+  // get the swap sign flags and the polynomial selection mask
+  SIMDVectorInt swapSignSin = vecShiftLeftInt32(vecAndInt(j, vecSet1Int(4)), 29);
+  SIMDVectorInt polyMask = vecEqualInt(vecAndInt(j, vecSet1Int(2)), vecSet1Int(0));
+  SIMDVectorInt jc = vecSubInt(j, vecSet1Int(2));
+  SIMDVectorInt signBitCos = vecShiftLeftInt32(vecAndNotInt(jc, vecSet1Int(4)), 29);
+  signBitSin = vecXor(signBitSin, VecI2F(swapSignSin));
+
+  SIMDVectorFloat z = vecMul(x, x);
+  SIMDVectorFloat y = vecCosPoly(z);
+  SIMDVectorFloat y2 = vecSinPoly(x, z);
+
+  // select the correct result from the two polynomials
+  SIMDVectorFloat ysin2 = vecAnd(VecI2F(polyMask), y2);
+  SIMDVectorFloat ysin1 = vecAndNot(VecI2F(polyMask), y);
+  y2 = vecSub(y2, ysin2);
+  y = vecSub(y, ysin1);
+
+  // update the signs
+  *s = vecXor(vecAdd(ysin1, ysin2), signBitSin);
+  *c = vecXor(vecAdd(y, y2), VecI2F(signBitCos));
+}
+
+// tangent from one evaluation of vecSinCos.
+inline SIMDVectorFloat vecTan(SIMDVectorFloat x)
+{
+  SIMDVectorFloat s, c;
+  vecSinCos(x, &s, &c);
+  return vecDiv(s, c);
+}
+
+// ----------------------------------------------------------------
+// fast polynomial approximations
+// from scalar code by Jacques-Henri Jourdan <jourgun@gmail.com>
+// sin and cos valid from -pi to pi. See MLDSPMathSSE.h for the derivations.
+
+inline SIMDVectorFloat vecSinApprox(SIMDVectorFloat x)
+{
+  SIMDVectorFloat x2 = vecMul(x, x);
+  SIMDVectorFloat y = vecSet1(2.147840177713078446686267852783203125e-6f);
+  y = vecAdd(vecSet1(-1.92649182281456887722015380859375e-4f), vecMul(x2, y));
+  y = vecAdd(vecSet1(8.30897875130176544189453125e-3f), vecMul(x2, y));
+  y = vecAdd(vecSet1(-0.166624367237091064453125f), vecMul(x2, y));
+  y = vecAdd(vecSet1(0.99997937679290771484375f), vecMul(x2, y));
+  return vecMul(x, y);
+}
+
+inline SIMDVectorFloat vecCosApprox(SIMDVectorFloat x)
+{
+  SIMDVectorFloat x2 = vecMul(x, x);
+  SIMDVectorFloat y = vecSet1(1.8791708498611114919185638427734375e-5f);
+  y = vecAdd(vecSet1(-1.33926304988563060760498046875e-3f), vecMul(x2, y));
+  y = vecAdd(vecSet1(4.1496001183986663818359375e-2f), vecMul(x2, y));
+  y = vecAdd(vecSet1(-0.4997930824756622314453125f), vecMul(x2, y));
+  return vecAdd(vecSet1(0.999959766864776611328125f), vecMul(x2, y));
+}
+
+inline SIMDVectorFloat vecExpApprox(SIMDVectorFloat x)
+{
+  SIMDVectorFloat val2 = vecAdd(vecMul(x, vecSet1(12102203.1615614f)), vecSet1(1065353216.f));
+  SIMDVectorFloat val3 = vecMin(val2, vecSet1(2139095040.f));
+  SIMDVectorFloat val4 = vecMax(val3, vecZeros());
+  SIMDVectorInt val4i = vecFloatToIntTruncate(val4);
+
+  SIMDVectorFloat xu = VecI2F(vecAndInt(val4i, vecSet1Int(0x7F800000)));
+  SIMDVectorFloat b = vecOr(VecI2F(vecAndInt(val4i, vecSet1Int(0x7FFFFF))),
+                            VecI2F(vecSet1Int(0x3F800000)));
+
+  SIMDVectorFloat y = vecSet1(1.3671023382430374383648148e-2f);
+  y = vecAdd(vecSet1(-2.88093587581985443087955e-3f), vecMul(b, y));
+  y = vecAdd(vecSet1(0.168143436463395944830000f), vecMul(b, y));
+  y = vecAdd(vecSet1(0.310670891004095530771135f), vecMul(b, y));
+  y = vecAdd(vecSet1(0.510397365625862338668154f), vecMul(b, y));
+  return vecMul(xu, y);
+}
+
+inline SIMDVectorFloat vecLogApprox(SIMDVectorFloat val)
+{
+  SIMDVectorInt valAsInt = VecF2I(val);
+  SIMDVectorInt expi = vecShiftRightInt32(valAsInt, 23);
+  SIMDVectorFloat addcst =
+      vecSelect(vecSet1(-89.970756366f), vecSet1(FLT_MIN), vecGreaterThan(val, vecZeros()));
+  SIMDVectorFloat x = vecOr(VecI2F(vecAndInt(valAsInt, vecSet1Int(0x7FFFFF))),
+                            VecI2F(vecSet1Int(0x3F800000)));
+
+  SIMDVectorFloat poly = vecSet1(3.110401639e-2f);
+  poly = vecAdd(vecSet1(-0.288739945f), vecMul(x, poly));
+  poly = vecAdd(vecSet1(1.130626167f), vecMul(x, poly));
+  poly = vecAdd(vecSet1(-2.461222105f), vecMul(x, poly));
+  poly = vecAdd(vecSet1(3.529304993f), vecMul(x, poly));
+  poly = vecMul(x, poly);
+
+  SIMDVectorFloat addCstResult =
+      vecAdd(addcst, vecMul(vecSet1(0.69314718055995f), vecIntToFloat(expi)));
+  return vecAdd(poly, addCstResult);
+}
+
+inline SIMDVectorFloat vecIntPart(SIMDVectorFloat val)
+{
+  SIMDVectorInt vi = vecFloatToIntTruncate(val);
+  return vecIntToFloat(vi);
+}
+
+inline SIMDVectorFloat vecFracPart(SIMDVectorFloat val)
+{
+  SIMDVectorInt vi = vecFloatToIntTruncate(val);
+  return vecSub(val, vecIntToFloat(vi));
+}
@@ -0,0 +1,309 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MLDSPMathDispatch.h
+// Runtime dispatch of the cephes sin, cos, log and exp kernels, and the log2,
+// exp2 and pow operations made from them, for x86 builds that use the SSE2
+// backend. Each kernel is compiled for AVX-512, AVX2 and
+// SSE2 with the target_clones attribute, and the widest version the CPU
+// supports is chosen when the program loads. So one binary runs on every
+// machine and still gets the full vector width for its most expensive math.
+// Other operations stay at the width of the compile-time backend.
+//
+// The kernels are written once with GCC / Clang vector extensions, 16 floats
+// wide, which the compiler splits into vectors of the width of each target.
+// They follow the SSE versions in MLDSPMathSSE.h operation for operation.
+//
+// Dispatch is enabled for GCC and Clang on x86-64 Linux, where target_clones
+// is supported. Define ML_NO_SIMD_DISPATCH to turn it off.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(ML_NO_SIMD_DISPATCH) && !defined(ML_SIMD_AVX2) && !defined(ML_SIMD_AVX512) && \
+    defined(__x86_64__) && defined(__linux__) && defined(__has_attribute) &&                \
+    defined(__has_builtin)
+#if __has_attribute(target_clones) && __has_builtin(__builtin_convertvector)
+#define ML_SIMD_DISPATCH 1
+#endif
+#endif
+
+#if ML_SIMD_DISPATCH
+
+namespace ml
+{
+namespace dispatch
+{
+constexpr size_t kFloatsPerKernelVector = 16;
+
+typedef float KernelFloat __attribute__((vector_size(kFloatsPerKernelVector * 4)));
+typedef int32_t KernelInt __attribute__((vector_size(kFloatsPerKernelVector * 4)));
+typedef uint32_t KernelUInt __attribute__((vector_size(kFloatsPerKernelVector * 4)));
+
+// the kernel helpers work in place, so that the wide vector types are never
+// passed by value between functions compiled for different targets.
+#define ML_KERNEL_INLINE inline __attribute__((always_inline))
+
+// reinterpret the bits of a vector.
+#define KernelF2I(x) ((KernelInt)(x))
+#define KernelI2F(x) ((KernelFloat)(x))
+
+// a where the mask is set, b elsewhere.
+#define KernelSelect(a, b, mask) KernelI2F((KernelF2I(a) & (mask)) | (KernelF2I(b) & ~(mask)))
+
+ML_KERNEL_INLINE void kernelLog(KernelFloat& x)
+{
+  const KernelFloat one = KernelFloat{} + 1.f;
+  const KernelInt invalidMask = (x <= 0.f);
+
+  // cut off denormalized stuff
+  const KernelFloat minNormPos = KernelI2F(KernelInt{} + 0x00800000);
+  x = KernelSelect(x, minNormPos, x > minNormPos);
+
+  KernelInt emm0 = (KernelInt)((KernelUInt)KernelF2I(x) >> 23);
+
+  // keep only the fractional part
+  x = KernelI2F((KernelF2I(x) & ~0x7f800000) | KernelF2I(KernelFloat{} + 0.5f));
+
+  emm0 = emm0 - 0x7f;
+  KernelFloat e = __builtin_convertvector(emm0, KernelFloat);
+  e = e + one;
+
+  // if (x < SQRTHF) { e -= 1; x = x + x - 1; } else { x = x - 1; }
+  const KernelInt mask = (x < 0.707106781186547524f);
+  KernelFloat tmp = KernelI2F(KernelF2I(x) & mask);
+  x = x - one;
+  e = e - KernelI2F(KernelF2I(one) & mask);
+  x = x + tmp;
+
+  KernelFloat z = x * x;
+
+  KernelFloat y = KernelFloat{} + 7.0376836292E-2f;
+  y = y * x;
+  y = y + -1.1514610310E-1f;
+  y = y * x;
+  y = y + 1.1676998740E-1f;
+  y = y * x;
+  y = y + -1.2420140846E-1f;
+  y = y * x;
+  y = y + 1.4249322787E-1f;
+  y = y * x;
+  y = y + -1.6668057665E-1f;
+  y = y * x;
+  y = y + 2.0000714765E-1f;
+  y = y * x;
+  y = y + -2.4999993993E-1f;
+  y = y * x;
+  y = y + 3.3333331174E-1f;
+  y = y * x;
+
+  y = y * z;
+
+  tmp = e * -2.12194440e-4f;
+  y = y + tmp;
+
+  tmp = z * 0.5f;
+  y = y - tmp;
+
+  tmp = e * 0.693359375f;
+  x = x + y;
+  x = x + tmp;
+
+  // negative arg will be NAN
+  x = KernelI2F(KernelF2I(x) | invalidMask);
+}
+
+ML_KERNEL_INLINE void kernelExp(KernelFloat& x)
+{
+  const KernelFloat one = KernelFloat{} + 1.f;
+  const KernelFloat expHi = KernelFloat{} + 88.3762626647949f;
+  const KernelFloat expLo = KernelFloat{} - 88.3762626647949f;
+  x = KernelSelect(x, expHi, x < expHi);
+  x = KernelSelect(x, expLo, x > expLo);
+
+  // express exp(x) as exp(g + n*log(2))
+  KernelFloat fx = x * 1.44269504088896341f;
+  fx = fx + 0.5f;
+
+  // floor: if the truncated value is greater, subtract 1
+  KernelFloat tmp = __builtin_convertvector(__builtin_convertvector(fx, KernelInt), KernelFloat);
+  fx = tmp - KernelI2F(KernelF2I(one) & (tmp > fx));
+
+  tmp = fx * 0.693359375f;
+  KernelFloat z = fx * -2.12194440e-4f;
+  x = x - tmp;
+  x = x - z;
+  z = x * x;
+
+  KernelFloat y = KernelFloat{} + 1.9875691500E-4f;
+  y = y * x;
+  y = y + 1.3981999507E-3f;
+  y = y * x;
+  y = y + 8.3334519073E-3f;
+  y = y * x;
+  y = y + 4.1665795894E-2f;
+  y = y * x;
+  y = y + 1.6666665459E-1f;
+  y = y * x;
+  y = y + 5.0000001201E-1f;
+  y = y * z;
+  y = y + x;
+  y = y + one;
+
+  // build 2^n
+  KernelInt emm0 = __builtin_convertvector(fx, KernelInt);
+  emm0 = emm0 + 0x7f;
+  emm0 = emm0 << 23;
+  x = y * KernelI2F(emm0);
+}
+
+// the part of sin and cos after the octant y and the signs are found.
+ML_KERNEL_INLINE void kernelSinCosPolynomials(KernelFloat& x, KernelFloat& y,
+                                              const KernelInt& polyMask,
+                                              const KernelInt& signBit)
+{
+  // extended precision modular arithmetic: x = ((x - y * DP1) - y * DP2) - y * DP3
+  KernelFloat xmm1 = y * -0.78515625f;
+  KernelFloat xmm2 = y * -2.4187564849853515625e-4f;
+  KernelFloat xmm3 = y * -3.77489497744594108e-8f;
+  x = x + xmm1;
+  x = x + xmm2;
+  x = x + xmm3;
+
+  // the first polynomial, for 0 <= x <= Pi/4
+  y = KernelFloat{} + 2.443315711809948E-005f;
+  KernelFloat z = x * x;
+  y = y * z;
+  y = y + -1.388731625493765E-003f;
+  y = y * z;
+  y = y + 4.166664568298827E-002f;
+  y = y * z;
+  y = y * z;
+  KernelFloat tmp = z * 0.5f;
+  y = y - tmp;
+  y = y + 1.f;
+
+  // the second polynomial, for Pi/4 <= x <= 0
+  KernelFloat y2 = KernelFloat{} + -1.9515295891E-4f;
+  y2 = y2 * z;
+  y2 = y2 + 8.3321608736E-3f;
+  y2 = y2 * z;
+  y2 = y2 + -1.6666654611E-1f;
+  y2 = y2 * z;
+  y2 = y2 * x;
+  y2 = y2 + x;
+
+  // select the correct result from the two polynomials and update the sign
+  y2 = KernelI2F(KernelF2I(y2) & polyMask);
+  y = KernelI2F(KernelF2I(y) & ~polyMask);
+  y = y + y2;
+  x = KernelI2F(KernelF2I(y) ^ signBit);
+}
+
+ML_KERNEL_INLINE void kernelSin(KernelFloat& x)
+{
+  // take the absolute value and extract the sign bit
+  KernelInt signBit = KernelF2I(x) & int32_t(0x80000000);
+  x = KernelI2F(KernelF2I(x) & 0x7fffffff);
+
+  // scale by 4/Pi and find the octant: j = (j + 1) & (~1)
+  KernelFloat y = x * 1.27323954473516f;
+  KernelInt emm2 = __builtin_convertvector(y, KernelInt);
+  emm2 = emm2 + 1;
+  emm2 = emm2 & ~1;
+  y = __builtin_convertvector(emm2, KernelFloat);
+
+  // the swap sign flag and the polynomial selection mask
+  KernelInt emm0 = (emm2 & 4) << 29;
+  KernelInt polyMask = ((emm2 & 2) == 0);
+  signBit = signBit ^ emm0;
+  kernelSinCosPolynomials(x, y, polyMask, signBit);
+}
+
+ML_KERNEL_INLINE void kernelCos(KernelFloat& x)
+{
+  // take the absolute value
+  x = KernelI2F(KernelF2I(x) & 0x7fffffff);
+
+  // scale by 4/Pi and find the octant: j = (j + 1) & (~1)
+  KernelFloat y = x * 1.27323954473516f;
+  KernelInt emm2 = __builtin_convertvector(y, KernelInt);
+  emm2 = emm2 + 1;
+  emm2 = emm2 & ~1;
+  y = __builtin_convertvector(emm2, KernelFloat);
+  emm2 = emm2 - 2;
+
+  // the swap sign flag and the polynomial selection mask
+  KernelInt signBit = (~emm2 & 4) << 29;
+  KernelInt polyMask = ((emm2 & 2) == 0);
+  kernelSinCosPolynomials(x, y, polyMask, signBit);
+}
+
+ML_KERNEL_INLINE void kernelLog2(KernelFloat& x)
+{
+  kernelLog(x);
+  x = x * 1.4426950408889634f;
+}
+
+ML_KERNEL_INLINE void kernelExp2(KernelFloat& x)
+{
+  x = x * 0.69314718055994529f;
+  kernelExp(x);
+}
+
+// define a function that applies a kernel to n floats, where n is a multiple of
+// kFloatsPerKernelVector. The resolver for the clones runs when the program loads.
+#define DEFINE_DISPATCHED_KERNEL(kernelName, kernel)                                  \
+  __attribute__((target_clones("avx512f", "avx2", "default"))) inline void kernelName( \
+      const float* px, float* py, size_t n)                                            \
+  {                                                                                    \
+    for (size_t i = 0; i < n; i += kFloatsPerKernelVector)                             \
+    {                                                                                  \
+      KernelFloat x;                                                                   \
+      memcpy(&x, px + i, sizeof(x));                                                   \
+      kernel(x);                                                                       \
+      memcpy(py + i, &x, sizeof(x));                                                   \
+    }                                                                                  \
+  }
+
+DEFINE_DISPATCHED_KERNEL(sinKernel, kernelSin);
+DEFINE_DISPATCHED_KERNEL(cosKernel, kernelCos);
+DEFINE_DISPATCHED_KERNEL(logKernel, kernelLog);
+DEFINE_DISPATCHED_KERNEL(expKernel, kernelExp);
+DEFINE_DISPATCHED_KERNEL(log2Kernel, kernelLog2);
+DEFINE_DISPATCHED_KERNEL(exp2Kernel, kernelExp2);
+
+// pow(x1, x2) = exp(log(x1) * x2)
+__attribute__((target_clones("avx512f", "avx2", "default"))) inline void powKernel(
+    const float* px1, const float* px2, float* py, size_t n)
+{
+  for (size_t i = 0; i < n; i += kFloatsPerKernelVector)
+  {
+    KernelFloat x1, x2;
+    memcpy(&x1, px1 + i, sizeof(x1));
+    memcpy(&x2, px2 + i, sizeof(x2));
+    kernelLog(x1);
+    x1 = x1 * x2;
+    kernelExp(x1);
+    memcpy(py + i, &x1, sizeof(x1));
+  }
+}
+
+// the name of the kernel versions chosen for this CPU, checked in the same
+// order as the target_clones resolver.
+inline const char* getDispatchedBackendName()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return "AVX-512";
+  if (__builtin_cpu_supports("avx2")) return "AVX2";
+  return "SSE2";
+}
+
+}  // namespace dispatch
+}  // namespace ml
+
+#endif  // ML_SIMD_DISPATCH
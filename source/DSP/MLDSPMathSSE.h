@@ -33,6 +33,12 @@
 
 #ifndef ML_SSE_TO_NEON
 #include <emmintrin.h>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+#ifdef __FMA__
+#include <immintrin.h>
+#endif
 #endif
 
 #include <float.h>
@@ -66,6 +72,12 @@ constexpr int kSIMDVectorMask = ~(kBytesPerSIMDVector - 1);
 constexpr int kIntsPerSIMDVectorBits = 2;
 constexpr int kIntsPerSIMDVector = 1 << kIntsPerSIMDVectorBits;
 
+#ifdef ML_SSE_TO_NEON
+constexpr const char* kSIMDBackendName = "NEON";
+#else
+constexpr const char* kSIMDBackendName = "SSE2";
+#endif
+
 inline bool isSIMDAligned(float* p)
 {
   uintptr_t pM = (uintptr_t)p;
@@ -81,6 +93,20 @@ inline bool isSIMDAligned(float* p)
 #define vecMin _mm_min_ps
 #define vecMax _mm_max_ps
 
+// fused multiply-add: vecFMA(a, b, c) = a*b + c, vecFMS(a, b, c) = a*b - c.
+// These round once when the target has FMA (FMA3 on x86, always on AArch64)
+// and fall back to a separate multiply and add otherwise.
+#if defined(ML_SSE_TO_NEON) && defined(__aarch64__)
+#define vecFMA(x1, x2, x3) vfmaq_f32(x3, x1, x2)
+#define vecFMS(x1, x2, x3) vnegq_f32(vfmsq_f32(x3, x1, x2))
+#elif defined(__FMA__) && !defined(ML_SSE_TO_NEON)
+#define vecFMA _mm_fmadd_ps
+#define vecFMS _mm_fmsub_ps
+#else
+#define vecFMA(x1, x2, x3) _mm_add_ps(_mm_mul_ps(x1, x2), x3)
+#define vecFMS(x1, x2, x3) _mm_sub_ps(_mm_mul_ps(x1, x2), x3)
+#endif
+
 #define vecSqrt _mm_sqrt_ps
 #define vecSqrtApprox(x) (vecMul(x, vecRSqrt(x)))
 #define vecRSqrt _mm_rsqrt_ps
@@ -114,7 +140,9 @@ _mm_cmpneq_ps(_mm_set_ps1(-0.0f), x)))
 #define vecLoadUnaligned _mm_loadu_ps
 
 #define vecAnd _mm_and_ps
+#define vecAndNot _mm_andnot_ps
 #define vecOr _mm_or_ps
+#define vecXor _mm_xor_ps
 
 #define vecZeros _mm_setzero_ps
 #define vecOnes vecEqual(vecZeros, vecZeros)
@@ -221,23 +249,98 @@ inline std::ostream& operator<<(std::ostream& out, SIMDVectorInt v)
 
 inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b, SIMDVectorInt conditionMask)
 {
-  __m128i ones = _mm_set1_epi32(-1);
-  return _mm_or_ps(_mm_and_ps(VecI2F(conditionMask), a),
-                   _mm_and_ps(_mm_xor_ps(VecI2F(conditionMask), VecI2F(ones)), b));
+  return _mm_or_ps(_mm_and_ps(VecI2F(conditionMask), a), _mm_andnot_ps(VecI2F(conditionMask), b));
 }
 
 inline SIMDVectorFloat vecSelect(SIMDVectorFloat a, SIMDVectorFloat b, SIMDVectorFloat conditionMask)
 {
-  __m128i ones = _mm_set1_epi32(-1);
-  return _mm_or_ps(_mm_and_ps((conditionMask), a),
-                   _mm_and_ps(_mm_xor_ps((conditionMask), VecI2F(ones)), b));
+  return _mm_or_ps(_mm_and_ps(conditionMask, a), _mm_andnot_ps(conditionMask, b));
 }
 
 inline SIMDVectorInt vecSelect(SIMDVectorInt a, SIMDVectorInt b, SIMDVectorInt conditionMask)
 {
-  __m128i ones = _mm_set1_epi32(-1);
-  return _mm_or_si128(_mm_and_si128(conditionMask, a),
-                      _mm_and_si128(_mm_xor_si128(conditionMask, ones), b));
+  return _mm_or_si128(_mm_and_si128(conditionMask, a), _mm_andnot_si128(conditionMask, b));
+}
+
+// ----------------------------------------------------------------
+// int32 operations
+// multiply, min and max use SSE4.1 (or NEON through sse2neon) when available,
+// otherwise SSE2 equivalents. Unsigned compares flip the sign bits and use the
+// signed compares.
+
+#define vecAndInt _mm_and_si128
+#define vecAndNotInt _mm_andnot_si128
+#define vecOrInt _mm_or_si128
+#define vecXorInt _mm_xor_si128
+#define vecEqualInt _mm_cmpeq_epi32
+#define vecGreaterThanInt _mm_cmpgt_epi32
+#define vecLessThanInt _mm_cmplt_epi32
+#define vecShiftLeftInt32 _mm_slli_epi32
+#define vecShiftRightInt32 _mm_srli_epi32
+#define vecShiftRightArithmeticInt32 _mm_srai_epi32
+
+#if defined(__SSE4_1__) || defined(ML_SSE_TO_NEON)
+
+#define vecMulInt _mm_mullo_epi32
+#define vecMinInt _mm_min_epi32
+#define vecMaxInt _mm_max_epi32
+#define vecMinUInt _mm_min_epu32
+#define vecMaxUInt _mm_max_epu32
+
+#else
+
+inline SIMDVectorInt vecMulInt(SIMDVectorInt a, SIMDVectorInt b)
+{
+  // multiply even and odd elements to 64 bits, then gather the low halves.
+  __m128i p02 = _mm_mul_epu32(a, b);
+  __m128i p13 = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(p02, SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(p13, SHUFFLE(0, 0, 2, 0)));
+}
+
+inline SIMDVectorInt vecMinInt(SIMDVectorInt a, SIMDVectorInt b)
+{
+  return vecSelect(b, a, _mm_cmpgt_epi32(a, b));
+}
+
+inline SIMDVectorInt vecMaxInt(SIMDVectorInt a, SIMDVectorInt b)
+{
+  return vecSelect(a, b, _mm_cmpgt_epi32(a, b));
+}
+
+inline SIMDVectorInt vecMinUInt(SIMDVectorInt a, SIMDVectorInt b)
+{
+  const __m128i signBit = _mm_set1_epi32(0x80000000);
+  return vecSelect(b, a, _mm_cmpgt_epi32(_mm_xor_si128(a, signBit), _mm_xor_si128(b, signBit)));
+}
+
+inline SIMDVectorInt vecMaxUInt(SIMDVectorInt a, SIMDVectorInt b)
+{
+  const __m128i signBit = _mm_set1_epi32(0x80000000);
+  return vecSelect(a, b, _mm_cmpgt_epi32(_mm_xor_si128(a, signBit), _mm_xor_si128(b, signBit)));
+}
+
+#endif
+
+inline SIMDVectorInt vecGreaterThanUInt(SIMDVectorInt a, SIMDVectorInt b)
+{
+  const __m128i signBit = _mm_set1_epi32(0x80000000);
+  return _mm_cmpgt_epi32(_mm_xor_si128(a, signBit), _mm_xor_si128(b, signBit));
+}
+
+inline SIMDVectorInt vecLessThanUInt(SIMDVectorInt a, SIMDVectorInt b)
+{
+  return vecGreaterThanUInt(b, a);
+}
+
+// ----------------------------------------------------------------
+// gather: load base[indices[i]] into each lane i.
+
+inline SIMDVectorFloat vecGather(const float* base, SIMDVectorInt indices)
+{
+  SIMDVectorIntUnion u;
+  u.v = indices;
+  return _mm_setr_ps(base[u.i[0]], base[u.i[1]], base[u.i[2]], base[u.i[3]]);
 }
 
 // ----------------------------------------------------------------
@@ -729,7 +832,16 @@ inline void vecSinCos(SIMDVectorFloat x, SIMDVectorFloat* s, SIMDVectorFloat* c)
   *c = _mm_xor_ps(xmm2, sign_bit_cos);
 }
 
+// tangent from one evaluation of vecSinCos.
+inline SIMDVectorFloat vecTan(SIMDVectorFloat x)
+{
+  SIMDVectorFloat s, c;
+  vecSinCos(x, &s, &c);
+  return vecDiv(s, c);
+}
+
 #define STATIC_M128_CONST(name, val) static constexpr __m128 name = {val, val, val, val};
+#define STATIC_SIMD_CONST STATIC_M128_CONST
 
 // fast polynomial approximations
 // from scalar code by Jacques-Henri Jourdan <jourgun@gmail.com>
@@ -890,6 +1002,35 @@ inline SIMDVectorFloat vecShuffleLeft(SIMDVectorFloat v1, SIMDVectorFloat v2)
   return _mm_shuffle_ps(v1, _mm_shuffle_ps(v1, v2, SHUFFLE(0, 0, 3, 3)), SHUFFLE(3, 0, 2, 1));
 }
 
+// ----------------------------------------------------------------
+// scans
+
+// Given vector [ a, b, c, d ]
+// Returns [ a, a+b, a+b+c, a+b+c+d ]
+inline SIMDVectorFloat vecPrefixSum(SIMDVectorFloat v)
+{
+  v = _mm_add_ps(v, VecI2F(_mm_slli_si128(VecF2I(v), 4)));
+  return _mm_add_ps(v, VecI2F(_mm_slli_si128(VecF2I(v), 8)));
+}
+
+inline SIMDVectorInt vecPrefixSumInt(SIMDVectorInt v)
+{
+  v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+  return _mm_add_epi32(v, _mm_slli_si128(v, 8));
+}
+
+// Given vector [ a, b, c, d ]
+// Returns [ d, d, d, d ]
+inline SIMDVectorFloat vecBroadcastLast(SIMDVectorFloat v)
+{
+  return _mm_shuffle_ps(v, v, SHUFFLE(3, 3, 3, 3));
+}
+
+inline SIMDVectorInt vecBroadcastLastInt(SIMDVectorInt v)
+{
+  return _mm_shuffle_epi32(v, SHUFFLE(3, 3, 3, 3));
+}
+
 // define infix operators for native SSE / MSVC.
 #ifndef ML_SSE_TO_NEON
 #ifdef WIN32
@@ -33,6 +33,7 @@
 #include <iostream>
 #include <iterator>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "MLDSPMath.h"
@@ -79,6 +80,269 @@ inline T* DSPVectorAlignPointer(const T* p)
 
 #endif
 
+// ----------------------------------------------------------------
+// expression templates
+//
+// Each arithmetic operator on DSPVectorArrays computes its whole result, so
+// an expression like a*b + c*d writes and reads back two temporaries. Wrapping
+// an operand in lazy() makes the operators return small expression objects
+// instead, which are evaluated when a DSPVectorArray is constructed or assigned
+// from them. The whole chain is then computed in a single load-compute-store
+// pass over each SIMD vector:
+//
+//   DSPVector y = lazy(a)*b + lazy(c)*d;
+//
+// Expressions refer to their named DSPVectorArray operands and copy temporary
+// ones. So an expression must not outlive its named operands: don't return one
+// from a function or keep one in an auto variable past the operands' scope.
+// This is why the operators on plain DSPVectorArrays stay eager.
+
+namespace ml
+{
+template <size_t ROWS>
+class DSPVectorArray;
+
+namespace expressions
+{
+// leaf referring to a named DSPVectorArray.
+template <size_t ROWS>
+struct Ref
+{
+  const float* px;
+  inline SIMDVectorFloat evalSIMD(int n) const { return vecLoad(px + n * kFloatsPerSIMDVector); }
+  inline float operator[](int i) const { return px[i]; }
+};
+
+// leaf holding a temporary DSPVectorArray by value.
+template <size_t ROWS>
+struct Value
+{
+  DSPVectorArray<ROWS> x;
+  inline SIMDVectorFloat evalSIMD(int n) const
+  {
+    return vecLoad(x.getConstBuffer() + n * kFloatsPerSIMDVector);
+  }
+  inline float operator[](int i) const { return x[i]; }
+};
+
+// leaf for a scalar operand, broadcast to each element.
+struct Scalar
+{
+  float k;
+  inline SIMDVectorFloat evalSIMD(int) const { return vecSet1(k); }
+  inline float operator[](int) const { return k; }
+};
+
+// operations
+struct Add
+{
+  static inline SIMDVectorFloat apply(SIMDVectorFloat x1, SIMDVectorFloat x2) { return vecAdd(x1, x2); }
+  static inline float apply(float x1, float x2) { return x1 + x2; }
+};
+
+struct Subtract
+{
+  static inline SIMDVectorFloat apply(SIMDVectorFloat x1, SIMDVectorFloat x2) { return vecSub(x1, x2); }
+  static inline float apply(float x1, float x2) { return x1 - x2; }
+};
+
+struct Multiply
+{
+  static inline SIMDVectorFloat apply(SIMDVectorFloat x1, SIMDVectorFloat x2) { return vecMul(x1, x2); }
+  static inline float apply(float x1, float x2) { return x1 * x2; }
+};
+
+struct Divide
+{
+  static inline SIMDVectorFloat apply(SIMDVectorFloat x1, SIMDVectorFloat x2) { return vecDiv(x1, x2); }
+  static inline float apply(float x1, float x2) { return x1 / x2; }
+};
+
+// an unevaluated binary operation OP on two operands, with the shape of a
+// DSPVectorArray<ROWS>.
+template <size_t ROWS, class OP, class X1, class X2>
+class Binary
+{
+  X1 mX1;
+  X2 mX2;
+
+ public:
+  Binary(X1 x1, X2 x2) : mX1(std::move(x1)), mX2(std::move(x2)) {}
+
+  // compute SIMD vector n of the result.
+  inline SIMDVectorFloat evalSIMD(int n) const { return OP::apply(mX1.evalSIMD(n), mX2.evalSIMD(n)); }
+
+  // compute element i of the result.
+  inline float operator[](int i) const { return OP::apply(mX1[i], mX2[i]); }
+
+  // compute row j of the result. Defined below DSPVectorArray.
+  inline DSPVectorArray<1> constRow(int j) const;
+};
+
+// an expression made of a single leaf, returned by lazy().
+template <size_t ROWS, class X1>
+class Leaf
+{
+  X1 mX1;
+
+ public:
+  Leaf(X1 x1) : mX1(std::move(x1)) {}
+  inline SIMDVectorFloat evalSIMD(int n) const { return mX1.evalSIMD(n); }
+  inline float operator[](int i) const { return mX1[i]; }
+  inline DSPVectorArray<1> constRow(int j) const;
+};
+
+// traits: the number of rows of an operand (0 for scalars), and its kind.
+template <class T>
+struct Traits
+{
+  static constexpr size_t kRows = 0;
+  static constexpr bool kIsArray = false;
+  static constexpr bool kIsExpression = false;
+  static constexpr bool kIsOperand = std::is_arithmetic<T>::value;
+};
+
+template <size_t ROWS>
+struct Traits<DSPVectorArray<ROWS> >
+{
+  static constexpr size_t kRows = ROWS;
+  static constexpr bool kIsArray = true;
+  static constexpr bool kIsExpression = false;
+  static constexpr bool kIsOperand = true;
+};
+
+template <size_t ROWS, class OP, class X1, class X2>
+struct Traits<Binary<ROWS, OP, X1, X2> >
+{
+  static constexpr size_t kRows = ROWS;
+  static constexpr bool kIsArray = false;
+  static constexpr bool kIsExpression = true;
+  static constexpr bool kIsOperand = true;
+};
+
+template <size_t ROWS, class X1>
+struct Traits<Leaf<ROWS, X1> >
+{
+  static constexpr size_t kRows = ROWS;
+  static constexpr bool kIsArray = false;
+  static constexpr bool kIsExpression = true;
+  static constexpr bool kIsOperand = true;
+};
+
+template <class T>
+using TraitsOf = Traits<typename std::decay<T>::type>;
+
+// two operands make an expression if at least one is an expression, and the
+// row counts match. Operators on two plain DSPVectorArrays are not lazy.
+template <class A, class B>
+constexpr bool isValidBinary()
+{
+  return TraitsOf<A>::kIsOperand && TraitsOf<B>::kIsOperand &&
+         (TraitsOf<A>::kIsExpression || TraitsOf<B>::kIsExpression) &&
+         ((TraitsOf<A>::kRows == TraitsOf<B>::kRows) || !TraitsOf<A>::kRows ||
+          !TraitsOf<B>::kRows);
+}
+
+template <class A, class B>
+using EnableIfBinary = typename std::enable_if<isValidBinary<A, B>()>::type;
+
+template <class E, size_t ROWS>
+using EnableIfExpressionRows =
+    typename std::enable_if<TraitsOf<E>::kIsExpression && (TraitsOf<E>::kRows == ROWS)>::type;
+
+template <class E>
+using EnableIfExpression = typename std::enable_if<TraitsOf<E>::kIsExpression>::type;
+
+// arrays or expressions with matching rows, at least one of them an expression.
+template <class... Args>
+constexpr bool anyExpression()
+{
+  return (TraitsOf<Args>::kIsExpression || ...);
+}
+
+template <class A, class... Args>
+constexpr bool sameRows()
+{
+  return (((TraitsOf<Args>::kIsArray || TraitsOf<Args>::kIsExpression) &&
+           (TraitsOf<Args>::kRows == TraitsOf<A>::kRows)) &&
+          ...);
+}
+
+template <class A, class... Args>
+using EnableIfMixedExpressions = typename std::enable_if<
+    (TraitsOf<A>::kIsArray || TraitsOf<A>::kIsExpression) && sameRows<A, Args...>() &&
+    anyExpression<A, Args...>()>::type;
+
+// make the operand stored in an expression.
+template <size_t ROWS>
+inline Ref<ROWS> makeOperand(const DSPVectorArray<ROWS>& x)
+{
+  return Ref<ROWS>{x.getConstBuffer()};
+}
+
+template <size_t ROWS>
+inline Value<ROWS> makeOperand(DSPVectorArray<ROWS>&& x)
+{
+  return Value<ROWS>{std::move(x)};
+}
+
+template <size_t ROWS, class OP, class X1, class X2>
+inline Binary<ROWS, OP, X1, X2> makeOperand(const Binary<ROWS, OP, X1, X2>& x)
+{
+  return x;
+}
+
+template <size_t ROWS, class X1>
+inline Leaf<ROWS, X1> makeOperand(const Leaf<ROWS, X1>& x)
+{
+  return x;
+}
+
+template <class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+inline Scalar makeOperand(T k)
+{
+  return Scalar{static_cast<float>(k)};
+}
+
+template <class OP, class A, class B>
+inline auto makeBinary(A&& a, B&& b)
+{
+  constexpr size_t kRows = TraitsOf<A>::kRows ? TraitsOf<A>::kRows : TraitsOf<B>::kRows;
+  auto x1 = makeOperand(std::forward<A>(a));
+  auto x2 = makeOperand(std::forward<B>(b));
+  return Binary<kRows, OP, decltype(x1), decltype(x2)>(std::move(x1), std::move(x2));
+}
+
+// evaluate an operand to a DSPVectorArray. For arrays this is a no-op.
+template <size_t ROWS>
+inline const DSPVectorArray<ROWS>& evaluate(const DSPVectorArray<ROWS>& x)
+{
+  return x;
+}
+
+template <class E, typename = EnableIfExpression<E> >
+inline DSPVectorArray<TraitsOf<E>::kRows> evaluate(const E& e)
+{
+  return DSPVectorArray<TraitsOf<E>::kRows>(e);
+}
+
+}  // namespace expressions
+
+// start a lazy expression from a DSPVectorArray.
+template <size_t ROWS>
+inline expressions::Leaf<ROWS, expressions::Ref<ROWS> > lazy(const DSPVectorArray<ROWS>& x)
+{
+  return expressions::Leaf<ROWS, expressions::Ref<ROWS> >(expressions::makeOperand(x));
+}
+
+template <size_t ROWS>
+inline expressions::Leaf<ROWS, expressions::Value<ROWS> > lazy(DSPVectorArray<ROWS>&& x)
+{
+  return expressions::Leaf<ROWS, expressions::Value<ROWS> >(
+      expressions::makeOperand(std::move(x)));
+}
+}  // namespace ml
+
 // ----------------------------------------------------------------
 // DSPVectorArray
 //
@@ -91,6 +355,14 @@ inline T* DSPVectorAlignPointer(const T* p)
 
 namespace ml
 {
+// Tag for constructing a DSPVectorArray or DSPVectorArrayInt without
+// initializing its data. Use only when every element will be written before
+// it is read, as in the operations below.
+struct UninitializedTag
+{
+};
+constexpr UninitializedTag kUninitialized{};
+
 template <size_t ROWS>
 class DSPVectorArray
 {
@@ -149,9 +421,11 @@ class DSPVectorArray
   // rewrite without std::function
 
   // default constructor: zeroes the data.
-  // TODO this seems to be taking a lot of time! investigate
   DSPVectorArray() { mData.mArrayData.fill(0.f); }
 
+  // construct without initializing the data. see UninitializedTag.
+  explicit DSPVectorArray(UninitializedTag) {}
+
   // conversion constructor to float.  This keeps the syntax of common DSP code
   // shorter: "va + DSPVector(1.f)" becomes just "va + 1.f".
   DSPVectorArray(float k) { operator=(k); }
@@ -181,13 +455,42 @@ class DSPVectorArray
     return *this;
   }
 
-  // default copy and = constructors.
+  // default copy, move and = constructors.
 
   DSPVectorArray(const DSPVectorArray& x1) noexcept = default;
+  DSPVectorArray(DSPVectorArray&& x1) noexcept = default;
   DSPVectorArray& operator=(const DSPVectorArray& x1) noexcept = default;
+  DSPVectorArray& operator=(DSPVectorArray&& x1) noexcept = default;
+
+  // construct from or assign an expression, evaluating it in a single pass.
+  template <class E, typename = expressions::EnableIfExpressionRows<E, ROWS> >
+  DSPVectorArray(const E& e)
+  {
+    evaluate(e);
+  }
+
+  template <class E, typename = expressions::EnableIfExpressionRows<E, ROWS> >
+  inline DSPVectorArray& operator=(const E& e)
+  {
+    evaluate(e);
+    return *this;
+  }
+
+  // store each SIMD vector of the expression e. Because all the expression
+  // operations are elementwise, e may refer to this DSPVectorArray.
+  template <class E>
+  inline void evaluate(const E& e)
+  {
+    float* py1 = getBuffer();
+    for (int n = 0; n < kSIMDVectorsPerDSPVector * ROWS; ++n)
+    {
+      vecStore(py1, e.evalSIMD(n));
+      py1 += kFloatsPerSIMDVector;
+    }
+  }
 
   // equality by value
-  bool operator==(const DSPVectorArray& x1)
+  bool operator==(const DSPVectorArray& x1) const
   {
     const float* px1 = x1.getConstBuffer();
     const float* py1 = getConstBuffer();
@@ -223,7 +526,7 @@ class DSPVectorArray
   // get a row vector j when j is not known at compile time.
   inline DSPVectorArray<1> getRowVectorUnchecked(int j) const
   {
-    DSPVectorArray<1> vy;
+    DSPVectorArray<1> vy(kUninitialized);
     const float* px1 = getConstBuffer() + kFloatsPerDSPVector * j;
     float* py1 = vy.getBuffer();
 
@@ -250,7 +553,7 @@ class DSPVectorArray
   // get a row vector j when j is not known at compile time.
   inline DSPVectorArray<1> getRowVectorUnchecked(int j) const
   {
-    DSPVectorArray<1> vy;
+    DSPVectorArray<1> vy(kUninitialized);
     const float* px1 = getConstBuffer() + kFloatsPerDSPVector * j;
     float* py1 = vy.getBuffer();
 
@@ -330,6 +633,32 @@ class DSPVectorArray
     return *this;
   }
 
+  // compound assignment from an expression, evaluated in place in a single pass.
+  template <class E, typename = expressions::EnableIfExpressionRows<E, ROWS> >
+  inline DSPVectorArray& operator+=(const E& e)
+  {
+    evaluate(lazy(*this) + e);
+    return *this;
+  }
+  template <class E, typename = expressions::EnableIfExpressionRows<E, ROWS> >
+  inline DSPVectorArray& operator-=(const E& e)
+  {
+    evaluate(lazy(*this) - e);
+    return *this;
+  }
+  template <class E, typename = expressions::EnableIfExpressionRows<E, ROWS> >
+  inline DSPVectorArray& operator*=(const E& e)
+  {
+    evaluate(lazy(*this) * e);
+    return *this;
+  }
+  template <class E, typename = expressions::EnableIfExpressionRows<E, ROWS> >
+  inline DSPVectorArray& operator/=(const E& e)
+  {
+    evaluate(lazy(*this) / e);
+    return *this;
+  }
+
   // binary operators - defining these here inside the class as non-template
   // functions enables the compiler to call implicit conversions on either
   // argument.
@@ -360,6 +689,63 @@ class DSPVectorArray
 
 typedef DSPVectorArray<1> DSPVector;
 
+namespace expressions
+{
+// evaluate row j of an expression.
+template <class E>
+inline DSPVectorArray<1> evaluateRow(const E& e, int j)
+{
+  DSPVectorArray<1> vy(kUninitialized);
+  float* py1 = vy.getBuffer();
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+  {
+    vecStore(py1, e.evalSIMD(j * kSIMDVectorsPerDSPVector + n));
+    py1 += kFloatsPerSIMDVector;
+  }
+  return vy;
+}
+
+template <size_t ROWS, class OP, class X1, class X2>
+inline DSPVectorArray<1> Binary<ROWS, OP, X1, X2>::constRow(int j) const
+{
+  return evaluateRow(*this, j);
+}
+
+template <size_t ROWS, class X1>
+inline DSPVectorArray<1> Leaf<ROWS, X1>::constRow(int j) const
+{
+  return evaluateRow(*this, j);
+}
+
+// ----------------------------------------------------------------
+// lazy arithmetic operators
+//
+// Operands can be DSPVectorArrays, expressions or scalars, as long as the row
+// counts match and at least one operand is an expression. See "expression
+// templates" above. These are in the expressions namespace so that argument-
+// dependent lookup finds them for expression operands.
+
+#define DEFINE_EXPRESSION_OP2(opSymbol, opStruct)                                         \
+  template <class A, class B, typename = expressions::EnableIfBinary<A, B> >              \
+  inline auto operator opSymbol(A&& x1, B&& x2)                                           \
+  {                                                                                       \
+    return expressions::makeBinary<expressions::opStruct>(std::forward<A>(x1),            \
+                                                          std::forward<B>(x2));           \
+  }
+
+DEFINE_EXPRESSION_OP2(+, Add);
+DEFINE_EXPRESSION_OP2(-, Subtract);
+DEFINE_EXPRESSION_OP2(*, Multiply);
+DEFINE_EXPRESSION_OP2(/, Divide);
+
+// equality by value of arrays and expressions.
+template <class A, class B, typename = expressions::EnableIfMixedExpressions<A, B> >
+inline bool operator==(const A& x1, const B& x2)
+{
+  return expressions::evaluate(x1) == expressions::evaluate(x2);
+}
+}  // namespace expressions
+
 // ----------------------------------------------------------------
 // DSPVectorArrayInt
 //
@@ -421,6 +807,7 @@ class DSPVectorArrayInt
 #endif  // MANUAL_ALIGN_DSPVECTOR
 
   explicit DSPVectorArrayInt() { operator=(0); }
+  explicit DSPVectorArrayInt(UninitializedTag) {}
   explicit DSPVectorArrayInt(int32_t k) { operator=(k); }
 
   inline int32_t& operator[](int i) { return getBufferInt()[i]; }
@@ -493,6 +880,41 @@ class DSPVectorArrayInt
     return subtractInt32(x1, x2);
   }
 
+  friend inline DSPVectorArrayInt operator*(const DSPVectorArrayInt& x1,
+                                            const DSPVectorArrayInt& x2)
+  {
+    return multiplyInt32(x1, x2);
+  }
+
+  friend inline DSPVectorArrayInt operator&(const DSPVectorArrayInt& x1,
+                                            const DSPVectorArrayInt& x2)
+  {
+    return andInt32(x1, x2);
+  }
+
+  friend inline DSPVectorArrayInt operator|(const DSPVectorArrayInt& x1,
+                                            const DSPVectorArrayInt& x2)
+  {
+    return orInt32(x1, x2);
+  }
+
+  friend inline DSPVectorArrayInt operator^(const DSPVectorArrayInt& x1,
+                                            const DSPVectorArrayInt& x2)
+  {
+    return xorInt32(x1, x2);
+  }
+
+  // shifts treat the elements as unsigned.
+  friend inline DSPVectorArrayInt operator<<(const DSPVectorArrayInt& x1, int bits)
+  {
+    return shiftLeftInt32(x1, bits);
+  }
+
+  friend inline DSPVectorArrayInt operator>>(const DSPVectorArrayInt& x1, int bits)
+  {
+    return shiftRightInt32(x1, bits);
+  }
+
 };  // class DSPVectorArrayInt
 
 typedef DSPVectorArrayInt<1> DSPVectorInt;
@@ -572,7 +994,7 @@ inline void storeAligned(const DSPVectorArray<ROWS>& vecSrc, float* pDest)
   template <size_t ROWS>                                               \
   inline DSPVectorArray<ROWS>(opName)(const DSPVectorArray<ROWS>& vx1) \
   {                                                                    \
-    DSPVectorArray<ROWS> vy;                                           \
+    DSPVectorArray<ROWS> vy(kUninitialized);                           \
     const float* px1 = vx1.getConstBuffer();                           \
     float* py1 = vy.getBuffer();                                       \
     for (int n = 0; n < kSIMDVectorsPerDSPVector * ROWS; ++n)          \
@@ -583,6 +1005,11 @@ inline void storeAligned(const DSPVectorArray<ROWS>& vecSrc, float* pDest)
       py1 += kFloatsPerSIMDVector;                                     \
     }                                                                  \
     return vy;                                                         \
+  }                                                                    \
+  template <class E, typename = expressions::EnableIfExpression<E> >   \
+  inline auto(opName)(const E& e)                                      \
+  {                                                                    \
+    return (opName)(expressions::evaluate(e));                         \
   }
 
 DEFINE_OP1(sqrt, (vecSqrt(x)));
@@ -595,17 +1022,51 @@ DEFINE_OP1(sign, vecSign(x));
 // up/down sign: -1 or 1
 DEFINE_OP1(signBit, vecSignBit(x));
 
-// trig, log and exp, using accurate cephes-derived library
+// trig, log and exp, using accurate cephes-derived library. Where runtime
+// dispatch is enabled, these use the kernels in MLDSPMathDispatch.h, which
+// compute the same functions at the widest vector size the CPU supports.
+#if ML_SIMD_DISPATCH
+
+#define DEFINE_DISPATCHED_OP1(opName, opKernel)                                 \
+  template <size_t ROWS>                                                        \
+  inline DSPVectorArray<ROWS>(opName)(const DSPVectorArray<ROWS>& vx1)          \
+  {                                                                             \
+    DSPVectorArray<ROWS> vy(kUninitialized);                                    \
+    opKernel(vx1.getConstBuffer(), vy.getBuffer(), kFloatsPerDSPVector * ROWS); \
+    return vy;                                                                  \
+  }                                                                             \
+  template <class E, typename = expressions::EnableIfExpression<E> >            \
+  inline auto(opName)(const E& e)                                               \
+  {                                                                             \
+    return (opName)(expressions::evaluate(e));                                  \
+  }
+
+DEFINE_DISPATCHED_OP1(sin, dispatch::sinKernel);
+DEFINE_DISPATCHED_OP1(cos, dispatch::cosKernel);
+DEFINE_OP1(tan, (vecTan(x)));
+DEFINE_DISPATCHED_OP1(log, dispatch::logKernel);
+DEFINE_DISPATCHED_OP1(exp, dispatch::expKernel);
+
+#else
+
 DEFINE_OP1(sin, (vecSin(x)));
 DEFINE_OP1(cos, (vecCos(x)));
+DEFINE_OP1(tan, (vecTan(x)));
 DEFINE_OP1(log, (vecLog(x)));
 DEFINE_OP1(exp, (vecExp(x)));
 
+#endif
+
 // lazy log2 and exp2 from natural log / exp
-STATIC_M128_CONST(kLogTwoVec, 0.69314718055994529f);
-STATIC_M128_CONST(kLogTwoRVec, 1.4426950408889634f);
+STATIC_SIMD_CONST(kLogTwoVec, 0.69314718055994529f);
+STATIC_SIMD_CONST(kLogTwoRVec, 1.4426950408889634f);
+#if ML_SIMD_DISPATCH
+DEFINE_DISPATCHED_OP1(log2, dispatch::log2Kernel);
+DEFINE_DISPATCHED_OP1(exp2, dispatch::exp2Kernel);
+#else
 DEFINE_OP1(log2, (vecMul(vecLog(x), kLogTwoRVec)));
 DEFINE_OP1(exp2, (vecExp(vecMul(kLogTwoVec, x))));
+#endif
 
 // trig, log and exp, using polynomial approximations
 DEFINE_OP1(sinApprox, (vecSinApprox(x)));
@@ -625,7 +1086,7 @@ template <size_t ROWS>                                               \
 inline DSPVectorArray<ROWS>(opName)(const DSPVectorArray<ROWS>& vx1, \
 const DSPVectorArray<ROWS>& vx2) \
 {                                                                    \
-DSPVectorArray<ROWS> vy;                                           \
+DSPVectorArray<ROWS> vy(kUninitialized);                           \
 const float* px1 = vx1.getConstBuffer();                           \
 const float* px2 = vx2.getConstBuffer();                           \
 float* py1 = vy.getBuffer();                                       \
@@ -639,6 +1100,11 @@ px2 += kFloatsPerSIMDVector;                                     \
 py1 += kFloatsPerSIMDVector;                                     \
 }                                                                  \
 return vy;                                                         \
+}\
+template <class A, class B, typename = expressions::EnableIfMixedExpressions<A, B> >\
+inline auto(opName)(const A& x1, const B& x2)\
+{\
+return (opName)(expressions::evaluate(x1), expressions::evaluate(x2));\
 }
 
 DEFINE_OP2(add, (vecAdd(x1, x2)));
@@ -647,7 +1113,24 @@ DEFINE_OP2(multiply, (vecMul(x1, x2)));
 DEFINE_OP2(divide, (vecDiv(x1, x2)));
 
 DEFINE_OP2(divideApprox, vecDivApprox(x1, x2));
+
+#if ML_SIMD_DISPATCH
+template <size_t ROWS>
+inline DSPVectorArray<ROWS> pow(const DSPVectorArray<ROWS>& vx1, const DSPVectorArray<ROWS>& vx2)
+{
+  DSPVectorArray<ROWS> vy(kUninitialized);
+  dispatch::powKernel(vx1.getConstBuffer(), vx2.getConstBuffer(), vy.getBuffer(),
+                      kFloatsPerDSPVector * ROWS);
+  return vy;
+}
+template <class A, class B, typename = expressions::EnableIfMixedExpressions<A, B> >
+inline auto pow(const A& x1, const B& x2)
+{
+  return pow(expressions::evaluate(x1), expressions::evaluate(x2));
+}
+#else
 DEFINE_OP2(pow, (vecExp(vecMul(vecLog(x1), x2))));
+#endif
 DEFINE_OP2(powApprox, (vecExpApprox(vecMul(vecLogApprox(x1), x2))));
 DEFINE_OP2(min, (vecMin(x1, x2)));
 DEFINE_OP2(max, (vecMax(x1, x2)));
@@ -661,7 +1144,7 @@ template <size_t ROWS>\
 inline DSPVectorArray<ROWS>(opName)(const DSPVectorArray<ROWS>& vx1,\
 const DSPVectorArray<1>& vx2)\
 {\
-DSPVectorArray<ROWS> vy;\
+DSPVectorArray<ROWS> vy(kUninitialized); \
 const float* px1 = vx1.getConstBuffer();\
 const float* px2 = vx2.getConstBuffer();\
 float* py1 = vy.getBuffer();\
@@ -698,7 +1181,7 @@ DEFINE_OP2_MS(max1, (vecMax(x1, x2)));
   inline DSPVectorArrayInt<ROWS>(opName)(const DSPVectorArrayInt<ROWS>& vx1, \
                                          const DSPVectorArrayInt<ROWS>& vx2) \
   {                                                                          \
-    DSPVectorArrayInt<ROWS> vy;                                              \
+    DSPVectorArrayInt<ROWS> vy(kUninitialized);                              \
     const float* px1 = vx1.getConstBuffer();                                 \
     const float* px2 = vx2.getConstBuffer();                                 \
     float* py1 = vy.getBuffer();                                             \
@@ -716,6 +1199,50 @@ DEFINE_OP2_MS(max1, (vecMax(x1, x2)));
 
 DEFINE_OP2_INT32(subtractInt32, (vecSubInt(x1, x2)));
 DEFINE_OP2_INT32(addInt32, (vecAddInt(x1, x2)));
+DEFINE_OP2_INT32(multiplyInt32, (vecMulInt(x1, x2)));  // low 32 bits, same signed or unsigned
+
+DEFINE_OP2_INT32(andInt32, (vecAndInt(x1, x2)));
+DEFINE_OP2_INT32(andNotInt32, (vecAndNotInt(x1, x2)));  // (~x1) & x2
+DEFINE_OP2_INT32(orInt32, (vecOrInt(x1, x2)));
+DEFINE_OP2_INT32(xorInt32, (vecXorInt(x1, x2)));
+
+DEFINE_OP2_INT32(minInt32, (vecMinInt(x1, x2)));
+DEFINE_OP2_INT32(maxInt32, (vecMaxInt(x1, x2)));
+DEFINE_OP2_INT32(minUInt32, (vecMinUInt(x1, x2)));
+DEFINE_OP2_INT32(maxUInt32, (vecMaxUInt(x1, x2)));
+
+// comparisons returning int masks, usable with select().
+DEFINE_OP2_INT32(equalInt32, (vecEqualInt(x1, x2)));
+DEFINE_OP2_INT32(greaterThanInt32, (vecGreaterThanInt(x1, x2)));
+DEFINE_OP2_INT32(lessThanInt32, (vecLessThanInt(x1, x2)));
+DEFINE_OP2_INT32(greaterThanUInt32, (vecGreaterThanUInt(x1, x2)));
+DEFINE_OP2_INT32(lessThanUInt32, (vecLessThanUInt(x1, x2)));
+
+// ----------------------------------------------------------------
+// shift operators (int32, int) -> int32
+
+#define DEFINE_OP1_INT32_SHIFT(opName, opComputation)                        \
+  template <size_t ROWS>                                                     \
+  inline DSPVectorArrayInt<ROWS>(opName)(const DSPVectorArrayInt<ROWS>& vx1, \
+                                         int bits)                           \
+  {                                                                          \
+    DSPVectorArrayInt<ROWS> vy(kUninitialized);                              \
+    const float* px1 = vx1.getConstBuffer();                                 \
+    float* py1 = vy.getBuffer();                                             \
+    for (int n = 0; n < kSIMDVectorsPerDSPVector * ROWS; ++n)                \
+    {                                                                        \
+      SIMDVectorInt x1 = VecF2I(vecLoad(px1));                               \
+      vecStore(py1, VecI2F(opComputation));                                  \
+      px1 += kIntsPerSIMDVector;                                             \
+      py1 += kIntsPerSIMDVector;                                             \
+    }                                                                        \
+    return vy;                                                               \
+  }
+
+DEFINE_OP1_INT32_SHIFT(shiftLeftInt32, (vecShiftLeftInt32(x1, bits)));
+DEFINE_OP1_INT32_SHIFT(shiftRightInt32, (vecShiftRightInt32(x1, bits)));  // shifts in zeros
+DEFINE_OP1_INT32_SHIFT(shiftRightArithmeticInt32,
+                       (vecShiftRightArithmeticInt32(x1, bits)));  // shifts in the sign bit
 
 // ----------------------------------------------------------------
 // ternary vector operators (float, float, float) -> float
@@ -726,7 +1253,7 @@ DEFINE_OP2_INT32(addInt32, (vecAddInt(x1, x2)));
                                       const DSPVectorArray<ROWS>& vx2, \
                                       const DSPVectorArray<ROWS>& vx3) \
   {                                                                    \
-    DSPVectorArray<ROWS> vy;                                           \
+    DSPVectorArray<ROWS> vy(kUninitialized);                           \
     const float* px1 = vx1.getConstBuffer();                           \
     const float* px2 = vx2.getConstBuffer();                           \
     const float* px3 = vx3.getConstBuffer();                           \
@@ -743,9 +1270,18 @@ DEFINE_OP2_INT32(addInt32, (vecAddInt(x1, x2)));
       py1 += kFloatsPerSIMDVector;                                     \
     }                                                                  \
     return vy;                                                         \
+  }                                                                    \
+  template <class A, class B, class C,                                 \
+            typename = expressions::EnableIfMixedExpressions<A, B, C> > \
+  inline auto(opName)(const A& x1, const B& x2, const C& x3)           \
+  {                                                                    \
+    return (opName)(expressions::evaluate(x1), expressions::evaluate(x2), \
+                    expressions::evaluate(x3));                        \
   }
 
-DEFINE_OP3(lerp, vecAdd(x1, (vecMul(x3, vecSub(x2, x1)))));       // x = lerp(a, b, mix)
+DEFINE_OP3(fma, vecFMA(x1, x2, x3));                              // x1*x2 + x3, fused if possible
+DEFINE_OP3(fms, vecFMS(x1, x2, x3));                              // x1*x2 - x3, fused if possible
+DEFINE_OP3(lerp, vecFMA(x3, vecSub(x2, x1), x1));                 // x = lerp(a, b, mix)
 DEFINE_OP3(inverseLerp, vecDiv(vecSub(x3, x1), vecSub(x2, x1)));  // mix = inverseLerp(a, b, x)
 
 DEFINE_OP3(clamp, vecClamp(x1, x2, x3));    // clamp(x, minBound, maxBound)
@@ -758,7 +1294,7 @@ template <size_t ROWS>
 inline DSPVectorArray<ROWS> lerp(const DSPVectorArray<ROWS>& vx1, const DSPVectorArray<ROWS>& vx2,
                                  float m)
 {
-  DSPVectorArray<ROWS> vy;
+  DSPVectorArray<ROWS> vy(kUninitialized);
   const float* px1 = vx1.getConstBuffer();
   const float* px2 = vx2.getConstBuffer();
   DSPVector vmix(m);
@@ -769,7 +1305,7 @@ inline DSPVectorArray<ROWS> lerp(const DSPVectorArray<ROWS>& vx1, const DSPVecto
   {
     SIMDVectorFloat x1 = vecLoad(px1);
     SIMDVectorFloat x2 = vecLoad(px2);
-    vecStore(py1, vecAdd(x1, (vecMul(vConstMix, vecSub(x2, x1)))));
+    vecStore(py1, vecFMA(vConstMix, vecSub(x2, x1), x1));
     px1 += kFloatsPerSIMDVector;
     px2 += kFloatsPerSIMDVector;
     py1 += kFloatsPerSIMDVector;
@@ -784,7 +1320,7 @@ inline DSPVectorArray<ROWS> lerp(const DSPVectorArray<ROWS>& vx1, const DSPVecto
   template <size_t ROWS>                                                  \
   inline DSPVectorArrayInt<ROWS>(opName)(const DSPVectorArray<ROWS>& vx1) \
   {                                                                       \
-    DSPVectorArrayInt<ROWS> vy;                                           \
+    DSPVectorArrayInt<ROWS> vy(kUninitialized);                           \
     const float* px1 = vx1.getConstBuffer();                              \
     float* py1 = vy.getBuffer();                                          \
     for (int n = 0; n < kSIMDVectorsPerDSPVector * ROWS; ++n)             \
@@ -795,10 +1331,16 @@ inline DSPVectorArray<ROWS> lerp(const DSPVectorArray<ROWS>& vx1, const DSPVecto
       py1 += kIntsPerSIMDVector;                                          \
     }                                                                     \
     return vy;                                                            \
+  }                                                                       \
+  template <class E, typename = expressions::EnableIfExpression<E> >      \
+  inline auto(opName)(const E& e)                                         \
+  {                                                                       \
+    return (opName)(expressions::evaluate(e));                            \
   }
 
 DEFINE_OP1_F2I(roundFloatToInt, (VecI2F(vecFloatToIntRound(x))));
 DEFINE_OP1_F2I(truncateFloatToInt, (VecI2F(vecFloatToIntTruncate(x))));
+DEFINE_OP1_F2I(floatBitsToInt, (x));  // reinterpret the bits of each float
 
 // ----------------------------------------------------------------
 // vector operators (int) -> float
@@ -807,7 +1349,7 @@ DEFINE_OP1_F2I(truncateFloatToInt, (VecI2F(vecFloatToIntTruncate(x))));
   template <size_t ROWS>                                                  \
   inline DSPVectorArray<ROWS>(opName)(const DSPVectorArrayInt<ROWS>& vx1) \
   {                                                                       \
-    DSPVectorArray<ROWS> vy;                                              \
+    DSPVectorArray<ROWS> vy(kUninitialized);                              \
     const float* px1 = vx1.getConstBuffer();                              \
     float* py1 = vy.getBuffer();                                          \
     for (int n = 0; n < kSIMDVectorsPerDSPVector * ROWS; ++n)             \
@@ -822,6 +1364,7 @@ DEFINE_OP1_F2I(truncateFloatToInt, (VecI2F(vecFloatToIntTruncate(x))));
 
 DEFINE_OP1_I2F(intToFloat, (vecIntToFloat(x)));
 DEFINE_OP1_I2F(unsignedIntToFloat, (vecUnsignedIntToFloat(x)));
+DEFINE_OP1_I2F(intBitsToFloat, (VecI2F(x)));  // reinterpret the bits of each int
 
 // ----------------------------------------------------------------
 // using the conversions above, define fractionalPart
@@ -836,7 +1379,7 @@ DEFINE_OP1(fractionalPart, (vecSub(x, vecIntToFloat(vecFloatToIntTruncate(x)))))
   inline DSPVectorArrayInt<ROWS>(opName)(const DSPVectorArray<ROWS>& vx1, \
                                          const DSPVectorArray<ROWS>& vx2) \
   {                                                                       \
-    DSPVectorArrayInt<ROWS> vy;                                           \
+    DSPVectorArrayInt<ROWS> vy(kUninitialized);                           \
     const float* px1 = vx1.getConstBuffer();                              \
     const float* px2 = vx2.getConstBuffer();                              \
     float* py1 = vy.getBuffer();                                          \
@@ -850,6 +1393,12 @@ DEFINE_OP1(fractionalPart, (vecSub(x, vecIntToFloat(vecFloatToIntTruncate(x)))))
       py1 += kIntsPerSIMDVector;                                          \
     }                                                                     \
     return vy;                                                            \
+  }                                                                       \
+  template <class A, class B,                                             \
+            typename = expressions::EnableIfMixedExpressions<A, B> >      \
+  inline auto(opName)(const A& x1, const B& x2)                           \
+  {                                                                       \
+    return (opName)(expressions::evaluate(x1), expressions::evaluate(x2)); \
   }
 
 DEFINE_OP2_FF2I(equal, (vecEqual(x1, x2)));
@@ -868,7 +1417,7 @@ DEFINE_OP2_FF2I(lessThanOrEqual, (vecLessThanOrEqual(x1, x2)));
                                       const DSPVectorArray<ROWS>& vx2,    \
                                       const DSPVectorArrayInt<ROWS>& vx3) \
   {                                                                       \
-    DSPVectorArray<ROWS> vy;                                              \
+    DSPVectorArray<ROWS> vy(kUninitialized);                              \
     const float* px1 = vx1.getConstBuffer();                              \
     const float* px2 = vx2.getConstBuffer();                              \
     const float* px3 = vx3.getConstBuffer();                              \
@@ -885,6 +1434,12 @@ DEFINE_OP2_FF2I(lessThanOrEqual, (vecLessThanOrEqual(x1, x2)));
       py1 += kFloatsPerSIMDVector;                                        \
     }                                                                     \
     return vy;                                                            \
+  }                                                                       \
+  template <class A, class B, size_t ROWS,                                \
+            typename = expressions::EnableIfMixedExpressions<A, B> >      \
+  inline auto(opName)(const A& x1, const B& x2, const DSPVectorArrayInt<ROWS>& vx3) \
+  {                                                                       \
+    return (opName)(expressions::evaluate(x1), expressions::evaluate(x2), vx3); \
   }
 
 DEFINE_OP3_FFI2F(select, vecSelect(x1, x2, x3));  // bitwise select(resultIfTrue,
@@ -899,7 +1454,7 @@ DEFINE_OP3_FFI2F(select, vecSelect(x1, x2, x3));  // bitwise select(resultIfTrue
                                          const DSPVectorArrayInt<ROWS>& vx2, \
                                          const DSPVectorArrayInt<ROWS>& vx3) \
   {                                                                          \
-    DSPVectorArrayInt<ROWS> vy;                                              \
+    DSPVectorArrayInt<ROWS> vy(kUninitialized);                              \
     const float* px1 = vx1.getConstBuffer();                                 \
     const float* px2 = vx2.getConstBuffer();                                 \
     const float* px3 = vx3.getConstBuffer();                                 \
@@ -1038,13 +1593,68 @@ inline float min(const DSPVector& x)
   return fmin;
 }
 
+// return true if every element of x is equal to the first.
+inline bool isConstant(const DSPVector& x)
+{
+  const float* px1 = x.getConstBuffer();
+  const float x0 = px1[0];
+  for (int n = 1; n < kFloatsPerDSPVector; ++n)
+  {
+    if (px1[n] != x0) return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------
+// single-vector scans
+
+// inclusive prefix sum: return y where y[n] = start + x[0] + ... + x[n]. Each
+// SIMD vector is scanned in registers, then the running total is carried into
+// the next. To continue a sum across DSPVectors, pass the last element of the
+// previous result as start.
+inline DSPVector inclusiveScan(const DSPVector& x, float start = 0.f)
+{
+  DSPVector y(kUninitialized);
+  const float* px1 = x.getConstBuffer();
+  float* py1 = y.getBuffer();
+  SIMDVectorFloat carry = vecSet1(start);
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+  {
+    SIMDVectorFloat vy = vecAdd(vecPrefixSum(vecLoad(px1)), carry);
+    vecStore(py1, vy);
+    carry = vecBroadcastLast(vy);
+    px1 += kFloatsPerSIMDVector;
+    py1 += kFloatsPerSIMDVector;
+  }
+  return y;
+}
+
+// inclusive prefix sum of int32 values, wrapping on overflow. Use for unsigned
+// phase accumulators.
+inline DSPVectorInt inclusiveScan(const DSPVectorInt& x, int32_t start = 0)
+{
+  DSPVectorInt y(kUninitialized);
+  const float* px1 = x.getConstBuffer();
+  float* py1 = y.getBuffer();
+  SIMDVectorInt carry = vecSetInt1(start);
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+  {
+    SIMDVectorInt vy = vecAddInt(vecPrefixSumInt(VecF2I(vecLoad(px1))), carry);
+    vecStore(py1, VecI2F(vy));
+    carry = vecBroadcastLastInt(vy);
+    px1 += kIntsPerSIMDVector;
+    py1 += kIntsPerSIMDVector;
+  }
+  return y;
+}
+
 // ----------------------------------------------------------------
 // normalize
 
 template <size_t ROWS>
 inline DSPVectorArray<ROWS> normalize(const DSPVectorArray<ROWS>& x1)
 {
-  DSPVectorArray<ROWS> vy;
+  DSPVectorArray<ROWS> vy(kUninitialized);
   for (int j = 0; j < ROWS; ++j)
   {
     auto inputRow = x1.getRowVectorUnchecked(j);
@@ -1053,6 +1663,12 @@ inline DSPVectorArray<ROWS> normalize(const DSPVectorArray<ROWS>& x1)
   return vy;
 }
 
+template <class E, typename = expressions::EnableIfExpression<E> >
+inline auto normalize(const E& e)
+{
+  return normalize(expressions::evaluate(e));
+}
+
 // ----------------------------------------------------------------
 // row-wise operations and conversions
 
@@ -1061,7 +1677,7 @@ inline DSPVectorArray<ROWS> normalize(const DSPVectorArray<ROWS>& x1)
 template <size_t ROWS, size_t N>
 inline DSPVectorArray<ROWS * N> repeatRows(const DSPVectorArray<N>& x1)
 {
-  DSPVectorArray<ROWS * N> vy;
+  DSPVectorArray<ROWS * N> vy(kUninitialized);
   for (int j = 0, k = 0; j < ROWS * N; ++j)
   {
     vy.setRowVectorUnchecked(j, x1.getRowVectorUnchecked(k));
@@ -1076,7 +1692,7 @@ inline DSPVectorArray<ROWS * N> repeatRows(const DSPVectorArray<N>& x1)
 template <size_t ROWS, size_t N>
 inline DSPVectorArray<ROWS> stretchRows(const DSPVectorArray<N>& x)
 {
-  DSPVectorArray<ROWS> vy;
+  DSPVectorArray<ROWS> vy(kUninitialized);
   for (int j = 0; j < ROWS; ++j)
   {
     int k = roundf((j * (N - 1.f)) / (ROWS - 1.f));
@@ -1091,7 +1707,7 @@ inline DSPVectorArray<ROWS> stretchRows(const DSPVectorArray<N>& x)
 template <size_t ROWS, size_t N>
 inline DSPVectorArray<ROWS> zeroPadRows(const DSPVectorArray<N>& x)
 {
-  // default constructor currently zero-fills
+  // the default constructor zero-fills the padding rows
   DSPVectorArray<ROWS> vy;
   constexpr size_t rowsToCopy = min(ROWS, N);
   for (int j = 0; j < rowsToCopy; ++j)
@@ -1107,7 +1723,7 @@ inline DSPVectorArray<ROWS> zeroPadRows(const DSPVectorArray<N>& x)
 template <size_t ROWS>
 inline DSPVectorArray<ROWS> shiftRows(const DSPVectorArray<ROWS>& x, int rowsToShift)
 {
-  DSPVectorArray<ROWS> vy;
+  DSPVectorArray<ROWS> vy(kUninitialized);
   int k = -rowsToShift;
   for (int j = 0; j < ROWS; ++j)
   {
@@ -1130,7 +1746,7 @@ inline DSPVectorArray<ROWS> shiftRows(const DSPVectorArray<ROWS>& x, int rowsToS
 template <size_t ROWS>
 inline DSPVectorArray<ROWS> rotateRows(const DSPVectorArray<ROWS>& x, int rowsToRotate)
 {
-  DSPVectorArray<ROWS> vy;
+  DSPVectorArray<ROWS> vy(kUninitialized);
 
   // get start index k to which row 0 is mapped
   int k = modulo(-rowsToRotate, ROWS);
@@ -1150,7 +1766,7 @@ template <size_t ROWSA, size_t ROWSB>
 inline DSPVectorArray<ROWSA + ROWSB> concatRows(const DSPVectorArray<ROWSA>& x1,
                                                 const DSPVectorArray<ROWSB>& x2)
 {
-  DSPVectorArray<ROWSA + ROWSB> vy;
+  DSPVectorArray<ROWSA + ROWSB> vy(kUninitialized);
   for (int j = 0; j < ROWSA; ++j)
   {
     vy.setRowVectorUnchecked(j, x1.getRowVectorUnchecked(j));
@@ -1168,7 +1784,7 @@ inline DSPVectorArray<ROWSA + ROWSB + ROWSC> concatRows(const DSPVectorArray<ROW
                                                         const DSPVectorArray<ROWSB>& x2,
                                                         const DSPVectorArray<ROWSC>& x3)
 {
-  DSPVectorArray<ROWSA + ROWSB + ROWSC> vy;
+  DSPVectorArray<ROWSA + ROWSB + ROWSC> vy(kUninitialized);
   for (int j = 0; j < ROWSA; ++j)
   {
     vy.setRowVectorUnchecked(j, x1.getRowVectorUnchecked(j));
@@ -1198,7 +1814,7 @@ inline DSPVectorArray<ROWSA + ROWSB + ROWSC + ROWSD> concatRows(const DSPVectorA
                                                                 const DSPVectorArray<ROWSC>& x3,
                                                                 const DSPVectorArray<ROWSD>& x4)
 {
-  DSPVectorArray<ROWSA + ROWSB + ROWSC + ROWSD> vy;
+  DSPVectorArray<ROWSA + ROWSB + ROWSC + ROWSD> vy(kUninitialized);
   for (int j = 0; j < ROWSA; ++j)
   {
     vy.setRowVectorUnchecked(j, x1.getRowVectorUnchecked(j));
@@ -1223,7 +1839,7 @@ inline DSPVectorArray<ROWSA + ROWSB + ROWSC + ROWSD> concatRows(const DSPVectorA
 template <size_t ROWS>
 inline ml::DSPVectorArray<ROWS> rotateLeft(const ml::DSPVectorArray<ROWS>& x)
 {
-  ml::DSPVectorArray<ROWS> vy;
+  ml::DSPVectorArray<ROWS> vy(kUninitialized);
 
   for (size_t row = 0; row < ROWS; row++)
   {
@@ -1253,7 +1869,7 @@ inline ml::DSPVectorArray<ROWS> rotateLeft(const ml::DSPVectorArray<ROWS>& x)
 template <size_t ROWS>
 inline ml::DSPVectorArray<ROWS> rotateRight(const ml::DSPVectorArray<ROWS>& x)
 {
-  ml::DSPVectorArray<ROWS> vy;
+  ml::DSPVectorArray<ROWS> vy(kUninitialized);
 
   for (size_t row = 0; row < ROWS; row++)
   {
@@ -1286,7 +1902,7 @@ template <size_t ROWSA, size_t ROWSB>
 inline DSPVectorArray<ROWSA + ROWSB> shuffleRows(const DSPVectorArray<ROWSA> x1,
                                                  const DSPVectorArray<ROWSB> x2)
 {
-  DSPVectorArray<ROWSA + ROWSB> vy;
+  DSPVectorArray<ROWSA + ROWSB> vy(kUninitialized);
   int ja = 0;
   int jb = 0;
   int jy = 0;
@@ -1314,7 +1930,7 @@ inline DSPVectorArray<ROWSA + ROWSB> shuffleRows(const DSPVectorArray<ROWSA> x1,
 template <size_t ROWS>
 inline DSPVectorArray<(ROWS + 1) / 2> evenRows(const DSPVectorArray<ROWS>& x1)
 {
-  DSPVectorArray<(ROWS + 1) / 2> vy;
+  DSPVectorArray<(ROWS + 1) / 2> vy(kUninitialized);
   for (int j = 0; j < (ROWS + 1) / 2; ++j)
   {
     vy.setRowVectorUnchecked(j, x1.getRowVectorUnchecked(j * 2));
@@ -1325,7 +1941,7 @@ inline DSPVectorArray<(ROWS + 1) / 2> evenRows(const DSPVectorArray<ROWS>& x1)
 template <size_t ROWS>
 inline DSPVectorArray<ROWS / 2> oddRows(const DSPVectorArray<ROWS>& x1)
 {
-  DSPVectorArray<ROWS / 2> vy;
+  DSPVectorArray<ROWS / 2> vy(kUninitialized);
   for (int j = 0; j < ROWS / 2; ++j)
   {
     vy.setRowVectorUnchecked(j, x1.getRowVectorUnchecked(j * 2 + 1));
@@ -1339,7 +1955,7 @@ inline DSPVectorArray<B - A> separateRows(const DSPVectorArray<ROWS>& x)
 {
   static_assert(B <= ROWS, "separateRows: range out of bounds!");
   static_assert(A < ROWS, "separateRows: range out of bounds!");
-  DSPVectorArray<B - A> vy;
+  DSPVectorArray<B - A> vy(kUninitialized);
   for (int j = A; j < B; ++j)
   {
     vy.setRowVectorUnchecked(j - A, x.getRowVectorUnchecked(j));
@@ -1362,6 +1978,75 @@ inline DSPVector addRows(const DSPVectorArray<ROWS>& x)
   return vy;
 }
 
+// ----------------------------------------------------------------
+// row-wise operations on expressions: evaluate, then operate on the result.
+
+template <size_t ROWS, class E, typename = expressions::EnableIfExpression<E> >
+inline auto repeatRows(const E& e)
+{
+  return repeatRows<ROWS>(expressions::evaluate(e));
+}
+
+template <size_t ROWS, class E, typename = expressions::EnableIfExpression<E> >
+inline auto stretchRows(const E& e)
+{
+  return stretchRows<ROWS>(expressions::evaluate(e));
+}
+
+template <size_t ROWS, class E, typename = expressions::EnableIfExpression<E> >
+inline auto zeroPadRows(const E& e)
+{
+  return zeroPadRows<ROWS>(expressions::evaluate(e));
+}
+
+template <class E, typename = expressions::EnableIfExpression<E> >
+inline auto shiftRows(const E& e, int rowsToShift)
+{
+  return shiftRows(expressions::evaluate(e), rowsToShift);
+}
+
+template <class E, typename = expressions::EnableIfExpression<E> >
+inline auto rotateRows(const E& e, int rowsToRotate)
+{
+  return rotateRows(expressions::evaluate(e), rowsToRotate);
+}
+
+template <class E, typename = expressions::EnableIfExpression<E> >
+inline auto rotateLeft(const E& e)
+{
+  return rotateLeft(expressions::evaluate(e));
+}
+
+template <class E, typename = expressions::EnableIfExpression<E> >
+inline auto rotateRight(const E& e)
+{
+  return rotateRight(expressions::evaluate(e));
+}
+
+template <class E, typename = expressions::EnableIfExpression<E> >
+inline auto evenRows(const E& e)
+{
+  return evenRows(expressions::evaluate(e));
+}
+
+template <class E, typename = expressions::EnableIfExpression<E> >
+inline auto oddRows(const E& e)
+{
+  return oddRows(expressions::evaluate(e));
+}
+
+template <size_t A, size_t B, class E, typename = expressions::EnableIfExpression<E> >
+inline auto separateRows(const E& e)
+{
+  return separateRows<A, B>(expressions::evaluate(e));
+}
+
+template <class E, typename = expressions::EnableIfExpression<E> >
+inline DSPVector addRows(const E& e)
+{
+  return addRows(expressions::evaluate(e));
+}
+
 // ----------------------------------------------------------------
 // rowIndex - returns a DSPVector of j rows, each row filled
 // with the index of its row
@@ -1369,7 +2054,7 @@ inline DSPVector addRows(const DSPVectorArray<ROWS>& x)
 template <size_t ROWS>
 inline DSPVectorArray<ROWS> rowIndex()
 {
-  DSPVectorArray<ROWS> y;
+  DSPVectorArray<ROWS> y(kUninitialized);
   for (int j = 0; j < ROWS; ++j)
   {
     y.setRowVectorUnchecked(j, DSPVector(j));
@@ -1410,6 +2095,15 @@ inline std::ostream& operator<<(std::ostream& out, const DSPVectorArray<ROWS>& v
   return out;
 }
 
+namespace expressions
+{
+template <class E, typename = EnableIfExpression<E> >
+inline std::ostream& operator<<(std::ostream& out, const E& e)
+{
+  return out << evaluate(e);
+}
+}  // namespace expressions
+
 template <size_t ROWS>
 inline std::ostream& operator<<(std::ostream& out, const DSPVectorArrayInt<ROWS>& vecArray)
 {
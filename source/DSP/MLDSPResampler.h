@@ -0,0 +1,244 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// Resampler: sample rate conversion by any ratio, which can change over time.
+//
+// Each output sample is the dot product of the input around its time with a
+// Kaiser-windowed sinc filter, taken from a polyphase table of the filter at
+// kPhases fractional offsets, with linear interpolation between the two nearest
+// phases. The ratio is the number of output samples per input sample. When the
+// ratio is less than one, the cutoff of the filter is lowered in proportion and
+// the filter made longer, so that the quality does not depend on the ratio.
+//
+// Input is written one DSPVector at a time. The output is collected in a
+// DSPBuffer, from which whole DSPVectors can be read as they become available.
+// The output is delayed by getLatency() samples of input: half the length of
+// the filter. All memory is allocated in the constructor.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include "MLDSPBuffer.h"
+#include "MLDSPOps.h"
+
+namespace ml
+{
+class Resampler
+{
+ public:
+  // filter length versus CPU. The filter lengths at a ratio of one are 16, 32 and
+  // 64 taps, with about 60, 80 and 100 dB of stopband rejection.
+  enum Quality
+  {
+    kLowQuality,
+    kMediumQuality,
+    kHighQuality
+  };
+
+  // the number of fractional offsets in the table of filter phases.
+  static constexpr int kPhaseBits = 8;
+  static constexpr int kPhases = 1 << kPhaseBits;
+
+  // make a Resampler that can run at ratios from minRatio to maxRatio. The
+  // filter is designed for the lowest ratio.
+  Resampler(double minRatio, double maxRatio, Quality quality = kMediumQuality)
+      : _minRatio(minRatio), _maxRatio(maxRatio)
+  {
+    assert(minRatio > 0. && maxRatio >= minRatio);
+    makeFilter(quality);
+
+    const size_t historySize = size_t(1) << bitsToContain(int(_taps + kFloatsPerDSPVector * 2));
+    _history.resize(historySize * 2);
+    _historyMask = historySize - 1;
+
+    const size_t maxOutputPerVector = size_t(std::ceil(maxRatio * kFloatsPerDSPVector)) + 1;
+    _output.resize(int(maxOutputPerVector + kFloatsPerDSPVector) * 2);
+
+    // start with the filter just before the first input, so that there is output
+    // from the first write on.
+    _inputIndex = -int64_t(_taps);
+    setRatio(minRatio);
+  }
+
+  explicit Resampler(double ratio, Quality quality = kMediumQuality)
+      : Resampler(ratio, ratio, quality)
+  {
+  }
+
+  // set the ratio of output to input samples, clamped to the range given to the
+  // constructor. The new ratio applies from the next output sample.
+  void setRatio(double ratio)
+  {
+    _ratio = std::min(std::max(ratio, _minRatio), _maxRatio);
+    _step = uint64_t(std::llround(kFractionScale / _ratio));
+  }
+
+  double getRatio() const { return _ratio; }
+  size_t getFilterLength() const { return _taps; }
+  size_t getLatency() const { return _taps / 2; }
+
+  // write a vector of input, and compute all of the output that it completes.
+  void write(const DSPVector& x)
+  {
+    // write the input to both halves of the history, so that the samples under
+    // the filter are always contiguous.
+    const size_t size = _historyMask + 1;
+    const float* px = x.getConstBuffer();
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      const size_t j = (_written + i) & _historyMask;
+      _history[j] = _history[j + size] = px[i];
+    }
+    _written += kFloatsPerDSPVector;
+
+    // compute each output whose filter ends in the input so far.
+    float* pOut = _outputChunk.getBuffer();
+    int nOut = 0;
+    while (_inputIndex + int64_t(_taps) <= int64_t(_written))
+    {
+      const float* pHistory = _history.data() + (size_t(_inputIndex) & _historyMask);
+      pOut[nOut++] = filterSample(pHistory, _fraction);
+
+      const uint64_t time = _fraction + _step;
+      _inputIndex += int64_t(time >> kFractionBits);
+      _fraction = uint32_t(time);
+
+      if (nOut == kFloatsPerDSPVector)
+      {
+        _output.write(pOut, nOut);
+        nOut = 0;
+      }
+    }
+    _output.write(pOut, nOut);
+  }
+
+  size_t getReadAvailable() const { return _output.getReadAvailable(); }
+
+  // read a vector of output, or zeros if a whole vector is not available.
+  DSPVector read() { return _output.read(); }
+
+ private:
+  double _minRatio;
+  double _maxRatio;
+  double _ratio{1.};
+
+  // times in input samples are fixed point, with kFractionBits fractional bits.
+  static constexpr int kFractionBits = 32;
+  static constexpr double kFractionScale = 4294967296.0;
+  uint64_t _step{0};
+
+  // the filter, with kPhases + 1 rows of taps, and the difference between each
+  // row and the next for interpolation.
+  size_t _taps{0};
+  std::vector<float> _table;
+  std::vector<float> _tableDelta;
+
+  std::vector<float> _history;
+  size_t _historyMask{0};
+  size_t _written{0};
+
+  // the first input sample under the filter for the next output, and the
+  // fractional time of the output past the center of the filter.
+  int64_t _inputIndex{0};
+  uint32_t _fraction{0};
+
+  DSPVector _outputChunk;
+  DSPBuffer _output;
+
+  // the zeroth order modified Bessel function of the first kind, for the window.
+  static double besselI0(double x)
+  {
+    double sum{1.}, term{1.};
+    const double q = x * x * 0.25;
+    for (int k = 1; k < 50; ++k)
+    {
+      term *= q / (double(k) * k);
+      sum += term;
+      if (term < sum * 1e-12) break;
+    }
+    return sum;
+  }
+
+  void makeFilter(Quality quality)
+  {
+    // taps at a ratio of one, Kaiser beta, and the cutoff as a fraction of the
+    // Nyquist frequency, chosen so that the stopband starts at Nyquist.
+    static constexpr int kBaseTaps[3] = {16, 32, 64};
+    static constexpr double kBeta[3] = {5.65, 7.86, 10.06};
+    static constexpr double kCutoff[3] = {0.77, 0.84, 0.9};
+
+    // lengthen the filter for ratios below one, to a whole number of SIMD vectors.
+    const double scale = std::min(_minRatio, 1.0);
+    const size_t minTaps = size_t(std::ceil(kBaseTaps[quality] / scale));
+    _taps = (minTaps + kFloatsPerSIMDVector - 1) / kFloatsPerSIMDVector * kFloatsPerSIMDVector;
+
+    const double cutoff = kCutoff[quality] * scale;
+    const double halfLength = _taps * 0.5;
+    const double beta = kBeta[quality];
+    const double windowGain = 1.0 / besselI0(beta);
+
+    // row p holds the filter for an output p/kPhases of a sample past the center
+    // tap, at _taps/2. Tap k is at time (center - k + p/kPhases) from the output.
+    std::vector<float> rows((kPhases + 1) * _taps);
+    for (int p = 0; p <= kPhases; ++p)
+    {
+      for (size_t k = 0; k < _taps; ++k)
+      {
+        const double t = halfLength - double(k) + double(p) / kPhases;
+        const double r = t / halfLength;
+        const double window =
+            (std::fabs(r) < 1.0) ? besselI0(beta * std::sqrt(1.0 - r * r)) * windowGain : 0.;
+        const double x = kPi * cutoff * t;
+        const double sinc = (std::fabs(x) < 1e-9) ? 1.0 : std::sin(x) / x;
+        rows[p * _taps + k] = float(cutoff * sinc * window);
+      }
+    }
+
+    _table.assign(rows.begin(), rows.begin() + kPhases * _taps);
+    _tableDelta.resize(kPhases * _taps);
+    for (size_t i = 0; i < _tableDelta.size(); ++i)
+    {
+      _tableDelta[i] = rows[i + _taps] - rows[i];
+    }
+  }
+
+  // the dot product of the input starting at px with the filter interpolated at
+  // the given fraction of a phase.
+  float filterSample(const float* px, uint32_t fraction) const
+  {
+    constexpr int kInterpolationBits = kFractionBits - kPhaseBits;
+    const size_t p = fraction >> kInterpolationBits;
+    const uint32_t interpolation = fraction & ((1u << kInterpolationBits) - 1);
+    const SIMDVectorFloat vFrac =
+        vecSet1(float(interpolation) * (1.f / (1 << kInterpolationBits)));
+    const float* pRow = _table.data() + p * _taps;
+    const float* pDelta = _tableDelta.data() + p * _taps;
+
+    // two accumulators, to overlap the latency of the adds.
+    SIMDVectorFloat acc0 = vecSet1(0.f);
+    SIMDVectorFloat acc1 = vecSet1(0.f);
+    size_t k = 0;
+    for (; k + 2 * kFloatsPerSIMDVector <= _taps; k += 2 * kFloatsPerSIMDVector)
+    {
+      const size_t k1 = k + kFloatsPerSIMDVector;
+      SIMDVectorFloat h0 = vecFMA(vFrac, vecLoadUnaligned(pDelta + k), vecLoadUnaligned(pRow + k));
+      SIMDVectorFloat h1 =
+          vecFMA(vFrac, vecLoadUnaligned(pDelta + k1), vecLoadUnaligned(pRow + k1));
+      acc0 = vecFMA(h0, vecLoadUnaligned(px + k), acc0);
+      acc1 = vecFMA(h1, vecLoadUnaligned(px + k1), acc1);
+    }
+    for (; k < _taps; k += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat h0 = vecFMA(vFrac, vecLoadUnaligned(pDelta + k), vecLoadUnaligned(pRow + k));
+      acc0 = vecFMA(h0, vecLoadUnaligned(px + k), acc0);
+    }
+    return vecSumH(vecAdd(acc0, acc1));
+  }
+};
+
+}  // namespace ml
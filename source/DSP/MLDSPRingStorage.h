@@ -0,0 +1,191 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// RingStorage: memory for ring buffers in which any window of samples, up to a
+// length given when allocating, is contiguous wherever it starts. Ring buffers
+// built on it can read and write with single copies or SIMD loads and stores
+// instead of splitting each access in two at the end of the buffer.
+//
+// On Linux, storage of a whole number of pages is a memfd mapped twice at
+// adjacent virtual addresses, so that sample i + size() is the same memory as
+// sample i. Elsewhere, for smaller sizes, or if the mapping fails, the storage
+// is padded with a mirror of the start of the buffer, and after each write,
+// commitWrite() must be called to keep the mirror and the buffer in agreement.
+// When the storage is double mapped, commitWrite() does nothing.
+//
+// Allocation is done in resize(), which is not for use in the audio thread. All
+// of the pages are touched there, so that the first pass over the storage does
+// not take page faults in the audio thread.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "MLDSPScalarMath.h"
+
+namespace ml
+{
+class RingStorage
+{
+ public:
+  RingStorage() = default;
+  ~RingStorage() { deallocate(); }
+
+  RingStorage(const RingStorage& other) { *this = other; }
+  RingStorage& operator=(const RingStorage& other)
+  {
+    if (this == &other) return *this;
+    if (!other._data)
+    {
+      deallocate();
+      _size = _mask = _window = 0;
+      return *this;
+    }
+    resize(other._size, other._window, other._mapped);
+    std::copy(other._data, other._data + _size, _data);
+    commitWrite(0, std::min(_size, _window));
+    return *this;
+  }
+
+  // allocate storage for at least minSize samples, a power of two, in which any
+  // window of up to window samples is contiguous. If allowMapping is false, the
+  // padded storage is used everywhere. The samples are cleared.
+  void resize(size_t minSize, size_t window, bool allowMapping = true)
+  {
+    deallocate();
+    _window = std::max(window, size_t(1));
+    const size_t size = std::max(minSize, _window);
+    _size = size_t(1) << bitsToContain(int(size));
+    _mask = _size - 1;
+
+    if (!(allowMapping && allocateMapped()))
+    {
+      _padded.assign(_size + _window, 0.f);
+      _data = _padded.data();
+    }
+  }
+
+  float* data() { return _data; }
+  const float* data() const { return _data; }
+  size_t size() const { return _size; }
+  size_t mask() const { return _mask; }
+  size_t window() const { return _window; }
+  bool isDoubleMapped() const { return _mapped; }
+
+  // true if the samples [start, start + samples) can be accessed with a single
+  // pointer, where start < size() and samples <= size().
+  bool isContiguous(size_t start, size_t samples) const
+  {
+    return _mapped || (start + samples <= _size + _window);
+  }
+
+  // clear all the samples.
+  void clear() { std::fill(_data, _data + _size + (_mapped ? 0 : _window), 0.f); }
+
+  // after writing samples [start, start + samples), where start < size() and
+  // samples <= window(), bring the mirror and the buffer into agreement.
+  void commitWrite(size_t start, size_t samples)
+  {
+    if (_mapped || !_data) return;
+    const size_t end = start + samples;
+    if (end > _size)
+    {
+      // the write wrapped into the mirror: copy that part to the buffer.
+      std::copy(_data + _size, _data + end, _data);
+      mirror(start, _size);
+      mirror(0, end - _size);
+    }
+    else
+    {
+      mirror(start, end);
+    }
+  }
+
+ private:
+  float* _data{nullptr};
+  size_t _size{0};
+  size_t _mask{0};
+  size_t _window{0};
+  bool _mapped{false};
+  std::vector<float> _padded;
+
+  // copy the part of the buffer [start, end) that has a mirror to the mirror.
+  void mirror(size_t start, size_t end)
+  {
+    end = std::min(end, _window);
+    if (start < end)
+    {
+      std::copy(_data + start, _data + end, _data + _size + start);
+    }
+  }
+
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+  bool allocateMapped()
+  {
+    // the size of each mapping must be a whole number of pages. Smaller buffers
+    // use the padded storage, which for them costs little memory or copying.
+    const size_t bytes = _size * sizeof(float);
+    if (bytes % size_t(sysconf(_SC_PAGESIZE)) != 0) return false;
+
+    int fd = memfd_create("madronalib_ring", MFD_CLOEXEC);
+    if (fd < 0) return false;
+    if (ftruncate(fd, off_t(bytes)) != 0)
+    {
+      close(fd);
+      return false;
+    }
+
+    // reserve both halves of the address range, then map the file into each,
+    // with the page tables populated now rather than on first access.
+    void* region = mmap(nullptr, bytes * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    bool ok = (region != MAP_FAILED);
+    if (ok)
+    {
+      char* p = static_cast<char*>(region);
+      const int flags = MAP_SHARED | MAP_FIXED | MAP_POPULATE;
+      ok = (mmap(p, bytes, PROT_READ | PROT_WRITE, flags, fd, 0) == p) &&
+           (mmap(p + bytes, bytes, PROT_READ | PROT_WRITE, flags, fd, 0) == p + bytes);
+      if (!ok) munmap(region, bytes * 2);
+    }
+
+    // the mappings keep the memory after the file is closed.
+    close(fd);
+    if (!ok) return false;
+    _data = static_cast<float*>(region);
+    _mapped = true;
+
+    // MAP_POPULATE is only advice, so write to every page as well.
+    clear();
+    return true;
+  }
+
+  void deallocate()
+  {
+    if (_mapped)
+    {
+      munmap(_data, _size * sizeof(float) * 2);
+      _mapped = false;
+    }
+    std::vector<float>().swap(_padded);
+    _data = nullptr;
+  }
+#else
+  bool allocateMapped() { return false; }
+
+  void deallocate()
+  {
+    std::vector<float>().swap(_padded);
+    _data = nullptr;
+  }
+#endif
+};
+
+}  // namespace ml
@@ -18,6 +18,7 @@
 #define snprintf _snprintf
 #endif
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <functional>
@@ -26,6 +27,7 @@
 #include <type_traits>
 
 #include "MLDSPMath.h"
+#include "MLDSPOps.h"
 #include "MLDSPScalarMath.h"
 
 namespace ml
@@ -49,57 +51,272 @@ Parallel
 
 // mix (DSPVectorArray<INPUTS>gains, a, b, c, ... )
 // returns the sum of each input DSPVectorArray multiplied by the corresponding row
-// of the gains array.
-// NOTE: if the gains DSPVectorArray contains a number of rows smaller than the number of inputs,
-// unsafe behavior results.
-// TODO: with the right template-fu it should be possible to check the sizes at compile time,
-// and to avoid passing inputIndex at runtime.
+// of the gains array. The sum is made in one pass over the SIMD vectors of the
+// output, without temporaries.
 
 template <size_t ROWS, size_t INPUTS, typename... Args>
-DSPVectorArray<ROWS> mix_n(size_t inputIndex, DSPVectorArray<INPUTS> gains,
-                           DSPVectorArray<ROWS> first)
+DSPVectorArray<ROWS> mix(const DSPVectorArray<INPUTS>& gains, const DSPVectorArray<ROWS>& first,
+                         const Args&... args)
 {
-  return first * repeatRows<ROWS>(gains.getRowVectorUnchecked(inputIndex));
+  constexpr int nInputs = sizeof...(Args) + 1;
+  static_assert(nInputs <= static_cast<int>(INPUTS), "mix: not enough rows of gains for the inputs");
+  const DSPVectorArray<ROWS>* inputs[]{&first, &args...};
+
+  DSPVectorArray<ROWS> y(kUninitialized);
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+  {
+    const int offset = n * kFloatsPerSIMDVector;
+    SIMDVectorFloat g[nInputs];
+    for (int k = 0; k < nInputs; ++k)
+    {
+      g[k] = vecLoad(gains.getConstBuffer() + k * kFloatsPerDSPVector + offset);
+    }
+    for (int j = 0; j < static_cast<int>(ROWS); ++j)
+    {
+      const int rowOffset = j * kFloatsPerDSPVector + offset;
+      SIMDVectorFloat sum = vecMul(vecLoad(inputs[0]->getConstBuffer() + rowOffset), g[0]);
+      for (int k = 1; k < nInputs; ++k)
+      {
+        sum = vecFMA(vecLoad(inputs[k]->getConstBuffer() + rowOffset), g[k], sum);
+      }
+      vecStore(y.getBuffer() + rowOffset, sum);
+    }
+  }
+  return y;
 }
 
-template <size_t ROWS, size_t INPUTS, typename... Args>
-DSPVectorArray<ROWS> mix_n(size_t inputIndex, DSPVectorArray<INPUTS> gains,
-                           DSPVectorArray<ROWS> first, Args... args)
+// ----------------------------------------------------------------
+// MixMatrix: mixes INPUTS signals, the rows of the input array, to OUTPUTS signals
+// through a matrix of gains. Changes to the gains glide linearly to their new
+// values, sample by sample, over the glide time. As with LinearGlide, the glide
+// time is quantized to DSPVectors so that the glides can be computed per vector.
+//
+// Within each vector the gain from input k to output j is c + r*d, where c is the
+// gain at the start of the vector, d its change over the vector and r a ramp to
+// 1. So each output is the sum of c*x over the inputs, plus r times the sum of
+// d*x over the gliding inputs. Gains that are 0 and not gliding are skipped, so
+// sparse matrices are cheap. All outputs are made in one pass over each SIMD
+// vector of the inputs, while they are in cache.
+
+template <size_t INPUTS, size_t OUTPUTS>
+class MixMatrix
+{
+  float _current[OUTPUTS][INPUTS]{};
+  float _target[OUTPUTS][INPUTS]{};
+  int _vectorsRemaining[OUTPUTS][INPUTS]{};
+  int _vectorsPerGlide{1};
+
+  // the gains and changes used in the current vector, for each output.
+  struct Term
+  {
+    int input;
+    float gain;
+  };
+  Term _terms[OUTPUTS][INPUTS];
+  Term _glides[OUTPUTS][INPUTS];
+  int _nTerms[OUTPUTS];
+  int _nGlides[OUTPUTS];
+
+  // advance the gain glides by one vector and collect the nonzero terms.
+  void updateGains()
+  {
+    for (size_t j = 0; j < OUTPUTS; ++j)
+    {
+      int nTerms{0}, nGlides{0};
+      for (size_t k = 0; k < INPUTS; ++k)
+      {
+        const float c = _current[j][k];
+        if (_vectorsRemaining[j][k] > 0)
+        {
+          const int r = _vectorsRemaining[j][k]--;
+          const float d = (r == 1) ? _target[j][k] - c : (_target[j][k] - c) / r;
+          _current[j][k] = (r == 1) ? _target[j][k] : c + d;
+          _glides[j][nGlides++] = Term{static_cast<int>(k), d};
+        }
+        if (c != 0.f)
+        {
+          _terms[j][nTerms++] = Term{static_cast<int>(k), c};
+        }
+      }
+      _nTerms[j] = nTerms;
+      _nGlides[j] = nGlides;
+    }
+  }
+
+ public:
+  void setGlideTimeInSamples(float t)
+  {
+    _vectorsPerGlide = std::max(static_cast<int>(t / kFloatsPerDSPVector), 1);
+  }
+
+  // set the gain from an input to an output, gliding from the current gain.
+  void setGain(size_t input, size_t output, float g)
+  {
+    if (g != _target[output][input])
+    {
+      _target[output][input] = g;
+      _vectorsRemaining[output][input] = _vectorsPerGlide;
+    }
+  }
+
+  // set the gain from an input to an output immediately, without gliding.
+  void setGainImmediate(size_t input, size_t output, float g)
+  {
+    _target[output][input] = _current[output][input] = g;
+    _vectorsRemaining[output][input] = 0;
+  }
+
+  float getGain(size_t input, size_t output) const { return _target[output][input]; }
+
+  DSPVectorArray<OUTPUTS> operator()(const DSPVectorArray<INPUTS>& x)
+  {
+    updateGains();
+
+    DSPVectorArray<OUTPUTS> y(kUninitialized);
+    const float* px = x.getConstBuffer();
+    float* py = y.getBuffer();
+    static const DSPVector kRamp{(columnIndex() + DSPVector(1.f)) / DSPVector(kFloatsPerDSPVector)};
+    const float* pRamp = kRamp.getConstBuffer();
+    for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
+    {
+      const int offset = n * kFloatsPerSIMDVector;
+      for (size_t j = 0; j < OUTPUTS; ++j)
+      {
+        // two sums, to overlap the additions.
+        SIMDVectorFloat sum0 = vecZeros(), sum1 = vecZeros();
+        const Term* pTerm = _terms[j];
+        const int nTerms = _nTerms[j];
+        int t = 0;
+        for (; t + 1 < nTerms; t += 2)
+        {
+          sum0 = vecFMA(vecLoad(px + pTerm[t].input * kFloatsPerDSPVector + offset),
+                        vecSet1(pTerm[t].gain), sum0);
+          sum1 = vecFMA(vecLoad(px + pTerm[t + 1].input * kFloatsPerDSPVector + offset),
+                        vecSet1(pTerm[t + 1].gain), sum1);
+        }
+        if (t < nTerms)
+        {
+          sum0 = vecFMA(vecLoad(px + pTerm[t].input * kFloatsPerDSPVector + offset),
+                        vecSet1(pTerm[t].gain), sum0);
+        }
+        sum0 = vecAdd(sum0, sum1);
+
+        if (_nGlides[j])
+        {
+          SIMDVectorFloat glideSum = vecZeros();
+          const Term* pGlide = _glides[j];
+          for (int g = 0; g < _nGlides[j]; ++g)
+          {
+            glideSum = vecFMA(vecLoad(px + pGlide[g].input * kFloatsPerDSPVector + offset),
+                              vecSet1(pGlide[g].gain), glideSum);
+          }
+          sum0 = vecFMA(glideSum, vecLoad(pRamp + offset), sum0);
+        }
+        vecStore(py + j * kFloatsPerDSPVector + offset, sum0);
+      }
+    }
+    return y;
+  }
+};
+
+// get the input or output index selected by each lane of the selector. The
+// fractional part of the selector, [0--1), is mapped to the indices [0--n).
+// Indices are clamped to the valid range, and the position above each index is
+// returned in frac for the linear routers.
+
+template <int N>
+inline SIMDVectorInt selectorToIndex(SIMDVectorFloat selector, SIMDVectorFloat& frac)
 {
-  return first * repeatRows<ROWS>(gains.getRowVectorUnchecked(inputIndex)) +
-         mix_n(inputIndex + 1, gains, args...);
+  SIMDVectorFloat u = vecSub(selector, vecIntToFloat(vecFloatToIntTruncate(selector)));
+  SIMDVectorFloat real = vecMul(u, vecSet1(static_cast<float>(N)));
+  SIMDVectorInt idx = vecFloatToIntTruncate(real);
+  frac = vecSub(real, vecIntToFloat(idx));
+  return vecMinInt(vecMaxInt(idx, vecSetInt1(0)), vecSetInt1(N - 1));
 }
 
-template <size_t ROWS, size_t INPUTS, typename... Args>
-DSPVectorArray<ROWS> mix(DSPVectorArray<INPUTS> gains, DSPVectorArray<ROWS> first, Args... args)
+// the index after idx, wrapping around to 0 after the last index.
+template <int N>
+inline SIMDVectorInt nextIndex(SIMDVectorInt idx)
 {
-  return mix_n(0, gains, first, args...);
+  SIMDVectorInt next = vecAddInt(idx, vecSetInt1(1));
+  return vecAndNotInt(vecEqualInt(next, vecSetInt1(N)), next);
 }
 
+// with more inputs than this, multiplex looks up each sample from its input
+// instead of selecting from all of the inputs.
+constexpr int kMaxMultiplexSelectInputs = 4;
+
 // multiplex. selector is a signal that controls what mix of the inputs to send to the output.
 // the selector range [0--1) is mapped to cover the range of inputs equally.
+// Where a whole SIMD vector of the selector picks the same input, that input is
+// copied. Otherwise, with a few inputs each output vector is made by selecting
+// from all of the inputs with masks, and with more each sample is looked up.
 
 template <size_t ROWS, typename... Args>
-DSPVectorArray<ROWS> multiplex(DSPVector selector, DSPVectorArray<ROWS> first, Args... args)
+DSPVectorArray<ROWS> multiplex(const DSPVector& selector, const DSPVectorArray<ROWS>& first,
+                               const Args&... args)
 {
-  DSPVectorArray<ROWS> inputs[]{first, args...};
+  const DSPVectorArray<ROWS>* inputs[]{&first, &args...};
   constexpr int nInputs = sizeof...(Args) + 1;
 
-  DSPVectorArray<ROWS> y;
-
-  // iterate on each sample of input selector
-  for (int i = 0; i < kFloatsPerDSPVector * ROWS; ++i)
+  DSPVectorArray<ROWS> y(kUninitialized);
+  const float* pSelector = selector.getConstBuffer();
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
   {
-    // TODO SIMD
-    int selectorIdx = i % kFloatsPerDSPVector;
-    float s = selector[selectorIdx];
+    const int offset = n * kFloatsPerSIMDVector;
+    SIMDVectorFloat frac;
+    SIMDVectorIntUnion idx;
+    idx.v = selectorToIndex<nInputs>(vecLoad(pSelector + offset), frac);
 
-    // get input index from 0 - nInputs-1
-    float inputU = s - truncf(s);
-    size_t inputSafe = inputU * nInputs;
+    bool uniform{true};
+    for (int i = 1; i < kIntsPerSIMDVector; ++i)
+    {
+      uniform = uniform && (idx.i[i] == idx.i[0]);
+    }
 
-    // read input sample to output
-    y[i] = inputs[inputSafe][i];
+    if (uniform)
+    {
+      const float* px = inputs[idx.i[0]]->getConstBuffer() + offset;
+      for (int j = 0; j < static_cast<int>(ROWS); ++j)
+      {
+        vecStore(y.getBuffer() + j * kFloatsPerDSPVector + offset,
+                 vecLoad(px + j * kFloatsPerDSPVector));
+      }
+    }
+    else if (nInputs <= kMaxMultiplexSelectInputs)
+    {
+      SIMDVectorInt masks[nInputs];
+      for (int k = 0; k < nInputs; ++k)
+      {
+        masks[k] = vecEqualInt(idx.v, vecSetInt1(k));
+      }
+      for (int j = 0; j < static_cast<int>(ROWS); ++j)
+      {
+        const int rowOffset = j * kFloatsPerDSPVector + offset;
+        SIMDVectorFloat out = vecLoad(inputs[0]->getConstBuffer() + rowOffset);
+        for (int k = 1; k < nInputs; ++k)
+        {
+          out = vecSelect(vecLoad(inputs[k]->getConstBuffer() + rowOffset), out, masks[k]);
+        }
+        vecStore(y.getBuffer() + rowOffset, out);
+      }
+    }
+    else
+    {
+      const float* px[kIntsPerSIMDVector];
+      for (int i = 0; i < kIntsPerSIMDVector; ++i)
+      {
+        px[i] = inputs[idx.i[i]]->getConstBuffer() + offset + i;
+      }
+      for (int j = 0; j < static_cast<int>(ROWS); ++j)
+      {
+        float* py = y.getBuffer() + j * kFloatsPerDSPVector + offset;
+        for (int i = 0; i < kIntsPerSIMDVector; ++i)
+        {
+          py[i] = px[i][j * kFloatsPerDSPVector];
+        }
+      }
+    }
   }
   return y;
 }
@@ -108,67 +325,71 @@ DSPVectorArray<ROWS> multiplex(DSPVector selector, DSPVectorArray<ROWS> first, A
 // the selector range [0--1) is mapped so that 1.0 = the last input.
 
 template <size_t ROWS, typename... Args>
-DSPVectorArray<ROWS> multiplexLinear(DSPVector selector, DSPVectorArray<ROWS> first, Args... args)
+DSPVectorArray<ROWS> multiplexLinear(const DSPVector& selector, const DSPVectorArray<ROWS>& first,
+                                     const Args&... args)
 {
-  DSPVectorArray<ROWS> inputs[]{first, args...};
+  const DSPVectorArray<ROWS>* inputs[]{&first, &args...};
   constexpr int nInputs = sizeof...(Args) + 1;
 
-  DSPVectorArray<ROWS> y;
-
-  // iterate on each sample of input selector
-  for (int i = 0; i < kFloatsPerDSPVector * ROWS; ++i)
+  DSPVectorArray<ROWS> y(kUninitialized);
+  const float* pSelector = selector.getConstBuffer();
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
   {
-    // TODO SIMD
-    int selectorIdx = i % kFloatsPerDSPVector;
-    float s = selector[selectorIdx];
-
-    // get input index from 0 - nInputs-1
-    float inputU = s - truncf(s);
-    float inputReal = inputU * nInputs;
-    float inputInt = truncf(inputReal);
-    float inputFrac = inputReal - inputInt;
-    size_t input1Safe = inputInt;
-    size_t input2Safe = (input1Safe + 1) % nInputs;
-
-    // read input samples and interpolate to output
-    y[i] = lerp(inputs[input1Safe][i], inputs[input2Safe][i], inputFrac);
+    const int offset = n * kFloatsPerSIMDVector;
+    SIMDVectorFloat frac;
+    SIMDVectorInt idx1 = selectorToIndex<nInputs>(vecLoad(pSelector + offset), frac);
+    SIMDVectorInt idx2 = nextIndex<nInputs>(idx1);
+
+    SIMDVectorInt masks1[nInputs], masks2[nInputs];
+    for (int k = 0; k < nInputs; ++k)
+    {
+      masks1[k] = vecEqualInt(idx1, vecSetInt1(k));
+      masks2[k] = vecEqualInt(idx2, vecSetInt1(k));
+    }
+    for (int j = 0; j < static_cast<int>(ROWS); ++j)
+    {
+      const int rowOffset = j * kFloatsPerDSPVector + offset;
+      SIMDVectorFloat x = vecLoad(inputs[0]->getConstBuffer() + rowOffset);
+      SIMDVectorFloat a = x, b = x;
+      for (int k = 1; k < nInputs; ++k)
+      {
+        x = vecLoad(inputs[k]->getConstBuffer() + rowOffset);
+        a = vecSelect(x, a, masks1[k]);
+        b = vecSelect(x, b, masks2[k]);
+      }
+      vecStore(y.getBuffer() + rowOffset, vecFMA(frac, vecSub(b, a), a));
+    }
   }
   return y;
 }
 
 // demultiplex the input to the outputs based on the value of the selector at each sample.
+// Each output is the input masked where the selector picks that output.
 
 template <size_t ROWS, typename... Args>
-void demultiplex(DSPVector selector, DSPVectorArray<ROWS> input, DSPVectorArray<ROWS>* firstOutput,
-                 Args... args)
+void demultiplex(const DSPVector& selector, const DSPVectorArray<ROWS>& input,
+                 DSPVectorArray<ROWS>* firstOutput, Args... args)
 {
   DSPVectorArray<ROWS>* outputs[]{firstOutput, args...};
   constexpr int nOutputs = sizeof...(Args) + 1;
 
-  DSPVector outputIntSafe;
-
-  // for each sample, get the output index from the selector
-  for (int i = 0; i < kFloatsPerDSPVector; ++i)
-  {
-    // TODO SIMD
-    float s = selector[i];
-
-    // get input index from 0 - nInputs-1
-    float outputU = s - truncf(s);
-    size_t outputInt = outputU * nOutputs;
-    outputIntSafe[i] = outputInt;
-  }
-
-  // for each output, for each sample, if the selected output index at the
-  // sample equals the output, write the input that that output. Else write 0.
-  for (int j = 0; j < nOutputs; ++j)
+  // copy the input first in case it is also one of the outputs.
+  const DSPVectorArray<ROWS> x{input};
+  const float* pSelector = selector.getConstBuffer();
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
   {
-    DSPVectorArray<ROWS>* pOutput = outputs[j];
-    for (int i = 0; i < kFloatsPerDSPVector * ROWS; ++i)
+    const int offset = n * kFloatsPerSIMDVector;
+    SIMDVectorFloat frac;
+    SIMDVectorInt idx = selectorToIndex<nOutputs>(vecLoad(pSelector + offset), frac);
+    for (int k = 0; k < nOutputs; ++k)
     {
-      int selectorIdx = i % kFloatsPerDSPVector;
-      size_t outputInt = outputIntSafe[selectorIdx];
-      (*pOutput)[i] = (outputInt == j) ? input[i] : 0;
+      SIMDVectorFloat mask = VecI2F(vecEqualInt(idx, vecSetInt1(k)));
+      for (int j = 0; j < static_cast<int>(ROWS); ++j)
+      {
+        const int rowOffset = j * kFloatsPerDSPVector + offset;
+        vecStore(outputs[k]->getBuffer() + rowOffset,
+                 vecAnd(vecLoad(x.getConstBuffer() + rowOffset), mask));
+      }
     }
   }
 }
@@ -177,57 +398,33 @@ void demultiplex(DSPVector selector, DSPVectorArray<ROWS> input, DSPVectorArray<
 // deinterpolate linearly to neighboring outputs.
 
 template <size_t ROWS, typename... Args>
-void demultiplexLinear(DSPVector selector, DSPVectorArray<ROWS> input,
+void demultiplexLinear(const DSPVector& selector, const DSPVectorArray<ROWS>& input,
                        DSPVectorArray<ROWS>* firstOutput, Args... args)
 {
   DSPVectorArray<ROWS>* outputs[]{firstOutput, args...};
   constexpr int nOutputs = sizeof...(Args) + 1;
 
-  DSPVector outputInt1Safe;
-  DSPVector outputInt2Safe;
-  DSPVector outputMix;
-
-  // for each sample, get the two output indexes and mix amount from the selector
-  for (int i = 0; i < kFloatsPerDSPVector; ++i)
-  {
-    // TODO SIMD
-    float s = selector[i];
-
-    // get input index from 0 - nInputs-1
-    float outputU = s - truncf(s);
-    float outputReal = outputU * nOutputs;
-    float outputIntPart = truncf(outputReal);
-    size_t outputInt = outputIntPart;
-    outputMix[i] = outputReal - outputIntPart;
-    outputInt1Safe[i] = outputInt;
-    outputInt2Safe[i] = (outputInt + 1) % nOutputs;
-  }
-
-  // for each output, for each sample, if the selected output index at the
-  // sample equals the output, write the input that that output. Else write 0.
-  for (int j = 0; j < nOutputs; ++j)
+  const DSPVectorArray<ROWS> x{input};
+  const float* pSelector = selector.getConstBuffer();
+  for (int n = 0; n < kSIMDVectorsPerDSPVector; ++n)
   {
-    DSPVectorArray<ROWS>* pOutput = outputs[j];
-    for (int i = 0; i < kFloatsPerDSPVector * ROWS; ++i)
+    const int offset = n * kFloatsPerSIMDVector;
+    SIMDVectorFloat m;
+    SIMDVectorInt idx1 = selectorToIndex<nOutputs>(vecLoad(pSelector + offset), m);
+    SIMDVectorInt idx2 = nextIndex<nOutputs>(idx1);
+    SIMDVectorFloat gain1 = vecSub(vecSet1(1.f), m);
+
+    // the gain of each output is 1 - m at idx1, else m at idx2, else 0.
+    for (int k = 0; k < nOutputs; ++k)
     {
-      int selectorIdx = i % kFloatsPerDSPVector;
-      size_t outputInt1 = outputInt1Safe[selectorIdx];
-      size_t outputInt2 = outputInt2Safe[selectorIdx];
-      float m = outputMix[selectorIdx];
-
-      if (j == outputInt1)
-      {
-        // deinterpolate a
-        (*pOutput)[i] = input[i] * (1.f - m);
-      }
-      else if (j == outputInt2)
-      {
-        // deinterpolate b
-        (*pOutput)[i] = input[i] * m;
-      }
-      else
+      SIMDVectorInt kv = vecSetInt1(k);
+      SIMDVectorFloat gain = vecSelect(gain1, vecAnd(m, VecI2F(vecEqualInt(idx2, kv))),
+                                       vecEqualInt(idx1, kv));
+      for (int j = 0; j < static_cast<int>(ROWS); ++j)
       {
-        (*pOutput)[i] = 0;
+        const int rowOffset = j * kFloatsPerDSPVector + offset;
+        vecStore(outputs[k]->getBuffer() + rowOffset,
+                 vecMul(vecLoad(x.getConstBuffer() + rowOffset), gain));
       }
     }
   }
@@ -0,0 +1,153 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// STFT: streaming short-time Fourier transform processing by weighted
+// overlap-add.
+//
+// The input is collected in a DSPBuffer. Every hop samples, one frame of the
+// most recent frameSize samples is read with readWithOverlap, multiplied by the
+// analysis window and transformed. The spectrum is passed to the user's function
+// to be modified in place, in the split-complex layout described in MLDSPFFT.h.
+// Then the frame is transformed back, multiplied by the synthesis window, which
+// is the same as the analysis window, and added into the output DSPBuffer with
+// writeWithOverlapAdd. The output is scaled so that with windows
+// that overlap-add to a constant, such as the raised cosine at a hop of a
+// quarter frame, an unchanged spectrum gives back the input.
+//
+// The output is delayed by getLatency() samples: frameSize - hop, plus any delay
+// needed to always have a complete vector of output when the hop is not a
+// multiple of kFloatsPerDSPVector. All memory is allocated in the constructor.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "MLDSPBuffer.h"
+#include "MLDSPFFT.h"
+#include "MLDSPOps.h"
+#include "MLDSPUtils.h"
+
+namespace ml
+{
+class STFT
+{
+ public:
+  // frameSize must be a power of two, and hop no larger than frameSize.
+  STFT(size_t frameSize, size_t hop, Projection window = windows::raisedCosine)
+      : _frameSize(frameSize), _hop(hop), _fft(frameSize), _window(frameSize), _frame(frameSize),
+        _spectrum(frameSize)
+  {
+    assert(frameSize >= 2 && !(frameSize & (frameSize - 1)));
+    assert(hop > 0 && hop <= frameSize);
+
+    // a periodic window, which overlap-adds to a constant where the symmetric one
+    // would not quite.
+    mapIndices(_window.data(), frameSize,
+               compose(window, projections::linear({0.f, float(frameSize)}, {0.f, 1.f})));
+
+    // the gain of overlapping windows at each sample, averaged over a hop.
+    float windowPower{0};
+    for (float w : _window)
+    {
+      windowPower += w * w;
+    }
+    _outputGain = (windowPower > 0.f) ? hop / windowPower : 0.f;
+
+    const size_t outputDelay = computeOutputDelay();
+    _latency = frameSize - hop + outputDelay;
+    _input.resize(static_cast<int>(frameSize + kFloatsPerDSPVector));
+    _output.resize(static_cast<int>(outputDelay + frameSize * 2 + kFloatsPerDSPVector));
+
+    // prime the input so that the first frame ends with the first hop of input,
+    // and the output with the extra delay.
+    std::vector<float> zeros(frameSize);
+    _input.write(zeros.data(), frameSize - hop);
+    _output.write(zeros.data(), outputDelay);
+  }
+
+  size_t getLatency() const { return _latency; }
+  size_t getFrameSize() const { return _frameSize; }
+  size_t getHop() const { return _hop; }
+
+  // process a vector, calling fn(spectrum, frameSize) for each frame. fn is a
+  // template parameter so that a lambda is called directly, and never copied
+  // into a std::function, which could allocate in the audio thread.
+  template <typename FN>
+  DSPVector operator()(const DSPVector& x, FN fn)
+  {
+    _input.write(x);
+    while (_input.getReadAvailable() >= _frameSize)
+    {
+      processFrame(fn);
+    }
+    return _output.read();
+  }
+
+  // process a vector with the spectrum unchanged.
+  DSPVector operator()(const DSPVector& x)
+  {
+    return operator()(x, [](float*, size_t) {});
+  }
+
+ private:
+  size_t _frameSize;
+  size_t _hop;
+  size_t _latency{0};
+  float _outputGain{1.f};
+  FFT _fft;
+  std::vector<float> _window;
+  std::vector<float> _frame;
+  std::vector<float> _spectrum;
+  DSPBuffer _input;
+  DSPBuffer _output;
+
+  static void multiplyBuffers(float* x, const float* w, size_t size, float gain)
+  {
+    const size_t nVec = size / kFloatsPerSIMDVector;
+    const size_t tailStart = nVec * kFloatsPerSIMDVector;
+    const SIMDVectorFloat g = vecSet1(gain);
+    for (size_t v = 0; v < nVec; ++v)
+    {
+      const size_t i = v * kFloatsPerSIMDVector;
+      vecStoreUnaligned(x + i, vecMul(vecMul(vecLoadUnaligned(x + i), vecLoadUnaligned(w + i)), g));
+    }
+    for (size_t i = tailStart; i < size; ++i)
+    {
+      x[i] *= w[i] * gain;
+    }
+  }
+
+  template <typename FN>
+  void processFrame(FN& fn)
+  {
+    _input.readWithOverlap(_frame.data(), _frameSize, _frameSize - _hop);
+    multiplyBuffers(_frame.data(), _window.data(), _frameSize, 1.f);
+    _fft.forward(_frame.data(), _spectrum.data());
+    fn(_spectrum.data(), _frameSize);
+    _fft.inverse(_spectrum.data(), _frame.data());
+    multiplyBuffers(_frame.data(), _window.data(), _frameSize, _outputGain);
+    _output.writeWithOverlapAdd(_frame.data(), _frameSize, _frameSize - _hop);
+  }
+
+  // after each input vector, the output must have a vector ready to read. With
+  // the input primed, each complete hop of input completes a hop of output, so
+  // the output falls behind by the input in the unfinished hop. Find the most
+  // it falls behind over one period of the pattern of vectors and hops.
+  size_t computeOutputDelay() const
+  {
+    const size_t b = kFloatsPerDSPVector;
+    size_t period = b;
+    while (period % _hop) period += b;
+    size_t delay{0};
+    for (size_t in = b; in <= period; in += b)
+    {
+      delay = std::max(delay, in % _hop);
+    }
+    return delay;
+  }
+};
+
+}  // namespace ml
@@ -80,6 +80,21 @@ constexpr inline c lerp(const c& a, const c& b, const c& m)
   return (a + m * (b - a));
 }
 
+// fused multiply-add: a*b + c. On targets with hardware FMA this is a single
+// instruction. Otherwise use a separate multiply and add, because std::fma
+// without hardware support is a slow library call.
+inline float fma(float a, float b, float c)
+{
+#if defined(__FMA__) || defined(__ARM_FEATURE_FMA)
+  return std::fma(a, b, c);
+#else
+  return a * b + c;
+#endif
+}
+
+// fused multiply-subtract: a*b - c.
+inline float fms(float a, float b, float c) { return ml::fma(a, b, -c); }
+
 // return bool value of within half-open interval [min, max).
 template <class c>
 constexpr inline bool within(const c& x, const c& min, const c& max)
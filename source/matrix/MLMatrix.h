@@ -104,8 +104,8 @@ class Matrix final
   // log2 of actual size of each dimension, stored for fast access.
   int mWidthBits, mHeightBits, mDepthBits;
 
-  static constexpr int kSmallSignalSize =
-      64;  // TODO this should be equal to the fixed DSP vector size
+  // signals up to the DSP vector size are stored locally, without allocating.
+  static constexpr int kSmallSignalSize = kFloatsPerDSPVector;
 
   float mLocalData[kSmallSignalSize + kSignalAlignSize - 1];
 